@@ -0,0 +1,678 @@
+#include "fst.hh"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "fmt/format.h"
+
+namespace hgdb::fst {
+
+// block types
+constexpr uint8_t block_header = 0;
+constexpr uint8_t block_vc_data = 1;
+constexpr uint8_t block_blackout = 2;
+constexpr uint8_t block_geometry = 3;
+constexpr uint8_t block_hierarchy = 4;
+constexpr uint8_t block_vc_data_alias = 5;
+constexpr uint8_t block_hierarchy_lz4 = 6;
+constexpr uint8_t block_hierarchy_lz4_duo = 7;
+constexpr uint8_t block_vc_data_alias2 = 8;
+constexpr uint8_t block_zwrapper = 254;
+constexpr uint8_t block_skip = 255;
+
+// hierarchy tags. anything up to max_var_type is a variable
+constexpr uint8_t max_var_type = 29;
+constexpr uint8_t tag_attr_begin = 252;
+constexpr uint8_t tag_attr_end = 253;
+constexpr uint8_t tag_scope = 254;
+constexpr uint8_t tag_upscope = 255;
+
+// non-binary values of single-bit signals
+constexpr std::string_view single_bit_values = "xzhuwl-?";
+
+class InvalidFST : public std::runtime_error {
+public:
+    InvalidFST() : std::runtime_error("Invalid FST file") {}
+};
+
+// bounds checked reader over a section of the file
+class Cursor {
+public:
+    Cursor(const uint8_t *data, uint64_t size) : data_(data), size_(size) {}
+
+    [[nodiscard]] bool done() const { return pos_ >= size_; }
+    [[nodiscard]] uint64_t pos() const { return pos_; }
+
+    uint8_t u8() {
+        check(1);
+        return data_[pos_++];
+    }
+
+    // fixed-size integers are big-endian
+    uint64_t u64() {
+        check(8);
+        uint64_t result = 0;
+        for (uint64_t i = 0; i < 8; i++) result = (result << 8) | data_[pos_ + i];
+        pos_ += 8;
+        return result;
+    }
+
+    uint64_t varint() {
+        uint64_t result = 0;
+        for (uint64_t shift = 0; shift < 64; shift += 7) {
+            auto b = u8();
+            result |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return result;
+        }
+        throw InvalidFST();
+    }
+
+    int64_t svarint() {
+        uint64_t result = 0;
+        uint64_t shift = 0;
+        uint8_t b;
+        do {
+            if (shift >= 64) throw InvalidFST();
+            b = u8();
+            result |= static_cast<uint64_t>(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        if (shift < 64 && (b & 0x40)) result |= ~0ull << shift;
+        return static_cast<int64_t>(result);
+    }
+
+    std::string_view str() {
+        auto const *begin = reinterpret_cast<const char *>(data_ + pos_);
+        auto const *end = static_cast<const char *>(std::memchr(begin, 0, size_ - pos_));
+        if (!end) throw InvalidFST();
+        pos_ += end - begin + 1;
+        return {begin, static_cast<uint64_t>(end - begin)};
+    }
+
+    const uint8_t *bytes(uint64_t size) {
+        check(size);
+        auto const *result = data_ + pos_;
+        pos_ += size;
+        return result;
+    }
+
+    [[nodiscard]] uint8_t peek() const {
+        if (done()) throw InvalidFST();
+        return data_[pos_];
+    }
+
+private:
+    const uint8_t *data_;
+    uint64_t size_;
+    uint64_t pos_ = 0;
+
+    void check(uint64_t size) const {
+        if (size > size_ - pos_) throw InvalidFST();
+    }
+};
+
+uint64_t read_u64(const uint8_t *data) { return Cursor(data, 8).u64(); }
+
+std::vector<uint8_t> zlib_decompress(const uint8_t *data, uint64_t size, uint64_t out_size,
+                                     bool gzip = false) {
+    std::vector<uint8_t> result(out_size);
+    z_stream stream = {};
+    // 32 enables automatic zlib/gzip header detection
+    if (inflateInit2(&stream, gzip ? 15 + 32 : 15) != Z_OK) throw InvalidFST();
+    stream.next_in = const_cast<uint8_t *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = result.data();
+    stream.avail_out = static_cast<uInt>(out_size);
+    auto ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END || stream.total_out != out_size) throw InvalidFST();
+    return result;
+}
+
+std::vector<uint8_t> lz4_decompress(const uint8_t *data, uint64_t size, uint64_t out_size) {
+    std::vector<uint8_t> result;
+    result.reserve(out_size);
+    Cursor in(data, size);
+    auto read_length = [&in](uint64_t length) {
+        if (length != 15) return length;
+        uint8_t b;
+        do {
+            b = in.u8();
+            length += b;
+        } while (b == 255);
+        return length;
+    };
+    while (!in.done()) {
+        auto token = in.u8();
+        auto literals = read_length(token >> 4);
+        auto const *src = in.bytes(literals);
+        result.insert(result.end(), src, src + literals);
+        // the last sequence only has literals
+        if (in.done()) break;
+        uint64_t offset = in.u8();
+        offset |= static_cast<uint64_t>(in.u8()) << 8;
+        auto length = read_length(token & 0xF) + 4;
+        if (offset == 0 || offset > result.size() || result.size() + length > out_size) {
+            throw InvalidFST();
+        }
+        // matches may overlap with the output
+        auto from = result.size() - offset;
+        for (uint64_t i = 0; i < length; i++) result.emplace_back(result[from + i]);
+    }
+    if (result.size() != out_size) throw InvalidFST();
+    return result;
+}
+
+std::vector<uint8_t> fastlz_decompress(const uint8_t *data, uint64_t size, uint64_t out_size) {
+    constexpr uint64_t max_distance = 8192;
+    std::vector<uint8_t> result;
+    result.reserve(out_size);
+    Cursor in(data, size);
+    auto level = (in.peek() >> 5) + 1;
+    uint64_t ctrl = in.u8() & 31;
+    while (true) {
+        if (ctrl >= 32) {
+            auto length = (ctrl >> 5) - 1;
+            auto offset = (ctrl & 31) << 8;
+            if (level == 1) {
+                if (length == 6) length += in.u8();
+                offset += in.u8();
+            } else {
+                if (length == 6) {
+                    uint8_t b;
+                    do {
+                        b = in.u8();
+                        length += b;
+                    } while (b == 255);
+                }
+                uint8_t code = in.u8();
+                offset += code;
+                // match from 16-bit distance
+                if (code == 255 && offset == (31 << 8) + 255) {
+                    offset = static_cast<uint64_t>(in.u8()) << 8;
+                    offset += in.u8();
+                    offset += max_distance;
+                }
+            }
+            length += 3;
+            // distance is offset + 1 back from the output
+            if (offset + 1 > result.size() || result.size() + length > out_size) {
+                throw InvalidFST();
+            }
+            auto from = result.size() - offset - 1;
+            for (uint64_t i = 0; i < length; i++) result.emplace_back(result[from + i]);
+        } else {
+            auto length = ctrl + 1;
+            auto const *src = in.bytes(length);
+            result.insert(result.end(), src, src + length);
+        }
+        if (in.done()) break;
+        ctrl = in.u8();
+    }
+    if (result.size() != out_size) throw InvalidFST();
+    return result;
+}
+
+// blocks store data uncompressed when compression doesn't help
+std::vector<uint8_t> zlib_decompress_if(const uint8_t *data, uint64_t size, uint64_t out_size) {
+    if (size == out_size) return {data, data + size};
+    return zlib_decompress(data, size, out_size);
+}
+
+FSTDatabase::FSTDatabase(const std::string &filename) {
+    file_ = std::make_unique<util::MappedFile>(filename);
+    if (!file_->is_open()) throw std::runtime_error("Invalid filename " + filename);
+    data_ = reinterpret_cast<const uint8_t *>(file_->data());
+    size_ = file_->size();
+    parse();
+}
+
+void FSTDatabase::parse() {
+    if (size_ > 0 && data_[0] == block_zwrapper) {
+        // the whole file is gzip compressed
+        Cursor cursor(data_ + 1, size_ - 1);
+        auto section_size = cursor.u64();
+        auto uncompressed_size = cursor.u64();
+        if (section_size > size_ - 1 || section_size < 16) throw InvalidFST();
+        auto inflated = zlib_decompress(data_ + 17, section_size - 16, uncompressed_size, true);
+        inflated_.assign(inflated.begin(), inflated.end());
+        data_ = reinterpret_cast<const uint8_t *>(inflated_.data());
+        size_ = inflated_.size();
+    }
+
+    uint64_t pos = 0;
+    while (pos < size_) {
+        auto type = data_[pos];
+        if (size_ - pos < 9) throw InvalidFST();
+        // section size includes the size field but not the type
+        auto section_size = read_u64(data_ + pos + 1);
+        // a skip block marks a block that was still being written
+        if (type == block_skip && section_size == 0) break;
+        if (section_size < 8 || section_size > size_ - pos - 1) throw InvalidFST();
+        auto offset = pos + 1;
+        auto const *data = data_ + offset;
+        switch (type) {
+            case block_header:
+                parse_header(data, section_size);
+                break;
+            case block_vc_data:
+            case block_vc_data_alias:
+            case block_vc_data_alias2:
+                parse_block(data, section_size, offset, type);
+                break;
+            case block_geometry:
+                parse_geometry(data, section_size);
+                break;
+            case block_hierarchy:
+            case block_hierarchy_lz4:
+            case block_hierarchy_lz4_duo:
+                parse_hierarchy(data, section_size, type);
+                break;
+            case block_blackout:
+            case block_skip:
+            default:
+                break;
+        }
+        pos += 1 + section_size;
+    }
+
+    // frame values are laid out back to back
+    frame_offsets_.resize(lengths_.size() + 1, 0);
+    for (uint64_t i = 0; i < lengths_.size(); i++) {
+        frame_offsets_[i + 1] = frame_offsets_[i] + (is_real_[i] ? 8 : lengths_[i]);
+    }
+}
+
+void FSTDatabase::parse_header(const uint8_t *data, uint64_t size) {
+    Cursor cursor(data, size);
+    cursor.u64();
+    // start time, end time, endian test, writer memory, scope count and var count
+    cursor.bytes(8 * 6);
+    max_handle_ = cursor.u64();
+    // vc section count
+    cursor.u64();
+    timescale_ = static_cast<int8_t>(cursor.u8());
+}
+
+void FSTDatabase::parse_geometry(const uint8_t *data, uint64_t size) {
+    Cursor cursor(data, size);
+    cursor.u64();
+    auto uncompressed_size = cursor.u64();
+    auto max_handle = cursor.u64();
+    auto compressed_size = size - cursor.pos();
+    auto geometry =
+        zlib_decompress_if(cursor.bytes(compressed_size), compressed_size, uncompressed_size);
+    Cursor lengths(geometry.data(), geometry.size());
+    lengths_.resize(max_handle);
+    is_real_.resize(max_handle);
+    for (uint64_t i = 0; i < max_handle; i++) {
+        auto length = lengths.varint();
+        // 0 marks a real and 0xFFFFFFFF a zero-width signal
+        is_real_[i] = length == 0;
+        lengths_[i] = length == 0xFFFFFFFF ? 0 : static_cast<uint32_t>(length);
+    }
+}
+
+void FSTDatabase::parse_hierarchy(const uint8_t *data, uint64_t size, uint8_t type) {
+    Cursor cursor(data, size);
+    cursor.u64();
+    auto uncompressed_size = cursor.u64();
+    std::vector<uint8_t> hierarchy;
+    if (type == block_hierarchy) {
+        auto compressed_size = size - cursor.pos();
+        hierarchy = zlib_decompress(cursor.bytes(compressed_size), compressed_size,
+                                    uncompressed_size, true);
+    } else if (type == block_hierarchy_lz4) {
+        auto compressed_size = size - cursor.pos();
+        hierarchy =
+            lz4_decompress(cursor.bytes(compressed_size), compressed_size, uncompressed_size);
+    } else {
+        // compressed twice
+        auto intermediate_size = cursor.varint();
+        auto compressed_size = size - cursor.pos();
+        auto intermediate =
+            lz4_decompress(cursor.bytes(compressed_size), compressed_size, intermediate_size);
+        hierarchy = lz4_decompress(intermediate.data(), intermediate.size(), uncompressed_size);
+    }
+
+    Cursor records(hierarchy.data(), hierarchy.size());
+    std::vector<std::string> scopes;
+    uint64_t num_handles = 0;
+    while (!records.done()) {
+        auto tag = records.u8();
+        switch (tag) {
+            case tag_scope: {
+                // scope type, name and component
+                records.u8();
+                scopes.emplace_back(records.str());
+                records.str();
+                break;
+            }
+            case tag_upscope: {
+                if (!scopes.empty()) scopes.pop_back();
+                break;
+            }
+            case tag_attr_begin: {
+                // attribute type, subtype, name and argument
+                records.u8();
+                records.u8();
+                records.str();
+                records.varint();
+                break;
+            }
+            case tag_attr_end: {
+                break;
+            }
+            default: {
+                if (tag > max_var_type) throw InvalidFST();
+                // direction
+                records.u8();
+                auto name = records.str();
+                auto width = records.varint();
+                auto alias = records.varint();
+                auto handle = alias == 0 ? ++num_handles : alias;
+                // VCD converters keep the bit range as part of the name
+                name = name.substr(0, name.find(' '));
+
+                auto signal = std::make_shared<vcd::VCDSignal>();
+                signal->identifier = std::to_string(handle);
+                signal->name = name;
+                signal->path = fmt::format("{0}.{1}", fmt::join(scopes.begin(), scopes.end(), "."),
+                                           name);
+                signal->width = width;
+                signal->db = this;
+                signal->raw_values = nullptr;
+                signals.emplace(signal->path, signal);
+                break;
+            }
+        }
+    }
+}
+
+void FSTDatabase::parse_block(const uint8_t *data, uint64_t size, uint64_t offset,
+                              uint8_t type) {
+    Block block;
+    block.type = type;
+    Cursor cursor(data, size);
+    cursor.u64();
+    block.begin_time = cursor.u64();
+    // end time and the memory required for traversal
+    cursor.u64();
+    cursor.u64();
+
+    // values of every signal at the beginning of the block
+    auto frame_size = cursor.varint();
+    auto frame_compressed_size = cursor.varint();
+    cursor.varint();
+    auto const *frame = cursor.bytes(frame_compressed_size);
+    if (blocks_.empty()) {
+        frame_ = zlib_decompress_if(frame, frame_compressed_size, frame_size);
+    }
+
+    block.max_handle = cursor.varint();
+    block.vc_start = offset + cursor.pos();
+    block.pack_type = cursor.u8();
+
+    // the time table and the chain table are stored backwards from the end of the block
+    if (size < cursor.pos() + 24) throw InvalidFST();
+    Cursor trailer(data + size - 24, 24);
+    auto time_size = trailer.u64();
+    auto time_compressed_size = trailer.u64();
+    auto num_times = trailer.u64();
+    if (size - cursor.pos() - 24 < time_compressed_size + 8) throw InvalidFST();
+    auto time_pos = size - 24 - time_compressed_size;
+    auto time_table = zlib_decompress_if(data + time_pos, time_compressed_size, time_size);
+    Cursor time_cursor(time_table.data(), time_table.size());
+    block.times.resize(num_times);
+    uint64_t time = 0;
+    for (uint64_t i = 0; i < num_times; i++) {
+        time += time_cursor.varint();
+        block.times[i] = time;
+        times.emplace_hint(times.end(), time);
+    }
+
+    block.chain_size = read_u64(data + time_pos - 8);
+    if (block.chain_size > time_pos - 8 - cursor.pos()) throw InvalidFST();
+    block.chain_pos = offset + time_pos - 8 - block.chain_size;
+
+    blocks_.emplace_back(std::move(block));
+}
+
+void FSTDatabase::decode_chains(Block &block) const {
+    auto num_handles = block.max_handle;
+    std::vector<uint64_t> offsets(num_handles + 1, 0);
+    // negative lengths are aliases to the handle index - 1
+    std::vector<int64_t> lengths(num_handles + 1, 0);
+    uint64_t index = 0, prev_index = 0, offset = 0;
+    int64_t prev_alias = 0;
+    Cursor cursor(data_ + block.chain_pos, block.chain_size);
+    auto set_offset = [&](uint64_t delta) {
+        if (index >= num_handles) throw InvalidFST();
+        offset += delta;
+        offsets[index] = offset;
+        if (index) lengths[prev_index] = static_cast<int64_t>(offset - offsets[prev_index]);
+        prev_index = index++;
+    };
+    auto set_alias = [&](int64_t alias) {
+        if (index >= num_handles) throw InvalidFST();
+        lengths[index++] = alias;
+    };
+    auto skip = [&](uint64_t count) {
+        if (count > num_handles - index) throw InvalidFST();
+        index += count;
+    };
+
+    while (!cursor.done()) {
+        if (block.type == block_vc_data_alias2) {
+            if (cursor.peek() & 1) {
+                auto value = cursor.svarint() >> 1;
+                if (value > 0) {
+                    set_offset(value);
+                } else if (value < 0) {
+                    prev_alias = value;
+                    set_alias(value);
+                } else {
+                    // same as the previous alias
+                    set_alias(prev_alias);
+                }
+            } else {
+                skip(cursor.varint() >> 1);
+            }
+        } else {
+            auto value = cursor.varint();
+            if (value == 0) {
+                set_alias(-static_cast<int64_t>(cursor.varint()));
+            } else if (value & 1) {
+                set_offset(value >> 1);
+            } else {
+                skip(value >> 1);
+            }
+        }
+    }
+    // the last chain ends where the chain table starts
+    offsets[index] = block.chain_pos - block.vc_start;
+    lengths[prev_index] = static_cast<int64_t>(offsets[index] - offsets[prev_index]);
+
+    block.chain_offsets.resize(index, 0);
+    block.chain_lengths.resize(index, 0);
+    for (uint64_t i = 0; i < index; i++) {
+        auto length = lengths[i];
+        if (offsets[i] == 0 && length < 0) {
+            auto target = static_cast<uint64_t>(-length - 1);
+            // aliases only point backwards
+            if (target >= i) continue;
+            offsets[i] = offsets[target];
+            lengths[i] = lengths[target];
+        }
+        if (lengths[i] < 0) continue;
+        block.chain_offsets[i] = offsets[i];
+        block.chain_lengths[i] = static_cast<uint64_t>(lengths[i]);
+    }
+}
+
+void FSTDatabase::decode_values(const Block &block, uint64_t handle,
+                                std::vector<std::pair<uint64_t, std::string>> &changes) const {
+    auto index = handle - 1;
+    if (index >= block.chain_offsets.size() || block.chain_offsets[index] == 0) return;
+    if (index >= lengths_.size()) throw InvalidFST();
+    auto start = block.vc_start + block.chain_offsets[index];
+    auto length = block.chain_lengths[index];
+    if (start > size_ || length > size_ - start) throw InvalidFST();
+
+    Cursor cursor(data_ + start, length);
+    auto uncompressed_size = cursor.varint();
+    auto compressed_size = length - cursor.pos();
+    auto const *compressed = cursor.bytes(compressed_size);
+    // 0 means the chain is not compressed
+    std::vector<uint8_t> chain;
+    if (uncompressed_size == 0) {
+        chain.assign(compressed, compressed + compressed_size);
+    } else if (block.pack_type == '4') {
+        chain = lz4_decompress(compressed, compressed_size, uncompressed_size);
+    } else if (block.pack_type == 'F') {
+        chain = fastlz_decompress(compressed, compressed_size, uncompressed_size);
+    } else {
+        chain = zlib_decompress(compressed, compressed_size, uncompressed_size);
+    }
+
+    auto width = lengths_[index];
+    auto is_real = is_real_[index];
+    Cursor values(chain.data(), chain.size());
+    uint64_t time_index = 0;
+    while (!values.done()) {
+        auto code = values.varint();
+        std::string value;
+        if (is_real) {
+            time_index += code >> 1;
+            double real;
+            std::memcpy(&real, values.bytes(sizeof(real)), sizeof(real));
+            value = fmt::format("{}", real);
+        } else if (width <= 1) {
+            // the time delta is shifted further for non-binary values
+            time_index += code >> (2 << (code & 1));
+            if (width == 0) continue;
+            value = (code & 1) ? single_bit_values[(code >> 1) & 7]
+                               : static_cast<char>('0' + ((code >> 1) & 1));
+        } else {
+            time_index += code >> 1;
+            if (code & 1) {
+                auto const *chars = values.bytes(width);
+                value.assign(chars, chars + width);
+            } else {
+                // bits are packed most significant first
+                auto const *bits = values.bytes((width + 7) / 8);
+                value.resize(width);
+                for (uint64_t i = 0; i < width; i++) {
+                    value[i] = static_cast<char>('0' + ((bits[i / 8] >> (7 - (i % 8))) & 1));
+                }
+            }
+        }
+        if (time_index >= block.times.size()) throw InvalidFST();
+        // keep the last value if a signal changes more than once in a time step
+        if (!changes.empty() && changes.back().first == block.times[time_index]) {
+            changes.back().second = std::move(value);
+        } else {
+            changes.emplace_back(block.times[time_index], std::move(value));
+        }
+    }
+}
+
+std::string FSTDatabase::frame_value(uint64_t handle) const {
+    auto index = handle - 1;
+    if (index >= lengths_.size() || frame_offsets_[index + 1] > frame_.size()) return "x";
+    auto const *data = frame_.data() + frame_offsets_[index];
+    if (is_real_[index]) {
+        double real;
+        std::memcpy(&real, data, sizeof(real));
+        return fmt::format("{}", real);
+    }
+    return {data, data + lengths_[index]};
+}
+
+std::vector<std::shared_ptr<const vcd::VCDValueStore>> FSTDatabase::load_values(
+    const std::vector<std::string> &identifiers, uint64_t time) {
+    std::vector<std::shared_ptr<const vcd::VCDValueStore>> result;
+    result.reserve(identifiers.size());
+    std::lock_guard lock(decoded_mutex_);
+    for (auto const &identifier : identifiers) {
+        auto &decoded = decoded_[identifier];
+        decode_blocks(decoded, std::stoull(identifier), time);
+        result.emplace_back(decoded.store);
+    }
+    return result;
+}
+
+void FSTDatabase::decode_blocks(DecodedValues &decoded, uint64_t handle, uint64_t time) {
+    auto const &store = decoded.store;
+    std::vector<std::pair<uint64_t, std::string>> changes;
+    auto last_time = [&]() -> std::optional<uint64_t> {
+        if (!changes.empty()) return changes.back().first;
+        if (store && !store->empty()) return store->time(store->size() - 1);
+        return std::nullopt;
+    };
+    // every value change up to time is in the blocks that start no later than it. the first
+    // change after time may be in any of the following blocks
+    auto num_blocks = decoded.num_blocks;
+    uint64_t min_blocks = 0;
+    while (num_blocks < blocks_.size()) {
+        auto t = last_time();
+        auto covered = blocks_[num_blocks].begin_time > time && t && *t > time;
+        if (covered && num_blocks >= min_blocks) break;
+        // extending copies the store, so at least as many blocks as before are decoded at once
+        if (min_blocks == 0) min_blocks = std::min<uint64_t>(blocks_.size(), num_blocks * 2);
+
+        auto &block = blocks_[num_blocks];
+        if (block.chain_offsets.empty()) decode_chains(block);
+        if (num_blocks == 0) {
+            auto value = frame_value(handle);
+            if (!value.empty()) changes.emplace_back(block.begin_time, std::move(value));
+        }
+        decode_values(block, handle, changes);
+        num_blocks++;
+    }
+    decoded.num_blocks = num_blocks;
+    if (changes.empty()) return;
+
+    std::shared_ptr<vcd::VCDValueStore> next;
+    if (!store) {
+        next = std::make_shared<vcd::VCDValueStore>();
+    } else if (!store->empty() && store->time(store->size() - 1) == changes.front().first) {
+        // the last value wins if a block starts at the time the previous one ends
+        next = std::make_shared<vcd::VCDValueStore>(store->slice(store->size() - 1));
+    } else {
+        next = std::make_shared<vcd::VCDValueStore>(*store);
+    }
+    for (auto const &[t, value] : changes) next->add(t, value);
+    next->shrink_to_fit();
+    decoded.store = std::move(next);
+}
+
+std::map<std::string, uint64_t> FSTDatabase::get_stats() const {
+    uint64_t total_size = sizeof(decoded_), before_size = 0;
+    std::lock_guard lock(decoded_mutex_);
+    for (auto const &[name, decoded] : decoded_) {
+        if (!decoded.store) continue;
+        total_size += name.capacity() + decoded.store->size_in_bytes();
+        before_size += decoded.store->value_bytes();
+    }
+    // aliases share the same handle, so they would take the same space again without aliasing
+    uint64_t after_size = 0;
+    std::unordered_set<std::string> identifiers;
+    for (auto const &[path, signal] : signals) {
+        identifiers.emplace(signal->identifier);
+        auto it = decoded_.find(signal->identifier);
+        if (it != decoded_.end() && it->second.store) {
+            after_size += it->second.store->value_bytes();
+        }
+    }
+    return {{"total_size", total_size},
+            {"num_aliased", signals.size() - identifiers.size()},
+            {"before_size", before_size},
+            {"after_size", after_size}};
+}
+
+}  // namespace hgdb::fst
@@ -0,0 +1,82 @@
+#ifndef HGDB_RTL_FST_HH
+#define HGDB_RTL_FST_HH
+
+#include "vcd.hh"
+
+namespace hgdb::fst {
+
+// reader for the FST format produced by GTKWave, Verilator and Icarus. only the header,
+// hierarchy and time tables are read when the file is opened. the value changes of a signal
+// are stored per time block and compressed per signal, so a query only decompresses the
+// chains of the signals it touches. identifiers are the FST handles
+class FSTDatabase : public vcd::WaveformDatabase {
+public:
+    explicit FSTDatabase(const std::string &filename);
+
+    [[nodiscard]] std::map<std::string, uint64_t> get_stats() const override;
+
+    // timescale exponent, e.g. -9 for 1ns
+    [[nodiscard]] int8_t timescale() const { return timescale_; }
+
+protected:
+    std::vector<std::shared_ptr<const vcd::VCDValueStore>> load_values(
+        const std::vector<std::string> &identifiers, uint64_t time) override;
+
+private:
+    std::unique_ptr<util::MappedFile> file_;
+    // whole-file compressed FST is inflated into memory
+    std::vector<char> inflated_;
+    const uint8_t *data_ = nullptr;
+    uint64_t size_ = 0;
+
+    int8_t timescale_ = 0;
+    uint64_t max_handle_ = 0;
+    // bit width of each handle. reals take 8 bytes in the frame and are flagged separately
+    std::vector<uint32_t> lengths_;
+    std::vector<bool> is_real_;
+    std::vector<uint64_t> frame_offsets_;
+
+    struct Block {
+        uint8_t type;
+        uint64_t begin_time;
+        // absolute offset of the pack type byte, which chain offsets are relative to
+        uint64_t vc_start;
+        uint8_t pack_type;
+        uint64_t max_handle;
+        uint64_t chain_pos;
+        uint64_t chain_size;
+        std::vector<uint64_t> times;
+        // decoded on the first signal load. an offset of 0 means no value change
+        std::vector<uint64_t> chain_offsets;
+        std::vector<uint64_t> chain_lengths;
+    };
+    std::vector<Block> blocks_;
+    // initial values of every handle, taken from the frame of the first block
+    std::vector<uint8_t> frame_;
+
+    // blocks are decoded in order and only as far as queries need them. a store is never
+    // changed once it's handed out, extending it creates a new one
+    struct DecodedValues {
+        std::shared_ptr<const vcd::VCDValueStore> store;
+        uint64_t num_blocks = 0;
+    };
+    // also guards the chain tables of the blocks, which are decoded on first use
+    mutable std::mutex decoded_mutex_;
+    std::unordered_map<std::string, DecodedValues> decoded_;
+
+    void parse();
+    void parse_header(const uint8_t *data, uint64_t size);
+    void parse_geometry(const uint8_t *data, uint64_t size);
+    void parse_hierarchy(const uint8_t *data, uint64_t size, uint8_t type);
+    void parse_block(const uint8_t *data, uint64_t size, uint64_t offset, uint8_t type);
+    void decode_chains(Block &block) const;
+    void decode_blocks(DecodedValues &decoded, uint64_t handle, uint64_t time);
+    // appends (time index, value) of every value change of the handle in the block
+    void decode_values(const Block &block, uint64_t handle,
+                       std::vector<std::pair<uint64_t, std::string>> &changes) const;
+    [[nodiscard]] std::string frame_value(uint64_t handle) const;
+};
+
+}  // namespace hgdb::fst
+
+#endif  // HGDB_RTL_FST_HH
@@ -1,9 +1,16 @@
 #include "log.hh"
 
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <future>
 #include <limits>
+#include <unordered_map>
+#include <stdexcept>
 #include <type_traits>
 
 #include "lz/lz.hh"
+#include "util.hh"
 
 namespace hgdb::log {
 
@@ -25,7 +32,8 @@ LogFile::~LogFile() {
 
 LogPrintfParser::LogPrintfParser(const std::string &format,
                                  const std::vector<std::string> &attr_names)
-    : time_index_(std::numeric_limits<uint64_t>::max()) {
+    : source_(format), time_index_(std::numeric_limits<uint64_t>::max()) {
+    for (auto const &name : attr_names) source_.append(1, '\0').append(name);
     parse_format(format);
     if (types_.size() != (attr_names.size() + 1) ||
         time_index_ == std::numeric_limits<uint64_t>::max()) {
@@ -68,8 +76,10 @@ void LogPrintfParser::parse_format(const std::string &format) {
     // we are interested in any $display related formatting
     // hand-rolled FSM-based parser
     int state = 0;
-    std::string regex_data;
-    regex_data.reserve(format.size() * 2);
+    auto add_literal = [this](char c) {
+        if (tokens_.empty() || tokens_.back().spec) tokens_.emplace_back();
+        tokens_.back().literal.push_back(c);
+    };
 
     for (auto c : format) {
         if (state == 0) {
@@ -79,88 +89,179 @@ void LogPrintfParser::parse_format(const std::string &format) {
             } else if (c == '%') {
                 state = 1;
             } else {
-                regex_data.append(std::string(1, c));
+                add_literal(c);
             }
         } else if (state == 1) {
             if (isdigit(c)) {
                 continue;
             } else if (c == 'd') {
-                // put number regex here
                 types_.emplace_back(ValueType::Int);
-                regex_data.append(R"(\s?(\d+))");
             } else if (c == 't') {
                 types_.emplace_back(ValueType::Time);
-                regex_data.append(R"(\s?(\d+))");
                 time_index_ = types_.size();
             } else if (c == 'x' || c == 'X') {
                 types_.emplace_back(ValueType::Hex);
-                regex_data.append(R"(\s?([\da-fA-F]+))");
-            } else if (c == 's') {
+                c = 'x';
+            } else if (c == 's' || c == 'm') {
                 types_.emplace_back(ValueType::Str);
-                regex_data.append(R"((\w+))");
-            } else if (c == 'm') {
-                types_.emplace_back(ValueType::Str);
-                regex_data.append(R"(([\w$_\d.]+))");
             } else if (c == 'f') {
                 types_.emplace_back(ValueType::Float);
-                regex_data.append(R"(([+-]?([0-9]*[.])?[0-9]+))");
             } else {
                 throw std::runtime_error("Unknown formatter " + std::string(1, c));
             }
+            tokens_.emplace_back(Token{{}, c, types_.size() - 1});
             state = 0;
         } else {
-            if (c == '%') {
-                // no need to escape this at all
-                regex_data.append(std::string(1, c));
-            } else {
-                regex_data.append(std::string(1, '\\'));
-                regex_data.append(std::string(1, c));
-            }
+            add_literal(c == 'n' ? '\n' : c == 't' ? '\t' : c);
             state = 0;
         }
     }
-    // set the regex
-    re_ = std::regex(regex_data);
 }
 
-LogItem LogPrintfParser::parse(const std::string &content) {
+bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_word(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool in_field(char spec, char c) {
+    switch (spec) {
+        case 'd':
+        case 't':
+            return is_digit(c);
+        case 'x':
+            return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        case 's':
+            return is_word(c);
+        case 'm':
+            // hierarchical names
+            return is_word(c) || c == '$' || c == '.';
+        default:
+            return false;
+    }
+}
+
+// [+-]?([0-9]*[.])?[0-9]+, trying the candidate ends in the order a regex engine would
+template <typename F>
+bool match_float(std::string_view line, uint64_t pos, const F &accept) {
+    auto digits_end = [line](uint64_t i) {
+        while (i < line.size() && is_digit(line[i])) i++;
+        return i;
+    };
+    auto mantissa = [&](uint64_t i) {
+        auto int_end = digits_end(i);
+        if (int_end < line.size() && line[int_end] == '.') {
+            for (auto end = digits_end(int_end + 1); end > int_end + 1; end--) {
+                if (accept(end)) return true;
+            }
+        }
+        for (auto end = int_end; end > i; end--) {
+            if (accept(end)) return true;
+        }
+        return false;
+    };
+    if (pos < line.size() && (line[pos] == '+' || line[pos] == '-') && mantissa(pos + 1)) {
+        return true;
+    }
+    return mantissa(pos);
+}
+
+bool LogPrintfParser::match(std::string_view line, uint64_t token, uint64_t pos,
+                            std::vector<std::string_view> &fields) const {
+    if (token == tokens_.size()) return true;
+    auto const &t = tokens_[token];
+    if (!t.spec) {
+        if (line.substr(pos, t.literal.size()) != t.literal) return false;
+        return match(line, token + 1, pos + t.literal.size(), fields);
+    }
+    auto begin = pos;
+    auto accept = [&](uint64_t end) {
+        fields[t.field] = line.substr(begin, end - begin);
+        return match(line, token + 1, end, fields);
+    };
+    if (t.spec == 'f') return match_float(line, pos, accept);
+    // greedy runs of the field characters. numbers may be preceded by one whitespace
+    auto run = [&]() {
+        auto end = begin;
+        while (end < line.size() && in_field(t.spec, line[end])) end++;
+        for (; end > begin; end--) {
+            if (accept(end)) return true;
+        }
+        return false;
+    };
+    if (t.spec == 'd' || t.spec == 't' || t.spec == 'x') {
+        if (pos < line.size() && is_space(line[pos])) {
+            begin = pos + 1;
+            if (run()) return true;
+            begin = pos;
+        }
+    }
+    return run();
+}
+
+template <typename T>
+T parse_value(std::string_view str, int base = 10) {
+    // from_chars doesn't take the plus sign
+    if (!str.empty() && str.front() == '+') str.remove_prefix(1);
+    T value{};
+    std::from_chars_result result{};
+    if constexpr (std::is_floating_point_v<T>) {
+        result = std::from_chars(str.data(), str.data() + str.size(), value);
+    } else {
+        result = std::from_chars(str.data(), str.data() + str.size(), value, base);
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("Log value out of range: " + std::string(str));
+    }
+    return value;
+}
+
+LogItem LogFormatParser::parse_line(std::string_view line) { return parse(std::string(line)); }
+
+LogItem LogPrintfParser::parse(const std::string &content) { return parse_line(content); }
+
+LogItem LogPrintfParser::parse_line(std::string_view line) {
     auto log = LogItem();
     if (has_error()) {
         return log;
     }
-    std::smatch matches;
-
-    if (std::regex_search(content, matches, re_)) {
-        for (auto i = 1u; i < matches.size(); i++) {
-            // need to convert the types
-            auto idx = i - 1;
-            auto type = types_[idx];
-            auto const &match = matches[i];
-            switch (type) {
-                case ValueType::Int: {
-                    auto value = std::stol(match.str());
-                    log.int_values.emplace_back(value);
-                    break;
-                }
-                case ValueType::Time: {
-                    auto value = std::stol(match.str());
-                    log.time = value;
-                    break;
-                }
-                case ValueType::Hex: {
-                    auto value = std::stol(match.str(), nullptr, 16);
-                    log.int_values.emplace_back(value);
-                    break;
-                }
-                case ValueType::Float: {
-                    auto value = std::stof(match.str());
-                    log.float_values.emplace_back(value);
-                    break;
-                }
-                case ValueType::Str: {
-                    log.str_values.emplace_back(match.str());
-                    break;
-                }
+    // reused across lines to avoid allocations. parsers may run on several threads
+    thread_local std::vector<std::string_view> fields;
+    fields.assign(types_.size(), {});
+    // a leading literal anchors the candidate positions
+    auto anchor = tokens_.front().spec ? std::string_view() : tokens_.front().literal;
+    bool found = false;
+    for (auto pos = line.find(anchor); pos != std::string_view::npos && !found;
+         pos = pos < line.size() ? line.find(anchor, pos + 1) : std::string_view::npos) {
+        found = match(line, 0, pos, fields);
+    }
+    if (!found) return log;
+
+    for (uint64_t i = 0; i < types_.size(); i++) {
+        auto const &field = fields[i];
+        switch (types_[i]) {
+            case ValueType::Int: {
+                log.int_values.emplace_back(parse_value<int64_t>(field));
+                break;
+            }
+            case ValueType::Time: {
+                log.time = parse_value<int64_t>(field);
+                break;
+            }
+            case ValueType::Hex: {
+                log.int_values.emplace_back(parse_value<int64_t>(field, 16));
+                break;
+            }
+            case ValueType::Float: {
+                // single precision, same as std::stof
+                log.float_values.emplace_back(parse_value<float>(field));
+                break;
+            }
+            case ValueType::Str: {
+                log.str_values.emplace_back(field);
+                break;
             }
         }
     }
@@ -176,8 +277,16 @@ void write_data(std::vector<char> &data, uint64_t &pos, T v) {
     pos += sizeof(T);
 }
 
+// batches of a mapped store may be corrupted, so lengths are checked against the data
+void check_length(const std::vector<char> &data, uint64_t pos, uint64_t size) {
+    if (pos > data.size() || size > data.size() - pos) {
+        throw std::runtime_error("Invalid log batch");
+    }
+}
+
 template <typename T>
 T read_data(const std::vector<char> &data, uint64_t &pos) {
+    check_length(data, pos, sizeof(T));
     const char *raw_ptr = data.data() + pos;
     auto const *ptr = reinterpret_cast<const T *>(raw_ptr);
     T v = *ptr;
@@ -217,13 +326,19 @@ void serialize(std::vector<char> &data, const std::vector<T> &values) {
 template <typename T>
 std::vector<T> deserialize(const std::vector<char> &data, uint64_t &pos) {
     auto size = read_data<uint64_t>(data, pos);
+    // every entry takes at least one byte
+    check_length(data, pos, size);
     std::vector<T> result(size);
     if constexpr (std::is_same<std::string, T>::value) {
         for (uint64_t i = 0; i < size; i++) {
-            result[i] = std::string(data.data() + pos);
+            auto const *begin = data.data() + pos;
+            auto const *end = std::find(begin, data.data() + data.size(), '\0');
+            if (end == data.data() + data.size()) throw std::runtime_error("Invalid log batch");
+            result[i] = std::string(begin, end);
             pos += result[i].size() + 1;
         }
     } else {
+        check_length(data, pos, size * sizeof(T));
         for (uint64_t i = 0; i < size; i++) {
             result[i] = read_data<T>(data, pos);
         }
@@ -231,11 +346,25 @@ std::vector<T> deserialize(const std::vector<char> &data, uint64_t &pos) {
     return result;
 }
 
+std::vector<char> LogItemBatch::decompress() const {
+    // batches of a mapped store don't own their data
+    if (data_.data() == raw_data_.data()) return lz::decompress(raw_data_);
+    return lz::decompress(std::vector<char>(data_.begin(), data_.end()));
+}
+
+std::vector<uint64_t> LogItemBatch::get_times() const {
+    uint64_t pos = 0;
+    auto data = decompress();
+    auto times = deserialize<uint64_t>(data, pos);
+    if (times.size() != size_) throw std::runtime_error("Invalid log batch");
+    return times;
+}
+
 void LogItemBatch::get_items(const std::vector<LogItem *> &items) const {
     // we first decompress each column
     uint64_t pos = 0;
 
-    std::vector data = lz::decompress(raw_data_);
+    auto data = decompress();
 
     auto times = deserialize<uint64_t>(data, pos);
     auto int_values = deserialize<int64_t>(data, pos);
@@ -266,6 +395,10 @@ void LogItemBatch::get_items(const std::vector<LogItem *> &items) const {
             }
         }
     }
+    if (times.size() != size_ || int_values.size() != size_ * int_size ||
+        float_values.size() != size_ * float_size || str_values.size() != size_ * str_size) {
+        throw std::runtime_error("Invalid log batch");
+    }
     uint64_t int_pos = 0, float_pos = 0, str_pos = 0;
     for (uint64_t i = 0; i < size_; i++) {
         items[i]->time = times[i];
@@ -284,15 +417,9 @@ void LogItemBatch::get_items(const std::vector<LogItem *> &items) const {
 }
 
 std::unique_ptr<LogItemBatch> compress(const LogPrintfParser::Format &format,
-                                       std::vector<LogItem> &items,
-                                       std::vector<std::shared_ptr<LogIndex>> &item_index_,
-                                       uint64_t batch_idx) {
+                                       std::vector<LogItem> &items) {
     // we perform column based storage
     if (items.empty()) return nullptr;
-    for (uint64_t i = 0; i < items.size(); i++) {
-        auto entry = std::make_shared<LogIndex>(batch_idx, i);
-        item_index_.emplace_back(entry);
-    }
     // need to construct data array
     std::vector<char> uncompressed_data;
     // we do column storage
@@ -300,7 +427,13 @@ std::unique_ptr<LogItemBatch> compress(const LogPrintfParser::Format &format,
 
     std::vector<uint64_t> times;
     times.reserve(items.size());
-    for (auto const &item : items) times.emplace_back(item.time);
+    LogTimeRange time_range{items.front().time, items.front().time};
+    for (auto const &item : items) {
+        if (!times.empty() && item.time < times.back()) time_range.sorted = false;
+        time_range.min = std::min(time_range.min, item.time);
+        time_range.max = std::max(time_range.max, item.time);
+        times.emplace_back(item.time);
+    }
     serialize(uncompressed_data, times);
 
     std::vector<int64_t> int_values;
@@ -323,12 +456,106 @@ std::unique_ptr<LogItemBatch> compress(const LogPrintfParser::Format &format,
 
     auto compressed_data = lz::compress(uncompressed_data, compression_level);
 
-    auto ptr = std::make_unique<LogItemBatch>(items.size(), compressed_data, format);
+    auto ptr = std::make_unique<LogItemBatch>(items.size(), compressed_data, format, time_range);
     items.clear();
     return ptr;
 }
 
+// calls func with every non-empty line, without the line break
+template <typename F>
+void for_each_line(std::string_view data, F &&func) {
+    uint64_t pos = 0;
+    while (pos < data.size()) {
+        auto end = data.find('\n', pos);
+        if (end == std::string_view::npos) end = data.size();
+        if (end > pos) func(data.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+// chunks are parsed and full batches compressed on the workers. results are consumed in
+// submission order, so batches end up the same as the single threaded ones
+class LogPipeline {
+public:
+    using Commit = std::function<void(std::unique_ptr<LogItemBatch>)>;
+
+    LogPipeline(uint64_t num_threads, uint64_t batch_size, const LogFormatParser::Format &format,
+                Commit commit)
+        : pool_(num_threads),
+          max_pending_(num_threads * 2),
+          batch_size_(batch_size),
+          format_(format),
+          commit_(std::move(commit)) {
+        batch_.reserve(batch_size_);
+    }
+
+    // the owner, if any, keeps the chunk alive until it is parsed. otherwise the chunk has to
+    // stay valid until finish()
+    void submit(LogFormatParser &parser, std::string_view chunk,
+                std::shared_ptr<const std::string> owner = nullptr) {
+        parsed_.emplace_back(pool_.enqueue([&parser, chunk, owner, format = &format_]() {
+            std::vector<LogItem> items;
+            for_each_line(chunk, [&](std::string_view line) {
+                auto &item = items.emplace_back(parser.parse_line(line));
+                item.format = format;
+            });
+            return items;
+        }));
+        collect(max_pending_);
+    }
+
+    void finish() {
+        collect(0);
+        if (!batch_.empty()) flush();
+        commit(0);
+    }
+
+private:
+    util::ThreadPool pool_;
+    // bounds the memory held by chunks and batches in flight
+    uint64_t max_pending_;
+    uint64_t batch_size_;
+    const LogFormatParser::Format &format_;
+    Commit commit_;
+    std::deque<std::future<std::vector<LogItem>>> parsed_;
+    std::deque<std::future<std::unique_ptr<LogItemBatch>>> compressed_;
+    std::vector<LogItem> batch_;
+
+    void commit(uint64_t max_size) {
+        while (compressed_.size() > max_size) {
+            commit_(compressed_.front().get());
+            compressed_.pop_front();
+        }
+    }
+
+    void flush() {
+        compressed_.emplace_back(
+            pool_.enqueue([format = &format_, items = std::move(batch_)]() mutable {
+                return compress(*format, items);
+            }));
+        batch_ = {};
+        batch_.reserve(batch_size_);
+        commit(max_pending_);
+    }
+
+    void collect(uint64_t max_size) {
+        while (parsed_.size() > max_size) {
+            auto items = parsed_.front().get();
+            parsed_.pop_front();
+            for (auto &item : items) {
+                batch_.emplace_back(std::move(item));
+                if (batch_.size() >= batch_size_) flush();
+            }
+        }
+    }
+};
+
 std::set<uint64_t> LogDatabase::parse(const std::string &filename, LogFormatParser &parser) {
+    util::MappedFile mapped(filename);
+    if (mapped.is_open()) {
+        return parse(std::string_view(mapped.data(), mapped.size()), parser);
+    }
+    // empty files and the ones that can't be mapped
     LogFile file(filename);
     return parse(file, parser);
 }
@@ -340,38 +567,120 @@ std::set<uint64_t> LogDatabase::parse(std::istream &stream, LogFormatParser &par
 
 std::set<uint64_t> LogDatabase::parse(LogFile &file, LogFormatParser &parser) {
     std::set<uint64_t> result;
-    std::vector<LogItem> batch;
-    batch.reserve(batch_size_);
     formats_.emplace_back(parser.format);
     auto *format = &formats_.back();
     uint64_t start_idx = batches_.size();
 
-    // we first parse the file to create raw files
-    std::string line;
     if (file.stream->bad()) return {};
-    // index the positions
-    while (std::getline(*file.stream, line)) {
-        if (line.empty()) continue;
-        auto item = parser.parse(line);
-        item.format = format;
-        batch.emplace_back(item);
-
-        if (batch.size() >= batch_size_) {
-            auto p = compress(*format, batch, item_index_, batches_.size());
-            if (p) batches_.emplace_back(std::move(p));
+    auto num_threads = util::get_num_threads(num_threads_);
+    if (num_threads > 1 && parser.thread_safe()) {
+        parse_parallel(*file.stream, parser, *format, num_threads);
+    } else {
+        std::vector<LogItem> batch;
+        batch.reserve(batch_size_);
+        std::string line;
+        while (std::getline(*file.stream, line)) {
+            if (line.empty()) continue;
+            auto item = parser.parse(line);
+            item.format = format;
+            batch.emplace_back(item);
+
+            if (batch.size() >= batch_size_) {
+                add_batch(compress(*format, batch));
+            }
         }
+        add_batch(compress(*format, batch));
+    }
+
+    uint64_t end_idx = batches_.size();
+    for (uint64_t i = start_idx; i < end_idx; i++) {
+        result.emplace(i);
     }
+    return result;
+}
+
+std::set<uint64_t> LogDatabase::parse(std::string_view data, LogFormatParser &parser) {
+    std::set<uint64_t> result;
+    formats_.emplace_back(parser.format);
+    auto *format = &formats_.back();
+    uint64_t start_idx = batches_.size();
 
-    auto p = compress(*format, batch, item_index_, batches_.size());
-    if (p) batches_.emplace_back(std::move(p));
+    auto num_threads = util::get_num_threads(num_threads_);
+    if (num_threads > 1 && parser.thread_safe()) {
+        parse_parallel(data, parser, *format, num_threads);
+    } else {
+        std::vector<LogItem> batch;
+        batch.reserve(batch_size_);
+        for_each_line(data, [&](std::string_view line) {
+            auto &item = batch.emplace_back(parser.parse_line(line));
+            item.format = format;
+            if (batch.size() >= batch_size_) {
+                add_batch(compress(*format, batch));
+            }
+        });
+        add_batch(compress(*format, batch));
+    }
 
     uint64_t end_idx = batches_.size();
-    for (uint64_t i = start_idx; i< end_idx; i++) {
+    for (uint64_t i = start_idx; i < end_idx; i++) {
         result.emplace(i);
     }
     return result;
 }
 
+void LogDatabase::parse_parallel(std::istream &stream, LogFormatParser &parser,
+                                 const LogFormatParser::Format &format, uint64_t num_threads) {
+    // the stream is cut into newline-aligned chunks on this thread
+    LogPipeline pipeline(num_threads, batch_size_, format,
+                         [this](auto batch) { add_batch(std::move(batch)); });
+    auto submit = [&](std::string chunk) {
+        auto owner = std::make_shared<const std::string>(std::move(chunk));
+        pipeline.submit(parser, *owner, owner);
+    };
+    std::string rest;
+    while (stream) {
+        auto chunk = std::move(rest);
+        auto old_size = chunk.size();
+        chunk.resize(old_size + chunk_size_);
+        stream.read(chunk.data() + old_size, static_cast<std::streamsize>(chunk_size_));
+        chunk.resize(old_size + stream.gcount());
+        auto last = chunk.rfind('\n');
+        if (last == std::string::npos || !stream) {
+            // either no complete line yet or the end of the stream
+            rest = std::move(chunk);
+            continue;
+        }
+        rest = chunk.substr(last + 1);
+        chunk.resize(last + 1);
+        submit(std::move(chunk));
+    }
+    if (!rest.empty()) submit(std::move(rest));
+    pipeline.finish();
+}
+
+void LogDatabase::parse_parallel(std::string_view data, LogFormatParser &parser,
+                                 const LogFormatParser::Format &format, uint64_t num_threads) {
+    LogPipeline pipeline(num_threads, batch_size_, format,
+                         [this](auto batch) { add_batch(std::move(batch)); });
+    uint64_t pos = 0;
+    while (pos < data.size()) {
+        auto end = data.find('\n', std::min<uint64_t>(pos + chunk_size_, data.size()));
+        end = end == std::string_view::npos ? data.size() : end + 1;
+        pipeline.submit(parser, data.substr(pos, end - pos));
+        pos = end;
+    }
+    pipeline.finish();
+}
+
+void LogDatabase::add_batch(std::unique_ptr<LogItemBatch> batch) {
+    if (!batch) return;
+    auto batch_index = batches_.size();
+    for (uint64_t i = 0; i < batch->size(); i++) {
+        item_index_.emplace_back(std::make_shared<LogIndex>(batch_index, i));
+    }
+    batches_.emplace_back(std::move(batch));
+}
+
 void LogDatabase::get_item(LogItem *item, const LogIndex &index) {
     if (cached_index_ && *cached_index_ == index.batch_index) {
         // use cached index
@@ -389,4 +698,222 @@ void LogDatabase::get_item(LogItem *item, const LogIndex &index) {
     }
 }
 
+std::vector<LogIndex> LogDatabase::select_range(uint64_t min_time, uint64_t max_time,
+                                                const std::set<uint64_t> *batches) const {
+    std::vector<LogIndex> result;
+    auto select = [&](uint64_t batch_index) {
+        auto const &batch = *batches_[batch_index];
+        auto const &range = batch.time_range();
+        if (!range.overlaps(min_time, max_time)) return;
+        uint64_t begin = 0, end = batch.size();
+        if (range.min < min_time || range.max > max_time) {
+            auto times = batch.get_times();
+            if (range.sorted) {
+                begin = std::lower_bound(times.begin(), times.end(), min_time) - times.begin();
+                end = std::upper_bound(times.begin(), times.end(), max_time) - times.begin();
+            } else {
+                for (uint64_t i = 0; i < times.size(); i++) {
+                    if (times[i] >= min_time && times[i] <= max_time) {
+                        result.emplace_back(batch_index, i);
+                    }
+                }
+                return;
+            }
+        }
+        for (auto i = begin; i < end; i++) result.emplace_back(batch_index, i);
+    };
+    if (batches) {
+        for (auto i : *batches) select(i);
+    } else {
+        for (uint64_t i = 0; i < batches_.size(); i++) select(i);
+    }
+    return result;
+}
+
+std::set<uint64_t> LogDatabase::get_batches(uint64_t parse_index) const {
+    std::set<uint64_t> result;
+    if (parse_index >= formats_.size()) return result;
+    auto const *format = &formats_[parse_index];
+    for (uint64_t i = 0; i < batches_.size(); i++) {
+        if (&batches_[i]->format() == format) result.emplace(i);
+    }
+    return result;
+}
+
+// log store layout. every section is 8-byte aligned:
+// header | format offsets | format entries | batch entries | strings | batch data
+constexpr std::array<char, 8> store_magic = {'O', 'O', 'Z', 'E', 'L', 'O', 'G', '\0'};
+constexpr uint64_t store_version = 3;
+
+struct StoreHeader {
+    std::array<char, 8> magic;
+    uint64_t version;
+    uint64_t key;
+    uint64_t num_formats;
+    uint64_t num_format_entries;
+    uint64_t num_batches;
+    uint64_t batch_size;
+    uint64_t strings_size;
+    uint64_t data_size;
+};
+
+struct StoreFormatEntry {
+    uint64_t name_offset;
+    uint64_t name_size;
+    uint64_t type;
+    uint64_t index;
+};
+
+struct StoreBatchEntry {
+    uint64_t size;
+    uint64_t format;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t min_time;
+    uint64_t max_time;
+    uint64_t sorted;
+};
+
+bool LogDatabase::save(const std::string &filename, uint64_t key) const {
+    std::vector<char> strings;
+    std::vector<uint64_t> format_offsets = {0};
+    std::vector<StoreFormatEntry> format_entries;
+    std::unordered_map<const LogFormatParser::Format *, uint64_t> format_indices;
+    for (auto const &format : formats_) {
+        format_indices.emplace(&format, format_indices.size());
+        for (auto const &[name, entry] : format) {
+            auto [type, index] = entry;
+            format_entries.emplace_back(StoreFormatEntry{strings.size(), name.size(),
+                                                         static_cast<uint64_t>(type), index});
+            strings.insert(strings.end(), name.begin(), name.end());
+        }
+        format_offsets.emplace_back(format_entries.size());
+    }
+
+    std::vector<StoreBatchEntry> batch_entries;
+    batch_entries.reserve(batches_.size());
+    uint64_t data_size = 0;
+    for (auto const &batch : batches_) {
+        auto data = batch->raw_data();
+        auto const &range = batch->time_range();
+        batch_entries.emplace_back(StoreBatchEntry{batch->size(),
+                                                   format_indices.at(&batch->format()),
+                                                   data_size, data.size(), range.min, range.max,
+                                                   range.sorted});
+        data_size += util::align(data.size());
+    }
+
+    StoreHeader header{};
+    header.magic = store_magic;
+    header.version = store_version;
+    header.key = key;
+    header.num_formats = formats_.size();
+    header.num_format_entries = format_entries.size();
+    header.num_batches = batches_.size();
+    header.batch_size = batch_size_;
+    header.strings_size = strings.size();
+    header.data_size = data_size;
+
+    util::SectionWriter writer(filename);
+    if (!writer.good()) return false;
+    writer.write(&header, 1);
+    writer.write(format_offsets.data(), format_offsets.size());
+    writer.write(format_entries.data(), format_entries.size());
+    writer.write(batch_entries.data(), batch_entries.size());
+    writer.write(strings.data(), strings.size());
+    for (auto const &batch : batches_) {
+        auto data = batch->raw_data();
+        writer.write(data.data(), data.size());
+    }
+    return writer.commit();
+}
+
+std::unique_ptr<LogDatabase> LogDatabase::load(const std::string &filename, uint64_t key) {
+    auto file = std::make_unique<util::MappedFile>(filename);
+    if (!file->is_open() || file->size() < sizeof(StoreHeader)) return nullptr;
+    auto const *base = file->data();
+    auto const &header = *reinterpret_cast<const StoreHeader *>(base);
+    if (header.magic != store_magic || header.version != store_version || header.key != key) {
+        return nullptr;
+    }
+
+    // num_formats is checked before the + 1
+    if (header.num_formats >= file->size() / sizeof(uint64_t) || header.batch_size == 0) {
+        return nullptr;
+    }
+    util::SectionReader reader(file->size(), sizeof(StoreHeader));
+    auto const format_offsets_offset = reader.next(header.num_formats + 1, sizeof(uint64_t));
+    auto const format_entries_offset =
+        reader.next(header.num_format_entries, sizeof(StoreFormatEntry));
+    auto const batches_offset = reader.next(header.num_batches, sizeof(StoreBatchEntry));
+    auto const strings_offset = reader.next(header.strings_size, 1);
+    auto const data_offset = reader.next(header.data_size, 1);
+    if (!reader.valid()) return nullptr;
+
+    auto const *format_offsets = reinterpret_cast<const uint64_t *>(base + format_offsets_offset);
+    auto const *format_entries =
+        reinterpret_cast<const StoreFormatEntry *>(base + format_entries_offset);
+    auto const *batch_entries = reinterpret_cast<const StoreBatchEntry *>(base + batches_offset);
+    auto const *strings = base + strings_offset;
+    auto const *data = base + data_offset;
+
+    auto db = std::make_unique<LogDatabase>(header.batch_size);
+    if (format_offsets[0] != 0) return nullptr;
+    for (uint64_t i = 0; i < header.num_formats; i++) {
+        auto begin = format_offsets[i], end = format_offsets[i + 1];
+        if (begin > end || end > header.num_format_entries) return nullptr;
+        auto &format = db->formats_.emplace_back();
+        for (auto j = begin; j < end; j++) {
+            auto const &entry = format_entries[j];
+            if (entry.name_offset > header.strings_size ||
+                entry.name_size > header.strings_size - entry.name_offset ||
+                entry.type > static_cast<uint64_t>(LogFormatParser::ValueType::Time)) {
+                return nullptr;
+            }
+            format.emplace(std::string(strings + entry.name_offset, entry.name_size),
+                           std::make_pair(static_cast<LogFormatParser::ValueType>(entry.type),
+                                          entry.index));
+        }
+    }
+    for (uint64_t i = 0; i < header.num_batches; i++) {
+        auto const &entry = batch_entries[i];
+        // the columns are checked when the batch is decoded
+        if (entry.size == 0 || entry.size > header.batch_size ||
+            entry.format >= header.num_formats ||
+            entry.data_offset > header.data_size ||
+            entry.data_size > header.data_size - entry.data_offset ||
+            entry.min_time > entry.max_time) {
+            return nullptr;
+        }
+        db->add_batch(std::make_unique<LogItemBatch>(
+            entry.size, std::string_view(data + entry.data_offset, entry.data_size),
+            db->formats_[entry.format],
+            LogTimeRange{entry.min_time, entry.max_time, entry.sorted != 0}));
+    }
+    db->mapped_file_ = std::move(file);
+    return db;
+}
+
+uint64_t LogDatabase::compute_key(const std::vector<std::string> &files,
+                                  const std::vector<const LogFormatParser *> &parsers) {
+    util::KeyHasher hasher;
+    for (auto const &filename : files) {
+        util::FileStamp stamp;
+        util::get_file_stamp(filename, stamp);
+        hasher.add(filename);
+        hasher.add(std::to_string(stamp.size));
+        hasher.add(std::to_string(stamp.mtime));
+    }
+    for (auto const *parser : parsers) {
+        hasher.add(parser->source());
+        hasher.add(std::to_string(parser->format.size()));
+        for (auto const &[name, entry] : parser->format) {
+            hasher.add(name);
+            hasher.add(std::to_string(static_cast<uint64_t>(entry.first)));
+            hasher.add(std::to_string(entry.second));
+        }
+    }
+    return hasher.value();
+}
+
 }  // namespace hgdb::log
@@ -1,14 +1,19 @@
 #ifndef HGDB_RTL_LOG_HH
 #define HGDB_RTL_LOG_HH
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
 #include <map>
 #include <memory>
-#include <regex>
+#include <optional>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "util.hh"
+
 namespace hgdb::log {
 
 class LogFile {
@@ -29,6 +34,14 @@ public:
     enum class ValueType { Int, Hex, Str, Float, Time };
     using Format = std::map<std::string, std::pair<ValueType, uint64_t>>;
     [[nodiscard]] virtual LogItem parse(const std::string &content) = 0;
+    // lines of memory mapped files are passed as views. parsers that can scan a view directly
+    // override this to avoid copying every line
+    [[nodiscard]] virtual LogItem parse_line(std::string_view line);
+    // parsers that can be called from several threads at once allow parallel ingestion
+    [[nodiscard]] virtual bool thread_safe() const { return false; }
+    // settings that change how lines are parsed, e.g. the printf format. it's part of the key of
+    // saved stores, see LogDatabase::compute_key()
+    [[nodiscard]] virtual std::string source() const { return {}; }
 
     LogFormatParser::Format format;
 };
@@ -51,20 +64,50 @@ public:
     const LogFormatParser::Format *format = nullptr;
 };
 
+// min/max time of a batch, used to skip batches without decompressing them
+struct LogTimeRange {
+    uint64_t min = 0;
+    uint64_t max = 0;
+    // times never decrease within the batch
+    bool sorted = true;
+
+    [[nodiscard]] bool overlaps(uint64_t min_time, uint64_t max_time) const {
+        return min <= max_time && max >= min_time;
+    }
+};
+
 // a batch of log items
 class LogItemBatch {
 public:
-    LogItemBatch(uint64_t size, std::vector<char> raw_data, const LogFormatParser::Format &format)
-        : size_(size), raw_data_(std::move(raw_data)), format_(format) {}
+    LogItemBatch(uint64_t size, std::vector<char> raw_data, const LogFormatParser::Format &format,
+                 const LogTimeRange &time_range)
+        : size_(size), raw_data_(std::move(raw_data)), data_(raw_data_.data(), raw_data_.size()),
+          format_(format), time_range_(time_range) {}
+    // compressed data owned by someone else, e.g. a mapped log store
+    LogItemBatch(uint64_t size, std::string_view data, const LogFormatParser::Format &format,
+                 const LogTimeRange &time_range)
+        : size_(size), data_(data), format_(format), time_range_(time_range) {}
+    // data_ may point into raw_data_
+    LogItemBatch(const LogItemBatch &) = delete;
+    LogItemBatch &operator=(const LogItemBatch &) = delete;
 
     void get_items(const std::vector<LogItem *> &items) const;
+    // only decodes the time column
+    [[nodiscard]] std::vector<uint64_t> get_times() const;
 
     [[nodiscard]] uint64_t size() const { return size_; }
+    [[nodiscard]] std::string_view raw_data() const { return data_; }
+    [[nodiscard]] const LogFormatParser::Format &format() const { return format_; }
+    [[nodiscard]] const LogTimeRange &time_range() const { return time_range_; }
 
 private:
     uint64_t size_;
     std::vector<char> raw_data_;
+    std::string_view data_;
     const LogFormatParser::Format &format_;
+    LogTimeRange time_range_;
+
+    [[nodiscard]] std::vector<char> decompress() const;
 };
 
 class LogPrintfParser : public LogFormatParser {
@@ -72,12 +115,29 @@ public:
     LogPrintfParser(const std::string &format, const std::vector<std::string> &attr_names);
 
     LogItem parse(const std::string &content) override;
+    LogItem parse_line(std::string_view line) override;
+    [[nodiscard]] bool thread_safe() const override { return true; }
+    [[nodiscard]] std::string source() const override { return source_; }
 
     [[nodiscard]] bool has_error() const { return error_; }
 
 private:
+    // the format is compiled into literals and fields. a line is scanned the same way a regular
+    // expression search would: the leftmost match wins and fields are greedy, backtracking when
+    // the rest of the format doesn't match
+    struct Token {
+        std::string literal;
+        // conversion character of a field, 0 for literals
+        char spec = 0;
+        uint64_t field = 0;
+    };
+
     void parse_format(const std::string &format);
-    std::regex re_;
+    bool match(std::string_view line, uint64_t token, uint64_t pos,
+               std::vector<std::string_view> &fields) const;
+    std::vector<Token> tokens_;
+    // format followed by the attribute names
+    std::string source_;
     bool error_ = false;
     uint64_t time_index_;
     std::vector<ValueType> types_;
@@ -98,9 +158,21 @@ public:
 
 class LogDatabase {
 public:
-    LogDatabase() = default;
-    explicit LogDatabase(uint64_t batch_size) : batch_size_(batch_size) {}
+    static constexpr uint64_t default_batch_size = 1024;
+    static constexpr uint64_t default_chunk_size = 1 << 20;
 
+    LogDatabase() = default;
+    // more than 1 thread parses the input in chunks of about chunk_size bytes and compresses
+    // batches concurrently, as long as the parser is thread safe. 0 means using all hardware
+    // threads. batches are committed in file order, so the item index doesn't depend on the
+    // number of threads
+    explicit LogDatabase(uint64_t batch_size, uint64_t num_threads = 1,
+                         uint64_t chunk_size = default_chunk_size)
+        : batch_size_(batch_size),
+          num_threads_(num_threads),
+          chunk_size_(std::max<uint64_t>(chunk_size, 1)) {}
+
+    // files are memory mapped and lines are handed to the parser without copies
     std::set<uint64_t> parse(const std::string &filename, LogFormatParser &parser);
     std::set<uint64_t> parse(std::istream &stream, LogFormatParser &parser);
     [[nodiscard]] const std::vector<std::shared_ptr<LogIndex>> &item_index() const {
@@ -109,8 +181,30 @@ public:
 
     void get_item(LogItem *item, const LogIndex &index);
 
+    // items with min_time <= time <= max_time in item index order, optionally limited to a set
+    // of batches. batches outside the time range are skipped without being decompressed and
+    // sorted batches are binary searched
+    std::vector<LogIndex> select_range(uint64_t min_time, uint64_t max_time,
+                                       const std::set<uint64_t> *batches = nullptr) const;
+
+    // batches produced by the n-th parse() call
+    [[nodiscard]] std::set<uint64_t> get_batches(uint64_t parse_index) const;
+
+    // writes the formats and compressed batches to a versioned binary file. the key identifies
+    // the inputs, see compute_key()
+    bool save(const std::string &filename, uint64_t key) const;
+    // maps a file written by save(). batches are decompressed the first time they are accessed.
+    // returns null if the file is invalid or has a different key
+    static std::unique_ptr<LogDatabase> load(const std::string &filename, uint64_t key);
+    // path and stamp of every log file, and the source and format of the parser used for each
+    // of them
+    static uint64_t compute_key(const std::vector<std::string> &files,
+                                const std::vector<const LogFormatParser *> &parsers);
+
 private:
-    uint64_t batch_size_ = 1024;
+    uint64_t batch_size_ = default_batch_size;
+    uint64_t num_threads_ = 1;
+    uint64_t chunk_size_ = default_chunk_size;
     std::vector<std::unique_ptr<LogItemBatch>> batches_;
     std::vector<std::shared_ptr<LogIndex>> item_index_;
 
@@ -119,8 +213,17 @@ private:
     std::vector<LogItem> cached_items_;
 
     std::set<uint64_t> parse(LogFile &file, LogFormatParser &parser);
-
-    std::vector<LogFormatParser::Format> formats_;
+    std::set<uint64_t> parse(std::string_view data, LogFormatParser &parser);
+    void parse_parallel(std::istream &stream, LogFormatParser &parser,
+                        const LogFormatParser::Format &format, uint64_t num_threads);
+    void parse_parallel(std::string_view data, LogFormatParser &parser,
+                        const LogFormatParser::Format &format, uint64_t num_threads);
+    void add_batch(std::unique_ptr<LogItemBatch> batch);
+
+    // batches hold references to their format
+    std::deque<LogFormatParser::Format> formats_;
+    // batches of a loaded store point into the mapped file
+    std::unique_ptr<util::MappedFile> mapped_file_;
 };
 
 }  // namespace hgdb::log
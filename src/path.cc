@@ -0,0 +1,176 @@
+#include "path.hh"
+
+#include <algorithm>
+
+namespace hgdb::rtl {
+
+uint64_t PathTable::add(std::string_view path, uint64_t parent) {
+    auto it = index_.find(path);
+    if (it != index_.end()) return it->second;
+    auto id = nodes_.size();
+    auto &node = nodes_.emplace_back(Node{arena_.add(path), parent});
+    index_.emplace(node.path, id);
+    if (parent == none) {
+        roots_.emplace_back(id);
+    } else {
+        auto &p = nodes_[parent];
+        if (p.last_child == none) {
+            p.first_child = id;
+        } else {
+            nodes_[p.last_child].next_sibling = id;
+        }
+        p.last_child = id;
+    }
+    return id;
+}
+
+void PathTable::finalize() {
+    uint64_t pre = 0, post = 0;
+    // iterative DFS, hierarchies can be deep
+    std::vector<std::pair<uint64_t, bool>> stack;
+    for (auto root : roots_) {
+        stack.emplace_back(root, false);
+        while (!stack.empty()) {
+            auto [id, visited] = stack.back();
+            stack.pop_back();
+            auto &node = nodes_[id];
+            if (visited) {
+                node.post = post++;
+                continue;
+            }
+            node.pre = pre++;
+            stack.emplace_back(id, true);
+            // children are pushed in reverse so that they are numbered in insertion order
+            auto first = stack.size();
+            for (auto child = node.first_child; child != none; child = nodes_[child].next_sibling) {
+                stack.emplace_back(child, false);
+            }
+            std::reverse(stack.begin() + static_cast<int64_t>(first), stack.end());
+        }
+    }
+}
+
+std::optional<uint64_t> PathTable::find(std::string_view path) const {
+    auto it = index_.find(path);
+    if (it == index_.end()) return std::nullopt;
+    return it->second;
+}
+
+// glob within a single level, without '.'
+bool match_level(std::string_view pattern, std::string_view name) {
+    uint64_t p = 0, n = 0;
+    // position to backtrack to after the last '*'
+    auto star = std::string_view::npos;
+    uint64_t star_n = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            p++;
+            n++;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_n = n;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            n = ++star_n;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+template <typename F>
+void for_each_level(std::string_view path, F &&func) {
+    while (true) {
+        auto pos = path.find('.');
+        func(path.substr(0, pos));
+        if (pos == std::string_view::npos) return;
+        path = path.substr(pos + 1);
+    }
+}
+
+PathPattern::PathPattern(std::string_view pattern, bool regex) : regex_(regex) {
+    if (!regex) {
+        for_each_level(pattern, [this](std::string_view level) { levels_.emplace_back(level); });
+        return;
+    }
+    re_ = std::regex(pattern.begin(), pattern.end());
+    // any alternation can change the prefix
+    if (pattern.find('|') != std::string_view::npos) return;
+    for (uint64_t i = 0; i < pattern.size(); i++) {
+        auto c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size() && pattern[i + 1] == '.') {
+            literal_prefix_ += '.';
+            i++;
+            continue;
+        }
+        if (std::string_view(".[](){}*+?^$\\").find(c) != std::string_view::npos) {
+            // the last character is optional under these quantifiers
+            if ((c == '*' || c == '?' || c == '{') && !literal_prefix_.empty()) {
+                literal_prefix_.pop_back();
+            }
+            break;
+        }
+        literal_prefix_ += c;
+    }
+}
+
+void PathPattern::close(std::vector<uint64_t> &positions) const {
+    // "**" can match zero levels
+    for (uint64_t i = 0; i < positions.size(); i++) {
+        auto pos = positions[i];
+        if (pos < levels_.size() && levels_[pos] == "**" &&
+            std::find(positions.begin(), positions.end(), pos + 1) == positions.end()) {
+            positions.emplace_back(pos + 1);
+        }
+    }
+}
+
+PathPattern::State PathPattern::initial() const {
+    State state{{0}};
+    if (!regex_) close(state.positions);
+    return state;
+}
+
+PathPattern::State PathPattern::advance(const State &state, std::string_view path,
+                                        uint64_t begin) const {
+    State result;
+    if (regex_) {
+        auto size = std::min<uint64_t>(path.size(), literal_prefix_.size());
+        if (path.substr(0, size) == std::string_view(literal_prefix_).substr(0, size)) {
+            result.positions.emplace_back(0);
+        }
+        return result;
+    }
+    result.positions = state.positions;
+    for_each_level(path.substr(begin), [this, &result](std::string_view level) {
+        std::vector<uint64_t> next;
+        for (auto pos : result.positions) {
+            if (pos >= levels_.size()) continue;
+            if (levels_[pos] == "**") {
+                next.emplace_back(pos);
+            } else if (match_level(levels_[pos], level)) {
+                next.emplace_back(pos + 1);
+            }
+        }
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+        close(next);
+        result.positions = std::move(next);
+    });
+    return result;
+}
+
+bool PathPattern::accepts(const State &state, std::string_view path) const {
+    if (dead(state)) return false;
+    if (regex_) return std::regex_match(path.begin(), path.end(), re_);
+    return std::find(state.positions.begin(), state.positions.end(), levels_.size()) !=
+           state.positions.end();
+}
+
+bool PathPattern::match(std::string_view path) const {
+    return accepts(advance(initial(), path, 0), path);
+}
+
+}  // namespace hgdb::rtl
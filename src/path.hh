@@ -0,0 +1,93 @@
+#ifndef HGDB_RTL_PATH_HH
+#define HGDB_RTL_PATH_HH
+
+#include <limits>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "util.hh"
+
+namespace hgdb::rtl {
+
+// hierarchical paths interned as a prefix tree. a node's parent is its closest indexed prefix,
+// e.g. the instance a variable is declared in. every path is stored once in an arena. nodes are
+// numbered in pre- and post-order when the table is finalized, which turns containment into an
+// interval check
+class PathTable {
+public:
+    static constexpr uint64_t none = std::numeric_limits<uint64_t>::max();
+
+    // parents have to be added before their children. adding an existing path returns its node
+    uint64_t add(std::string_view path, uint64_t parent = none);
+    // computes the pre/post-order numbering. has to be called after the last add()
+    void finalize();
+
+    [[nodiscard]] std::optional<uint64_t> find(std::string_view path) const;
+    [[nodiscard]] std::string_view path(uint64_t id) const { return nodes_[id].path; }
+    [[nodiscard]] uint64_t parent(uint64_t id) const { return nodes_[id].parent; }
+    // whether child is strictly below parent
+    [[nodiscard]] bool inside(uint64_t child, uint64_t parent) const {
+        return nodes_[parent].pre < nodes_[child].pre && nodes_[child].post < nodes_[parent].post;
+    }
+    [[nodiscard]] uint64_t size() const { return nodes_.size(); }
+
+    // children are visited in insertion order, ended by none
+    [[nodiscard]] uint64_t first_child(uint64_t id) const { return nodes_[id].first_child; }
+    [[nodiscard]] uint64_t next_sibling(uint64_t id) const { return nodes_[id].next_sibling; }
+    [[nodiscard]] const std::vector<uint64_t> &roots() const { return roots_; }
+
+private:
+    struct Node {
+        std::string_view path;
+        uint64_t parent;
+        uint64_t first_child = none;
+        uint64_t last_child = none;
+        uint64_t next_sibling = none;
+        uint64_t pre = 0;
+        uint64_t post = 0;
+    };
+
+    util::StringArena arena_;
+    std::vector<Node> nodes_;
+    std::vector<uint64_t> roots_;
+    std::unordered_map<std::string_view, uint64_t> index_;
+};
+
+// hierarchical path pattern. globs are matched level by level: '*' and '?' stay within a level
+// and a "**" level matches any number of levels, e.g. top.core*.alu.* or top.**.a. regular
+// expressions are matched against the whole path. patterns are evaluated incrementally while
+// walking down the hierarchy, so that subtrees that can't match are skipped
+class PathPattern {
+public:
+    PathPattern(std::string_view pattern, bool regex);
+
+    // glob: pattern levels that can match next. regex: whether the literal prefix still matches
+    struct State {
+        std::vector<uint64_t> positions;
+    };
+
+    [[nodiscard]] State initial() const;
+    // consumes the levels path[begin:] of a path whose parent has already been consumed
+    [[nodiscard]] State advance(const State &state, std::string_view path, uint64_t begin) const;
+    [[nodiscard]] static bool dead(const State &state) { return state.positions.empty(); }
+    [[nodiscard]] bool accepts(const State &state, std::string_view path) const;
+
+    [[nodiscard]] bool match(std::string_view path) const;
+
+private:
+    bool regex_;
+    std::vector<std::string> levels_;
+    std::regex re_;
+    // regex only. paths that don't share it can be pruned
+    std::string literal_prefix_;
+
+    void close(std::vector<uint64_t> &positions) const;
+};
+
+}  // namespace hgdb::rtl
+
+#endif  // HGDB_RTL_PATH_HH
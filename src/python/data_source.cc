@@ -1,5 +1,8 @@
 #include "data_source.hh"
 
+#include "../path.hh"
+#include "query.hh"
+
 void Ooze::add_source(const std::shared_ptr<DataSource> &source) {
     // need to register provider type
     sources.emplace_back(source);
@@ -52,13 +55,48 @@ std::shared_ptr<QueryObject> ooze_bind(const Ooze &ooze, const std::shared_ptr<Q
     return bind(src, obj, type);
 }
 
-std::shared_ptr<QueryObject> ooze_select(Ooze *ooze, const py::args &types) {
+std::shared_ptr<QueryArray> select_path(const Ooze::SelectorProvider &provider, py::handle type,
+                                       const std::string &pattern, bool regex) {
+    auto selector = provider.src->get_path_selector(type, pattern, regex);
+    if (selector) return selector;
+    // filter natively on the path attribute
+    selector = provider.func(type);
+    if (!selector) return nullptr;
+    hgdb::rtl::PathPattern path_pattern(pattern, regex);
+    auto result = std::make_shared<QueryArray>(selector->ooze);
+    for (uint64_t i = 0; i < selector->size(); i++) {
+        auto entry = selector->get(i);
+        NativeValue value;
+        if (!entry->get_attr("path", value)) continue;
+        auto const *path = std::get_if<std::string>(&value);
+        if (path && path_pattern.match(*path)) result->add(entry);
+    }
+    return result;
+}
+
+std::shared_ptr<QueryObject> ooze_select(Ooze *ooze, const py::args &types,
+                                         const py::kwargs &kwargs) {
+    // path="top.core*.alu.*" selects by glob, path=like(r"...") by regex
+    std::optional<std::pair<std::string, bool>> path;
+    for (auto const &[key, value] : kwargs) {
+        auto name = key.cast<std::string>();
+        if (name != "path") throw std::runtime_error("Unknown select argument " + name);
+        if (py::isinstance<py::str>(value)) {
+            path = {value.cast<std::string>(), false};
+        } else if (py::isinstance<RegexString>(value)) {
+            path = {value.cast<std::shared_ptr<RegexString>>()->pattern(), true};
+        } else {
+            throw std::runtime_error("path has to be a glob string or like()");
+        }
+    }
+
     auto query_array = std::make_shared<QueryArray>(ooze);
     // need to find registered types
     for (auto const &t : types) {
         for (auto const &provider : ooze->selector_providers) {
             if (provider.handle.is(t)) {
-                auto selector = provider.func(t);
+                auto selector =
+                    path ? select_path(provider, t, path->first, path->second) : provider.func(t);
                 if (selector) {
                     // need to add it to the selector
                     query_array->add(selector);
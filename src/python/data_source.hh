@@ -36,6 +36,17 @@ public:
 
     [[nodiscard]] virtual std::vector<py::handle> provides() const = 0;
     [[nodiscard]] virtual std::shared_ptr<QueryArray> get_selector(py::handle handle) = 0;
+    // objects whose path matches a glob or regex pattern, see hgdb::rtl::PathPattern. returns
+    // nullptr if the data source can't select by path, in which case the full selector is
+    // filtered instead
+    [[nodiscard]] virtual std::shared_ptr<QueryArray> get_path_selector(py::handle handle,
+                                                                        std::string_view pattern,
+                                                                        bool regex) {
+        (void)handle;
+        (void)pattern;
+        (void)regex;
+        return nullptr;
+    }
 
     virtual void on_added(Ooze *) {}
 
@@ -46,6 +57,27 @@ public:
     [[nodiscard]] virtual std::unique_ptr<FilterMapperGenerator> filter_generator() const {
         return nullptr;
     }
+
+    // only visits the edges of the clock instead of every timestamp
+    [[nodiscard]] virtual std::unique_ptr<FilterMapperGenerator> filter_generator(
+        const py::object &clock, bool posedge) const {
+        (void)clock;
+        (void)posedge;
+        return nullptr;
+    }
+
+    // evaluates the predicate without calling into Python. returns nullptr if the data source
+    // doesn't understand the predicate
+    [[nodiscard]] virtual std::shared_ptr<QueryArray> when(const std::shared_ptr<QueryObject> &obj,
+                                                           const py::object &predicate,
+                                                           const py::object &clock,
+                                                           bool posedge) const {
+        (void)obj;
+        (void)predicate;
+        (void)clock;
+        (void)posedge;
+        return nullptr;
+    }
 };
 
 class Ooze {
@@ -1,8 +1,12 @@
 #include "log.hh"
 
+#include <iostream>
+
 #include "fmt/format.h"
 
-std::map<hgdb::log::LogIndex, hgdb::log::LogItem> LogItem::cached_items_;
+std::unordered_map<const hgdb::log::LogDatabase *,
+                   std::map<hgdb::log::LogIndex, hgdb::log::LogItem>>
+    LogItem::cached_items_;
 
 std::map<std::string, pybind11::object> LogItem::values() const {
     hgdb::log::LogItem item = get_item();
@@ -34,23 +38,62 @@ std::map<std::string, pybind11::object> LogItem::values() const {
     return result;
 }
 
+bool LogItem::get_attr(const std::string &name, NativeValue &value) const {
+    auto item = get_item();
+    if (name == "time") {
+        value = static_cast<int64_t>(item.time);
+        return true;
+    }
+    auto const &format = *item.format;
+    auto it = format.find(name);
+    if (it == format.end()) {
+        value = std::monostate{};
+        return true;
+    }
+    auto [type, index] = it->second;
+    switch (type) {
+        case hgdb::log::LogFormatParser::ValueType::Hex:
+        case hgdb::log::LogFormatParser::ValueType::Int:
+        case hgdb::log::LogFormatParser::ValueType::Time: {
+            value = item.int_values[index];
+            break;
+        }
+        case hgdb::log::LogFormatParser::ValueType::Float: {
+            value = item.float_values[index];
+            break;
+        }
+        case hgdb::log::LogFormatParser::ValueType::Str: {
+            value = std::move(item.str_values[index]);
+            break;
+        }
+    }
+    return true;
+}
+
 hgdb::log::LogItem LogItem::get_item() const {
-    if (cached_items_.find(index) != cached_items_.end()) {
-        return cached_items_.at(index);
+    auto &cached_items = cached_items_[db];
+    if (cached_items.find(index) != cached_items.end()) {
+        return cached_items.at(index);
     } else {
         // need to get the item
         hgdb::log::LogItem item;
         db->get_item(&item, index);
-        if (cached_items_.size() >= cache_size_) {
+        if (cached_items.size() >= cache_size_) {
             // just erase the first one
-            cached_items_.erase(cached_items_.begin());
+            cached_items.erase(cached_items.begin());
         }
-        cached_items_.emplace(index, item);
+        cached_items.emplace(index, item);
         return item;
     }
 }
 
-Log::Log() : DataSource(DataSourceType::Log) { db_ = std::make_unique<hgdb::log::LogDatabase>(); }
+Log::Log(uint64_t num_threads, std::string store)
+    : DataSource(DataSourceType::Log), store_(std::move(store)) {
+    db_ = std::make_unique<hgdb::log::LogDatabase>(hgdb::log::LogDatabase::default_batch_size,
+                                                    num_threads);
+}
+
+Log::~Log() { LogItem::clear_cache(db_.get()); }
 
 void Log::add_file(const std::string &filename,
                    const std::shared_ptr<hgdb::log::LogFormatParser> &parser) {
@@ -60,10 +103,60 @@ void Log::add_file(const std::string &filename,
 
 void Log::on_added(Ooze *ooze) {
     ooze_ = ooze;
+    // parsers without a source, e.g. the ones written in Python, can change without the key
+    // noticing, so their logs are always parsed
+    auto use_store = !store_.empty();
+    for (auto const &[filename, parser] : files_) {
+        if (parser->source().empty()) use_store = false;
+    }
+    uint64_t key = 0;
+    if (use_store) {
+        std::vector<std::string> filenames;
+        std::vector<const hgdb::log::LogFormatParser *> parsers;
+        for (auto const &[filename, parser] : files_) {
+            filenames.emplace_back(filename);
+            parsers.emplace_back(parser.get());
+        }
+        key = hgdb::log::LogDatabase::compute_key(filenames, parsers);
+        if (auto db = hgdb::log::LogDatabase::load(store_, key)) {
+            LogItem::clear_cache(db_.get());
+            db_ = std::move(db);
+            loaded_from_store_ = true;
+            for (uint64_t i = 0; i < files_.size(); i++) {
+                parser_batches_.emplace_back(db_->get_batches(i));
+            }
+            return;
+        }
+    }
     for (auto const &[filename, parser] : files_) {
         auto parser_index = db_->parse(filename, *parser);
         parser_batches_.emplace_back(parser_index);
     }
+    // failing to write the store is not an error, we just parse the logs again next time
+    if (use_store && !db_->save(store_, key)) {
+        std::cerr << "Unable to write log store to " << store_ << std::endl;
+    }
+}
+
+std::shared_ptr<QueryArray> Log::select_range(uint64_t min_time, uint64_t max_time,
+                                              const py::object &type) {
+    if (!ooze_) throw std::runtime_error("Log is not added to Ooze");
+    // a parser can be used for several files, the batches of all of them are selected
+    std::optional<std::set<uint64_t>> batches;
+    if (!type.is_none() && !type.is(py::type::of<LogItem>())) {
+        for (auto i = 0u; i < parsers_.size(); i++) {
+            if (!type.is(py::cast(parsers_[i]))) continue;
+            if (!batches) batches.emplace();
+            batches->insert(parser_batches_[i].begin(), parser_batches_[i].end());
+        }
+        if (!batches) throw py::value_error("Unknown log item type");
+    }
+    auto array = std::make_shared<QueryArray>(ooze_);
+    for (auto const &index :
+         db_->select_range(min_time, max_time, batches ? &*batches : nullptr)) {
+        array->add(std::make_shared<LogItem>(ooze_, db_.get(), index));
+    }
+    return array;
 }
 
 std::shared_ptr<QueryArray> Log::get_selector(py::handle handle) {
@@ -195,8 +288,11 @@ void init_log_item(py::module &m) {
 
 void init_log_data_source(py::module &m) {
     auto log = py::class_<Log, DataSource, std::shared_ptr<Log>>(m, "Log");
-    log.def(py::init<>());
+    log.def(py::init<uint64_t, std::string>(), py::arg("num_threads") = 1, py::arg("store") = "");
     log.def("add_file", &Log::add_file, py::arg("filename"), py::arg("parser"));
+    log.def_property_readonly("loaded_from_store", &Log::loaded_from_store);
+    log.def("select_range", &Log::select_range, py::arg("min_time"), py::arg("max_time"),
+            py::arg("type") = py::none());
 }
 
 class PyLogParser : public hgdb::log::LogFormatParser {
@@ -1,6 +1,8 @@
 #ifndef HGDB_RTL_PYTHON_LOG_HH
 #define HGDB_RTL_PYTHON_LOG_HH
 
+#include <unordered_map>
+
 #include "../log.hh"
 #include "data_source.hh"
 
@@ -11,19 +13,28 @@ public:
     hgdb::log::LogDatabase *db;
     hgdb::log::LogIndex index;
     std::map<std::string, pybind11::object> values() const override;
+    bool get_attr(const std::string &name, NativeValue &value) const override;
 
     hgdb::log::LogItem get_item() const;
 
     static void clear_cache() { cached_items_.clear(); }
+    static void clear_cache(const hgdb::log::LogDatabase *db) { cached_items_.erase(db); }
 
 private:
-    static std::map<hgdb::log::LogIndex, hgdb::log::LogItem> cached_items_;
+    // indices are only unique within a database, and the items point to its formats
+    static std::unordered_map<const hgdb::log::LogDatabase *,
+                              std::map<hgdb::log::LogIndex, hgdb::log::LogItem>>
+        cached_items_;
     auto static constexpr cache_size_ = 1 << 20;
 };
 
 class Log : public DataSource {
 public:
-    Log();
+    // see LogDatabase for parallel parsing. a non-empty store is a file that keeps the parsed
+    // logs. it is reused as long as the log files and parser formats are unchanged. the store is
+    // not used if any parser is written in Python, since changes to its parse() can't be seen
+    explicit Log(uint64_t num_threads = 1, std::string store = "");
+    ~Log();
     [[nodiscard]] std::vector<py::handle> provides() const override;
 
     std::shared_ptr<QueryArray> get_selector(py::handle handle) override;
@@ -37,8 +48,16 @@ public:
 
     void on_added(Ooze *ooze) override;
 
+    [[nodiscard]] bool loaded_from_store() const { return loaded_from_store_; }
+
+    // items with min_time <= time <= max_time, optionally limited to the items of a parser
+    std::shared_ptr<QueryArray> select_range(uint64_t min_time, uint64_t max_time,
+                                             const py::object &type);
+
 private:
     Ooze *ooze_ = nullptr;
+    std::string store_;
+    bool loaded_from_store_ = false;
     std::vector<std::pair<std::string, std::shared_ptr<hgdb::log::LogFormatParser>>> files_;
     std::unique_ptr<hgdb::log::LogDatabase> db_;
     std::vector<std::shared_ptr<hgdb::log::LogFormatParser>> parsers_;
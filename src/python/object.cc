@@ -66,8 +66,21 @@ std::shared_ptr<QueryObject> filter_query_object(
     return flatten_size_one_array(r);
 }
 
+std::shared_ptr<QueryObject> filter_query_object_predicate(
+    const std::shared_ptr<QueryObject> &obj, const std::shared_ptr<AttrPredicate> &predicate) {
+    auto filter = Filter([&predicate](const std::shared_ptr<QueryObject> &target) {
+        return predicate->eval(target);
+    });
+    auto r = filter.apply(obj);
+    return flatten_size_one_array(r);
+}
+
 std::shared_ptr<QueryObject> filter_query_object_kwargs(const std::shared_ptr<QueryObject> &obj,
                                                         const py::kwargs &kwargs) {
+    // simple values are compared natively
+    if (auto predicate = AttrPredicate::from_kwargs(kwargs)) {
+        return filter_query_object_predicate(obj, predicate);
+    }
     // need to construct the function
     auto func = [&](const std::shared_ptr<QueryObject> &target) -> bool {
         auto py_obj = py::cast(target);
@@ -141,6 +154,21 @@ std::shared_ptr<QueryObject> map_object(
     }
 }
 
+std::shared_ptr<QueryObject> map_object(const std::shared_ptr<QueryObject> &obj,
+                                        const std::shared_ptr<ArrayMapper> &mapper) {
+    std::vector<std::shared_ptr<QueryObject>> objs;
+    if (obj->is_array()) {
+        auto const &array = std::reinterpret_pointer_cast<QueryArray>(obj);
+        for (uint64_t i = 0; i < array->size(); i++) objs.emplace_back(array->get(i));
+    } else {
+        objs.emplace_back(obj);
+    }
+    auto prepared = mapper->prepare(objs);
+    // same as mapping with a function
+    return obj->map(
+        [&mapper](QueryObject *entry) { return mapper->map(entry->shared_from_this()); });
+}
+
 GenericQueryObject::GenericQueryObject(const std::shared_ptr<QueryObject> &obj)
     : QueryObject(obj->ooze) {
     if (obj->is_array()) throw std::runtime_error("Cannot convert an array to generic object");
@@ -153,6 +181,15 @@ GenericQueryObject::GenericQueryObject(const std::shared_ptr<QueryObject> &obj)
 GenericQueryObject::GenericQueryObject(Ooze *ooze, std::map<std::string, pybind11::object> attrs)
     : QueryObject(ooze), attrs(std::move(attrs)) {}
 
+bool GenericQueryObject::get_attr(const std::string &name, NativeValue &value) const {
+    auto it = attrs.find(name);
+    if (it == attrs.end()) {
+        value = std::monostate{};
+        return true;
+    }
+    return to_native_value(it->second, value);
+}
+
 void compute_hash_keys(const std::vector<std::string> &join_keys,
                        const std::shared_ptr<QueryArray> &array,
                        std::map<uint64_t, std::vector<std::shared_ptr<QueryObject>>> &hash_map) {
@@ -275,12 +312,21 @@ std::shared_ptr<QueryObject> query_object_select(const std::shared_ptr<QueryObje
     }
 }
 
-std::shared_ptr<QueryObject> object_when(
-    const std::shared_ptr<QueryObject> &obj,
-    const std::function<bool(const std::shared_ptr<QueryObject> &)> &func) {
-    // find out the provider of that type
+std::shared_ptr<QueryObject> object_when(const std::shared_ptr<QueryObject> &obj,
+                                         const py::object &predicate, const py::object &clock,
+                                         const std::string &edge) {
+    if (edge != "posedge" && edge != "negedge") {
+        throw py::value_error("edge has to be either posedge or negedge");
+    }
+    auto posedge = edge == "posedge";
+    // find out the provider of that type. arrays are provided by whoever provides the elements
     Ooze *ooze = obj->ooze;
-    auto const &py_obj = py::cast(obj);
+    auto type_obj = obj;
+    if (obj->is_array()) {
+        auto array = std::reinterpret_pointer_cast<QueryArray>(obj);
+        if (!array->empty()) type_obj = array->get(0);
+    }
+    auto const &py_obj = py::cast(type_obj);
     auto result = std::make_shared<QueryArray>(obj->ooze);
     DataSource *data_source = nullptr;
     for (auto const &provider : ooze->selector_providers) {
@@ -290,14 +336,23 @@ std::shared_ptr<QueryObject> object_when(
         }
     }
     if (!data_source) return nullptr;
-    auto generator = data_source->filter_generator();
+    // simple predicates are evaluated natively
+    if (auto native = data_source->when(obj, predicate, clock, posedge)) {
+        return flatten_size_one_array(native);
+    }
+    if (!PyCallable_Check(predicate.ptr())) {
+        throw py::type_error("predicate has to be callable");
+    }
+
+    auto generator = clock.is_none() ? data_source->filter_generator()
+                                     : data_source->filter_generator(clock, posedge);
     if (!generator) return nullptr;
     while (true) {
         auto f = generator->next();
         if (!f) break;
         auto mapper = *f;
         auto o = obj->map(mapper);
-        auto b = func(o);
+        auto b = py::bool_(predicate(o));
         if (b) {
             result->add(o);
         }
@@ -343,7 +398,13 @@ std::shared_ptr<QueryArray> query_seq(
 }
 
 void init_query_object(py::module &m) {
+    py::class_<ArrayMapper, std::shared_ptr<ArrayMapper>>(m, "ArrayMapper")
+        .def("__call__", &ArrayMapper::map);
+
     auto obj = py::class_<QueryObject, std::shared_ptr<QueryObject>>(m, "QueryObject");
+    // array mappers are callable, so they have to be matched before the generic mappers
+    obj.def("map", py::overload_cast<const std::shared_ptr<QueryObject> &,
+                                     const std::shared_ptr<ArrayMapper> &>(&map_object));
     obj.def("map", &QueryObject::map);
     obj.def("__repr__", [](const QueryObject &obj) {
         // if str() is not implemented, we create values from the dict
@@ -360,6 +421,7 @@ void init_query_object(py::module &m) {
     });
 
     // the filter part
+    obj.def("filter", &filter_query_object_predicate, py::arg("predicate"));
     obj.def(
         "filter",
         [](const std::shared_ptr<QueryObject> &obj,
@@ -369,6 +431,7 @@ void init_query_object(py::module &m) {
         py::arg("predicate"));
     obj.def("filter", &filter_query_object_kwargs);
     // notice that where is the same as filter
+    obj.def("where", &filter_query_object_predicate, py::arg("predicate"));
     obj.def(
         "where",
         [](const std::shared_ptr<QueryObject> &obj,
@@ -403,7 +466,8 @@ void init_query_object(py::module &m) {
         py::arg("other"));
 
     // when, which needs help from the data source providers
-    obj.def("when", &object_when, py::arg("predicate"));
+    obj.def("when", &object_when, py::arg("predicate"), py::arg("clock") = py::none(),
+            py::arg("edge") = "posedge");
 }
 
 void init_query_array(py::module &m) {
@@ -1,11 +1,17 @@
 #ifndef HGDB_RTL_OBJECT_HH
 #define HGDB_RTL_OBJECT_HH
 
+#include <variant>
+
 #include "../../src/rtl.hh"
 #include "pybind11/pybind11.h"
 
 class Ooze;
 
+// attribute values that filters can compare without going through Python. monostate means the
+// object doesn't have the attribute
+using NativeValue = std::variant<std::monostate, int64_t, double, std::string>;
+
 struct QueryObject : public std::enable_shared_from_this<QueryObject> {
 public:
     explicit QueryObject(Ooze *ooze) : ooze(ooze) {}
@@ -16,6 +22,8 @@ public:
     [[nodiscard]] virtual std::map<std::string, pybind11::object> values() const { return {}; }
     [[nodiscard]] virtual bool is_array() const { return false; }
     [[nodiscard]] virtual std::string str() const { return ""; }
+    // returns false if the attribute has to be looked up through Python
+    virtual bool get_attr(const std::string &, NativeValue &) const { return false; }
     Ooze *ooze;
 };
 
@@ -51,6 +59,21 @@ public:
     explicit GenericQueryObject(Ooze *ooze, std::map<std::string, pybind11::object> attrs);
 
     std::map<std::string, pybind11::object> attrs;
+
+    bool get_attr(const std::string &name, NativeValue &value) const override;
+};
+
+// mappers that see every object before any of them is mapped, e.g. to load the data of all of
+// them at once
+class ArrayMapper {
+public:
+    virtual ~ArrayMapper() = default;
+    // called once with the objects of the array. the result is held until all of them are mapped
+    virtual std::shared_ptr<void> prepare(const std::vector<std::shared_ptr<QueryObject>> &objs) {
+        (void)objs;
+        return nullptr;
+    }
+    virtual std::shared_ptr<QueryObject> map(const std::shared_ptr<QueryObject> &obj) = 0;
 };
 
 class GenericAttributeError : public std::runtime_error {
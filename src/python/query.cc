@@ -4,8 +4,6 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
-#include <regex>
-
 namespace py = pybind11;
 
 std::shared_ptr<QueryObject> Filter::apply(const std::shared_ptr<QueryObject> &data) {
@@ -33,17 +31,179 @@ std::shared_ptr<QueryObject> Filter::apply(const std::shared_ptr<QueryObject> &d
     return result;
 }
 
-class RegexString {
-public:
-    explicit RegexString(const std::string &regex) { re_ = std::regex(regex); }
+bool to_native_value(const py::handle &obj, NativeValue &value) {
+    if (py::isinstance<py::int_>(obj)) {
+        int overflow = 0;
+        auto v = PyLong_AsLongLongAndOverflow(obj.ptr(), &overflow);
+        if (overflow) return false;
+        value = static_cast<int64_t>(v);
+    } else if (py::isinstance<py::float_>(obj)) {
+        value = obj.cast<double>();
+    } else if (py::isinstance<py::str>(obj)) {
+        value = obj.cast<std::string>();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<AttrPredicate> AttrPredicate::compare(const std::string &attr, Op op,
+                                                      const py::object &value) {
+    auto result = std::make_shared<AttrPredicate>();
+    if (!to_native_value(value, result->value_)) return nullptr;
+    result->op_ = op;
+    result->attr_ = attr;
+    result->py_value_ = value;
+    return result;
+}
+
+std::shared_ptr<AttrPredicate> AttrPredicate::like(const std::string &attr,
+                                                   std::shared_ptr<RegexString> re) {
+    auto result = std::make_shared<AttrPredicate>();
+    result->op_ = Op::Like;
+    result->attr_ = attr;
+    result->re_ = std::move(re);
+    return result;
+}
+
+std::shared_ptr<AttrPredicate> AttrPredicate::combine(
+    Op op, std::vector<std::shared_ptr<AttrPredicate>> args) {
+    auto result = std::make_shared<AttrPredicate>();
+    result->op_ = op;
+    result->args_ = std::move(args);
+    return result;
+}
+
+std::shared_ptr<AttrPredicate> AttrPredicate::from_kwargs(const py::kwargs &kwargs) {
+    std::vector<std::shared_ptr<AttrPredicate>> args;
+    for (auto const &[name, value] : kwargs) {  // NOLINT
+        auto attr = name.cast<std::string>();
+        std::shared_ptr<AttrPredicate> arg;
+        if (py::isinstance<RegexString>(value)) {
+            arg = like(attr, value.cast<std::shared_ptr<RegexString>>());
+        } else {
+            arg = compare(attr, Op::Eq, py::reinterpret_borrow<py::object>(value));
+        }
+        if (!arg) return nullptr;
+        args.emplace_back(arg);
+    }
+    if (args.size() == 1) return args[0];
+    return combine(Op::And, std::move(args));
+}
+
+bool AttrPredicate::eval(const std::shared_ptr<QueryObject> &obj) const {
+    auto r = eval_native(*obj);
+    if (r) return *r;
+    return eval_python(py::cast(obj));
+}
+
+std::optional<bool> AttrPredicate::eval_native(const QueryObject &obj) const {
+    switch (op_) {
+        case Op::And:
+        case Op::Or: {
+            auto is_and = op_ == Op::And;
+            for (auto const &arg : args_) {
+                auto r = arg->eval_native(obj);
+                if (!r) return std::nullopt;
+                if (*r != is_and) return !is_and;
+            }
+            return is_and;
+        }
+        case Op::Not: {
+            auto r = args_[0]->eval_native(obj);
+            if (!r) return std::nullopt;
+            return !*r;
+        }
+        default: {
+            NativeValue value;
+            if (!obj.get_attr(attr_, value)) return std::nullopt;
+            return check(value);
+        }
+    }
+}
+
+bool AttrPredicate::eval_python(const py::object &obj) const {
+    switch (op_) {
+        case Op::And:
+        case Op::Or: {
+            auto is_and = op_ == Op::And;
+            for (auto const &arg : args_) {
+                if (arg->eval_python(obj) != is_and) return !is_and;
+            }
+            return is_and;
+        }
+        case Op::Not: {
+            return !args_[0]->eval_python(obj);
+        }
+        default: {
+            if (!py::hasattr(obj, attr_.c_str())) return false;
+            py::object v = obj.attr(attr_.c_str());
+            // same as the kwargs filter, the constant decides what equality means
+            if (op_ == Op::Eq) return py_value_.equal(v);
+            if (op_ == Op::Ne) return !py_value_.equal(v);
+            NativeValue value;
+            if (!to_native_value(v, value)) {
+                // custom types might still know how to compare themselves
+                if (op_ == Op::Like) return false;
+                auto py_op = op_ == Op::Lt   ? Py_LT
+                             : op_ == Op::Le ? Py_LE
+                             : op_ == Op::Gt ? Py_GT
+                                             : Py_GE;
+                auto r = PyObject_RichCompareBool(v.ptr(), py_value_.ptr(), py_op);
+                if (r < 0) throw py::error_already_set();
+                return r;
+            }
+            return check(value);
+        }
+    }
+}
+
+template <typename T>
+bool compare_value(AttrPredicate::Op op, const T &a, const T &b) {
+    switch (op) {
+        case AttrPredicate::Op::Eq:
+            return a == b;
+        case AttrPredicate::Op::Ne:
+            return a != b;
+        case AttrPredicate::Op::Lt:
+            return a < b;
+        case AttrPredicate::Op::Le:
+            return a <= b;
+        case AttrPredicate::Op::Gt:
+            return a > b;
+        case AttrPredicate::Op::Ge:
+            return a >= b;
+        default:
+            return false;
+    }
+}
 
-    bool equal(const std::string &input) {
-        std::smatch match;
-        return std::regex_match(input, match, re_);
+bool AttrPredicate::check(const NativeValue &value) const {
+    if (std::holds_alternative<std::monostate>(value)) return false;
+    if (op_ == Op::Like) {
+        auto const *str = std::get_if<std::string>(&value);
+        return str && re_->equal(*str);
     }
+    if (auto const *str = std::get_if<std::string>(&value)) {
+        auto const *rhs = std::get_if<std::string>(&value_);
+        if (!rhs) return op_ == Op::Ne;
+        return compare_value(op_, *str, *rhs);
+    }
+    if (std::holds_alternative<std::string>(value_)) return op_ == Op::Ne;
+    // both are numbers
+    auto const *lhs_int = std::get_if<int64_t>(&value);
+    auto const *rhs_int = std::get_if<int64_t>(&value_);
+    if (lhs_int && rhs_int) return compare_value(op_, *lhs_int, *rhs_int);
+    auto as_double = [](const NativeValue &v) {
+        if (auto const *i = std::get_if<int64_t>(&v)) return static_cast<double>(*i);
+        return std::get<double>(v);
+    };
+    return compare_value(op_, as_double(value), as_double(value_));
+}
 
-private:
-    std::regex re_;
+// attribute reference used to build filter expressions, e.g. attr("name") == "a"
+struct AttrRef {
+    std::string name;
 };
 
 void init_query_helper_function(py::module &m) {
@@ -53,4 +213,46 @@ void init_query_helper_function(py::module &m) {
         });
     m.def("like",
           [](const std::string &pattern) { return std::make_shared<RegexString>(pattern); });
+
+    // native filter expressions, e.g. where(attr("name").like("a.*") & (attr("width") > 1))
+    using Op = AttrPredicate::Op;
+    auto ref = py::class_<AttrRef>(m, "AttrRef");
+    auto def_compare = [&ref](const char *name, Op op) {
+        ref.def(name, [op](const AttrRef &r, const py::object &value) {
+            auto result = AttrPredicate::compare(r.name, op, value);
+            if (!result) throw py::type_error("Only int, float and str values can be compared");
+            return result;
+        });
+    };
+    def_compare("__eq__", Op::Eq);
+    def_compare("__ne__", Op::Ne);
+    def_compare("__lt__", Op::Lt);
+    def_compare("__le__", Op::Le);
+    def_compare("__gt__", Op::Gt);
+    def_compare("__ge__", Op::Ge);
+    ref.def(
+        "like",
+        [](const AttrRef &r, const std::string &pattern) {
+            return AttrPredicate::like(r.name, std::make_shared<RegexString>(pattern));
+        },
+        py::arg("pattern"));
+    m.def(
+        "attr", [](const std::string &name) { return AttrRef{name}; }, py::arg("name"));
+
+    auto pred = py::class_<AttrPredicate, std::shared_ptr<AttrPredicate>>(m, "AttrPredicate");
+    pred.def("__and__",
+             [](const std::shared_ptr<AttrPredicate> &a, const std::shared_ptr<AttrPredicate> &b) {
+                 return AttrPredicate::combine(Op::And, {a, b});
+             });
+    pred.def("__or__",
+             [](const std::shared_ptr<AttrPredicate> &a, const std::shared_ptr<AttrPredicate> &b) {
+                 return AttrPredicate::combine(Op::Or, {a, b});
+             });
+    pred.def("__invert__", [](const std::shared_ptr<AttrPredicate> &p) {
+        return AttrPredicate::combine(Op::Not, {p});
+    });
+    // "a and b" would silently drop one side
+    pred.def("__bool__", [](const AttrPredicate &) -> bool {
+        throw py::type_error("Use &, | and ~ to combine filter expressions");
+    });
 }
\ No newline at end of file
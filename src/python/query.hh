@@ -2,6 +2,9 @@
 #define HGDB_RTL_QUERY_HH
 
 #include <functional>
+#include <optional>
+#include <regex>
+
 #include "object.hh"
 
 // query related objects
@@ -15,4 +18,56 @@ private:
     std::function<bool(const std::shared_ptr<QueryObject> &)> func_;
 };
 
+class RegexString {
+public:
+    explicit RegexString(const std::string &regex) : pattern_(regex) { re_ = std::regex(regex); }
+
+    [[nodiscard]] bool equal(const std::string &input) const {
+        return std::regex_match(input, re_);
+    }
+    [[nodiscard]] const std::string &pattern() const { return pattern_; }
+
+private:
+    std::string pattern_;
+    std::regex re_;
+};
+
+// converts int, float and str. returns false for any other type
+bool to_native_value(const pybind11::handle &obj, NativeValue &value);
+
+// filter expression over object attributes, e.g.
+// (attr("name") == "a") & attr("path").like(r"top\..*")
+// objects that provide the attributes through QueryObject::get_attr() are evaluated without
+// touching the interpreter, everything else falls back to Python attribute lookup
+class AttrPredicate {
+public:
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge, Like, And, Or, Not };
+
+    // returns nullptr if the value can't be compared natively
+    static std::shared_ptr<AttrPredicate> compare(const std::string &attr, Op op,
+                                                  const pybind11::object &value);
+    static std::shared_ptr<AttrPredicate> like(const std::string &attr,
+                                               std::shared_ptr<RegexString> re);
+    static std::shared_ptr<AttrPredicate> combine(Op op,
+                                                  std::vector<std::shared_ptr<AttrPredicate>> args);
+    // keyword arguments of filter()/where(), which are all equality checks. returns nullptr if
+    // any of the values is not int, float, str or like()
+    static std::shared_ptr<AttrPredicate> from_kwargs(const pybind11::kwargs &kwargs);
+
+    bool eval(const std::shared_ptr<QueryObject> &obj) const;
+
+private:
+    Op op_ = Op::Eq;
+    std::string attr_;
+    NativeValue value_;
+    pybind11::object py_value_;
+    std::shared_ptr<RegexString> re_;
+    std::vector<std::shared_ptr<AttrPredicate>> args_;
+
+    // std::nullopt if the object doesn't provide one of the attributes natively
+    [[nodiscard]] std::optional<bool> eval_native(const QueryObject &obj) const;
+    [[nodiscard]] bool eval_python(const pybind11::object &obj) const;
+    [[nodiscard]] bool check(const NativeValue &value) const;
+};
+
 #endif  // HGDB_RTL_QUERY_HH
@@ -6,81 +6,201 @@
 #include <pybind11/stl.h>
 #include <slang/diagnostics/DiagnosticEngine.h>
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <set>
+#include <unordered_map>
 
+#include "../util.hh"
 #include "data_source.hh"
 #include "object.hh"
 
 namespace py = pybind11;
 
-std::shared_ptr<QueryArray> create_instance_array(Ooze *ooze, hgdb::rtl::DesignDatabase &db) {
+std::shared_ptr<QueryArray> create_instance_array(Ooze *ooze,
+                                                  const std::shared_ptr<RTLDesign> &design) {
     auto result = std::make_shared<QueryArray>(ooze);
+    auto const &db = *design->db;
     auto const &instances = db.instances();
+    auto const &contexts = db.instance_contexts();
     result->data.reserve(instances.size());
-    for (auto const *inst : instances) {
-        result->data.emplace_back(std::make_shared<InstanceObject>(ooze, &db, inst));
+    for (uint64_t i = 0; i < instances.size(); i++) {
+        auto context = db.instance_caching() ? contexts[i] : hgdb::rtl::PathTable::none;
+        result->data.emplace_back(
+            std::make_shared<InstanceObject>(ooze, design, instances[i], context));
     }
     return result;
 }
 
-std::shared_ptr<QueryArray> create_variable_array(Ooze *ooze, hgdb::rtl::DesignDatabase &db) {
+// shared bodies list their members once, so they are repeated for every instance context
+template <typename T, typename F>
+void add_context_members(Ooze *ooze, const std::shared_ptr<RTLDesign> &design,
+                         QueryArray &result, const F &get_members) {
+    auto const &db = *design->db;
+    auto const &instances = db.instances();
+    auto const &contexts = db.instance_contexts();
+    for (uint64_t i = 0; i < instances.size(); i++) {
+        for (auto const *symbol : get_members(instances[i])) {
+            result.data.emplace_back(std::make_shared<T>(ooze, design, symbol, contexts[i]));
+        }
+    }
+}
+
+std::shared_ptr<QueryArray> create_variable_array(Ooze *ooze,
+                                                  const std::shared_ptr<RTLDesign> &design) {
     auto result = std::make_shared<QueryArray>(ooze);
+    auto const &db = *design->db;
+    if (db.instance_caching()) {
+        add_context_members<VariableObject>(ooze, design, *result, [&db](auto const *inst) {
+            return db.get_body_variables(inst);
+        });
+        return result;
+    }
     auto const &variables = db.variables();
     result->data.reserve(variables.size());
     for (auto const *v : variables) {
-        result->data.emplace_back(std::make_shared<VariableObject>(ooze, &db, v));
+        result->data.emplace_back(std::make_shared<VariableObject>(ooze, design, v));
     }
     return result;
 }
 
-std::shared_ptr<QueryArray> create_port_array(Ooze *ooze, hgdb::rtl::DesignDatabase &db) {
+std::shared_ptr<QueryArray> create_port_array(Ooze *ooze,
+                                                  const std::shared_ptr<RTLDesign> &design) {
     auto result = std::make_shared<QueryArray>(ooze);
+    auto const &db = *design->db;
+    if (db.instance_caching()) {
+        add_context_members<PortObject>(ooze, design, *result, [&db](auto const *inst) {
+            return db.get_body_ports(inst);
+        });
+        return result;
+    }
     auto const &ports = db.ports();
     result->data.reserve(ports.size());
     for (auto const *p : ports) {
-        result->data.emplace_back(std::make_shared<PortObject>(ooze, &db, p));
+        result->data.emplace_back(std::make_shared<PortObject>(ooze, design, p));
+    }
+    return result;
+}
+
+template <typename T>
+std::shared_ptr<QueryArray> create_snapshot_array(Ooze *ooze,
+                                                  const std::shared_ptr<RTLDesign> &design,
+                                                  uint64_t size) {
+    auto result = std::make_shared<QueryArray>(ooze);
+    result->data.reserve(size);
+    for (uint64_t i = 0; i < size; i++) {
+        result->data.emplace_back(std::make_shared<T>(ooze, design, i));
     }
     return result;
 }
 
 std::map<std::string, py::object> InstanceObject::values() const {
-    std::string path;
-    instance->getHierarchicalPath(path);
-    return {{"name", py::cast(instance->name)},
-            {"path", py::cast(path)},
-            {"definition", py::cast(instance->body.name)}};
+    return {{"name", py::cast(name())},
+            {"path", py::cast(path())},
+            {"definition", py::cast(definition())}};
 }
 
 std::map<std::string, py::object> VariableObject::values() const {
-    std::string path;
-    variable->getHierarchicalPath(path);
-    return {{"name", py::cast(variable->name)}, {"path", py::cast(path)}};
+    return {{"name", py::cast(name())}, {"path", py::cast(path())}};
 }
 
 std::map<std::string, py::object> PortObject::values() const {
-    std::string path;
-    port->getHierarchicalPath(path);
-    return {{"name", py::cast(port->name)}, {"path", py::cast(path)}};
+    return {{"name", py::cast(name())}, {"path", py::cast(path())}};
 }
 
-void RTL::compile() {
-    bool has_error = false;
-    source_manager_ = std::make_unique<slang::SourceManager>();
-    for (const std::string &dir : include_dirs) {
-        try {
-            source_manager_->addUserDirectory(string_view(dir));
-        } catch (const std::exception &) {
-            throw std::runtime_error(fmt::format("include directory {0} does not exist", dir));
-        }
+std::string port_direction(const slang::PortSymbol *port) {
+    switch (port->direction) {
+        case (slang::ArgumentDirection::In):
+            return "in";
+        case (slang::ArgumentDirection::Out):
+            return "out";
+        case (slang::ArgumentDirection::InOut):
+            return "inout";
+        case (slang::ArgumentDirection::Ref):
+            return "ref";
     }
+    throw std::runtime_error("Unknown port direction");
+}
 
-    for (const std::string &dir : include_sys_dirs_) {
-        try {
-            source_manager_->addSystemDirectory(string_view(dir));
-        } catch (const std::exception &) {
-            throw std::runtime_error(fmt::format("include directory {0} does not exist", dir));
-        }
+std::string RTLQueryObject::path() const {
+    check_valid();
+    if (!snapshot) return db->get_path(symbol, context);
+    switch (kind) {
+        case RTLKind::Instance:
+            return std::string(snapshot->instance_path(id));
+        case RTLKind::Variable:
+            return std::string(snapshot->variable_path(id));
+        case RTLKind::Port:
+            return std::string(snapshot->port_path(id));
+    }
+    return {};
+}
+
+std::string RTLQueryObject::name() const {
+    check_valid();
+    if (!snapshot) return std::string(symbol->name);
+    switch (kind) {
+        case RTLKind::Instance:
+            return std::string(snapshot->instance_name(id));
+        case RTLKind::Variable:
+            return std::string(snapshot->variable_name(id));
+        case RTLKind::Port:
+            return std::string(snapshot->port_name(id));
+    }
+    return {};
+}
+
+std::string InstanceObject::definition() const {
+    check_valid();
+    if (snapshot) return std::string(snapshot->instance_definition(id));
+    return std::string(instance->body.name);
+}
+
+std::string PortObject::direction() const {
+    check_valid();
+    if (snapshot) return std::string(hgdb::rtl::port_direction_name(snapshot->port_direction(id)));
+    return port_direction(port);
+}
+
+bool RTLQueryObject::get_attr(const std::string &name, NativeValue &value) const {
+    if (name != "path") return false;
+    value = path();
+    return true;
+}
+
+bool InstanceObject::get_attr(const std::string &name, NativeValue &value) const {
+    if (name == "name") {
+        value = this->name();
+    } else if (name == "definition") {
+        value = definition();
+    } else {
+        return RTLQueryObject::get_attr(name, value);
+    }
+    return true;
+}
+
+bool VariableObject::get_attr(const std::string &name, NativeValue &value) const {
+    if (name != "name") return RTLQueryObject::get_attr(name, value);
+    value = this->name();
+    return true;
+}
+
+bool PortObject::get_attr(const std::string &name, NativeValue &value) const {
+    if (name != "direction") return VariableObject::get_attr(name, value);
+    value = direction();
+    return true;
+}
+
+void RTLQueryObject::check_valid() const {
+    if (design->stale) {
+        throw std::runtime_error(
+            "RTL object belongs to a design that has been re-elaborated. Select it again");
     }
+}
+
+slang::Bag RTL::get_options() const {
     slang::PreprocessorOptions preprocessor_options;
     // compute defines
     std::vector<std::string> defines;
@@ -95,7 +215,7 @@ void RTL::compile() {
     slang::ParserOptions parser_options;
     slang::CompilationOptions compilation_options;
     compilation_options.suppressUnused = true;
-    compilation_options.disableInstanceCaching = true;
+    compilation_options.disableInstanceCaching = !instance_caching_;
     if (!top_.empty()) {
         compilation_options.topModules.emplace(top_);
     }
@@ -105,51 +225,333 @@ void RTL::compile() {
     options.set(lexer_options);
     options.set(parser_options);
     options.set(compilation_options);
+    return options;
+}
 
-    std::vector<slang::SourceBuffer> buffers;
-    for (const std::string &file : files_) {
-        slang::SourceBuffer buffer = source_manager_->readSource(file);
-        if (!buffer) {
-            has_error = true;
+uint64_t RTL::parse(std::vector<std::shared_ptr<slang::SyntaxTree>> &trees) {
+    // include directories and macros affect every file, so changing them starts over
+    std::string parse_key;
+    for (auto const &dir : include_dirs) parse_key.append(dir).append("\n");
+    for (auto const &dir : include_sys_dirs_) parse_key.append(dir).append("\n");
+    for (auto const &[name, value] : macros_) parse_key.append(name + "=" + value).append("\n");
+    if (parse_key != parse_key_) {
+        source_manager_ = nullptr;
+        parse_key_ = std::move(parse_key);
+    }
+    // the source manager caches included files by path, so a changed include file can only be
+    // read again by a new one
+    for (auto const &[filename, source] : source_files_) {
+        if (!source_manager_) break;
+        for (auto const &[include, include_stamp] : source.includes) {
+            hgdb::util::FileStamp stamp;
+            hgdb::util::get_file_stamp(include, stamp);
+            if (stamp != include_stamp) {
+                source_manager_ = nullptr;
+                break;
+            }
+        }
+    }
+    if (!source_manager_) {
+        source_manager_ = std::make_shared<slang::SourceManager>();
+        source_files_.clear();
+        for (const std::string &dir : include_dirs) {
+            try {
+                source_manager_->addUserDirectory(string_view(dir));
+            } catch (const std::exception &) {
+                throw std::runtime_error(
+                    fmt::format("include directory {0} does not exist", dir));
+            }
+        }
+
+        for (const std::string &dir : include_sys_dirs_) {
+            try {
+                source_manager_->addSystemDirectory(string_view(dir));
+            } catch (const std::exception &) {
+                throw std::runtime_error(
+                    fmt::format("include directory {0} does not exist", dir));
+            }
+        }
+    }
+    auto options = get_options();
+
+    // files whose content is unchanged keep their syntax trees. the source manager caches files
+    // by path, so a changed file is added again under a new name
+    trees.assign(files_.size(), nullptr);
+    std::vector<uint64_t> changed;
+    std::vector<slang::SourceBuffer> buffers(files_.size());
+    for (uint64_t i = 0; i < files_.size(); i++) {
+        auto const &filename = files_[i];
+        auto &source = source_files_[filename];
+        hgdb::util::FileStamp stamp;
+        hgdb::util::get_file_stamp(filename, stamp);
+        if (source.tree && stamp == source.stamp) {
+            trees[i] = source.tree;
             continue;
         }
+        source.stamp = stamp;
+        changed.emplace_back(i);
+        if (!source.tree) continue;
+        auto content = hgdb::util::read_file(filename);
+        // buffers are null terminated
+        auto text = source.text;
+        if (!text.empty() && text.back() == '\0') text.remove_suffix(1);
+        if (content == text) {
+            trees[i] = source.tree;
+            changed.pop_back();
+        } else {
+            buffers[i] = source_manager_->assignText(fmt::format("{0}@{1}", filename, ++revision_),
+                                                     content);
+        }
+    }
 
-        buffers.push_back(buffer);
+    // syntax trees are independent of each other, so they can be parsed concurrently. they are
+    // added to the compilation in the file order afterwards
+    auto parse_file = [&](uint64_t index) {
+        auto i = changed[index];
+        if (!buffers[i]) buffers[i] = source_manager_->readSource(files_[i]);
+        if (!buffers[i]) return;
+        trees[i] = slang::SyntaxTree::fromBuffer(buffers[i], *source_manager_, options);
+    };
+    auto num_threads = hgdb::util::get_num_threads(num_threads_);
+    if (num_threads > 1 && changed.size() > 1) {
+        hgdb::util::ThreadPool pool(num_threads);
+        hgdb::util::parallel_for(pool, changed.size(), parse_file);
+    } else {
+        for (uint64_t i = 0; i < changed.size(); i++) parse_file(i);
+    }
+    for (auto i : changed) {
+        auto &source = source_files_.at(files_[i]);
+        source.tree = trees[i];
+        source.text = buffers[i] ? buffers[i].data : std::string_view();
+    }
+    collect_includes(trees, changed, buffers);
+    return changed.size();
+}
+
+void RTL::collect_includes(const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees,
+                           const std::vector<uint64_t> &changed,
+                           const std::vector<slang::SourceBuffer> &buffers) {
+    // an included buffer leads back to the buffer of the file being parsed through the include
+    // locations
+    std::unordered_map<uint32_t, uint64_t> roots;
+    for (auto i : changed) {
+        source_files_.at(files_[i]).includes.clear();
+        if (trees[i] && buffers[i]) roots.emplace(buffers[i].id.getId(), i);
     }
+    for (auto const &buffer : source_manager_->getAllBuffers()) {
+        auto root = buffer;
+        for (auto parent = source_manager_->getIncludedFrom(root).buffer(); parent;
+             parent = source_manager_->getIncludedFrom(root).buffer()) {
+            root = parent;
+        }
+        if (root == buffer) continue;
+        auto it = roots.find(root.getId());
+        if (it == roots.end()) continue;
+        auto path = std::filesystem::path(source_manager_->getFullPath(buffer)).string();
+        hgdb::util::FileStamp stamp;
+        hgdb::util::get_file_stamp(path, stamp);
+        source_files_.at(files_[it->second]).includes.emplace(path, stamp);
+    }
+}
+
+uint64_t RTL::get_snapshot_key() const {
+    auto dirs = include_dirs;
+    dirs.insert(dirs.end(), include_sys_dirs_.begin(), include_sys_dirs_.end());
+    return hgdb::rtl::DesignSnapshot::compute_key(files_, dirs, macros_, top_);
+}
 
-    compilation_ = std::make_unique<slang::Compilation>(options);
-    for (const slang::SourceBuffer &buffer : buffers)
-        compilation_->addSyntaxTree(
-            slang::SyntaxTree::fromBuffer(buffer, *source_manager_, options));
+std::string RTL::get_design_key() const {
+    auto key = parse_key_;
+    for (auto const &filename : files_) key.append(filename).append("\n");
+    key.append(top_);
+    return key;
+}
+
+bool RTL::compile(RTLDesign &design,
+                  const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees) {
+    hgdb::util::Stopwatch watch;
+    bool has_error = false;
+    design.source_manager = source_manager_;
+    design.compilation = std::make_unique<slang::Compilation>(get_options());
+    for (auto const &tree : trees) {
+        if (!tree) {
+            has_error = true;
+            continue;
+        }
+        design.compilation->addSyntaxTree(tree);
+    }
     slang::DiagnosticEngine diag_engine(*source_manager_);
     // issuing all diagnosis
-    for (auto const &diag : compilation_->getAllDiagnostics()) diag_engine.issue(diag);
+    for (auto const &diag : design.compilation->getAllDiagnostics()) diag_engine.issue(diag);
     if (!has_error) {
         has_error = diag_engine.getNumErrors() != 0;
     }
+    timings_["elaborate"] = watch.lap();
     // load the source
     if (has_error) {
         std::cerr << "Error when parsing RTL files. Design database is incomplete" << std::endl;
     }
+    return !has_error;
 }
 
 std::shared_ptr<QueryArray> RTL::get_selector(py::handle handle) {
+    if (auto const &snapshot = design_->snapshot) {
+        if (handle.is(py::type::of<InstanceObject>())) {
+            return create_snapshot_array<InstanceObject>(ooze_, design_,
+                                                         snapshot->num_instances());
+        } else if (handle.is(py::type::of<VariableObject>())) {
+            return create_snapshot_array<VariableObject>(ooze_, design_,
+                                                         snapshot->num_variables());
+        } else if (handle.is(py::type::of<PortObject>())) {
+            return create_snapshot_array<PortObject>(ooze_, design_, snapshot->num_ports());
+        }
+        return nullptr;
+    }
     // based on what type it is
     if (handle.is(py::type::of<InstanceObject>())) {
         // create instance selector
-        return create_instance_array(ooze_, *db_);
+        return create_instance_array(ooze_, design_);
     } else if (handle.is(py::type::of<VariableObject>())) {
-        return create_variable_array(ooze_, *db_);
+        return create_variable_array(ooze_, design_);
     } else if (handle.is(py::type::of<PortObject>())) {
-        return create_port_array(ooze_, *db_);
+        return create_port_array(ooze_, design_);
     }
     return nullptr;
 }
 
+template <typename T, typename V>
+std::shared_ptr<QueryArray> create_array(Ooze *ooze, const std::shared_ptr<RTLDesign> &design,
+                                         const std::vector<V> &items) {
+    auto result = std::make_shared<QueryArray>(ooze);
+    result->data.reserve(items.size());
+    for (auto const &item : items) {
+        result->data.emplace_back(std::make_shared<T>(ooze, design, item));
+    }
+    return result;
+}
+
+template <typename T, typename V>
+std::shared_ptr<QueryArray> create_array(Ooze *ooze, const std::shared_ptr<RTLDesign> &design,
+                                         const std::vector<V> &items,
+                                         const std::vector<uint64_t> &contexts) {
+    auto result = std::make_shared<QueryArray>(ooze);
+    result->data.reserve(items.size());
+    auto instance_caching = design->db->instance_caching();
+    for (uint64_t i = 0; i < items.size(); i++) {
+        auto context = instance_caching ? contexts[i] : hgdb::rtl::PathTable::none;
+        result->data.emplace_back(std::make_shared<T>(ooze, design, items[i], context));
+    }
+    return result;
+}
+
+std::shared_ptr<QueryArray> RTL::get_path_selector(py::handle handle, std::string_view pattern,
+                                                   bool regex) {
+    hgdb::rtl::PathPattern path_pattern(pattern, regex);
+    if (auto const &snapshot = design_->snapshot) {
+        hgdb::rtl::DesignSnapshot::Selection selection;
+        {
+            py::gil_scoped_release release;
+            selection = snapshot->select_paths(path_pattern);
+        }
+        if (handle.is(py::type::of<InstanceObject>())) {
+            return create_array<InstanceObject>(ooze_, design_, selection.instances);
+        } else if (handle.is(py::type::of<VariableObject>())) {
+            return create_array<VariableObject>(ooze_, design_, selection.variables);
+        } else if (handle.is(py::type::of<PortObject>())) {
+            return create_array<PortObject>(ooze_, design_, selection.ports);
+        }
+        return nullptr;
+    }
+
+    hgdb::rtl::PathSelection selection;
+    {
+        py::gil_scoped_release release;
+        selection = design_->db->select_paths(path_pattern);
+    }
+    if (handle.is(py::type::of<InstanceObject>())) {
+        return create_array<InstanceObject>(ooze_, design_, selection.instances,
+                                            selection.instance_contexts);
+    } else if (handle.is(py::type::of<VariableObject>())) {
+        return create_array<VariableObject>(ooze_, design_, selection.variables,
+                                            selection.variable_contexts);
+    } else if (handle.is(py::type::of<PortObject>())) {
+        return create_array<PortObject>(ooze_, design_, selection.ports,
+                                        selection.port_contexts);
+    }
+    return nullptr;
+}
+
+bool RTL::load_design(const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees) {
+    auto design = std::make_shared<RTLDesign>();
+    auto success = compile(*design, trees);
+    design->db = std::make_unique<hgdb::rtl::DesignDatabase>(*design->compilation, num_threads_,
+                                                             instance_caching_);
+    for (auto const &[phase, time] : design->db->timings()) {
+        timings_[phase] = time;
+    }
+    design_key_ = get_design_key();
+    // incomplete designs are not cached, so that the errors show up every time
+    if (!snapshot_filename_.empty() && success) {
+        auto key = get_snapshot_key();
+        if (!design->db->save_snapshot(snapshot_filename_, key)) {
+            std::cerr << "Unable to write RTL snapshot to " << snapshot_filename_ << std::endl;
+        }
+    }
+    // objects of the previous design keep it alive until they are released
+    if (design_) design_->stale = true;
+    design_ = std::move(design);
+    has_error_ = !success;
+    return success;
+}
+
 void RTL::on_added(Ooze *ooze) {
-    compile();
-    db_ = std::make_unique<hgdb::rtl::DesignDatabase>(*compilation_);
     ooze_ = ooze;
+    hgdb::util::Stopwatch watch;
+    if (!snapshot_filename_.empty()) {
+        // a matching snapshot replaces the whole slang flow
+        auto key = get_snapshot_key();
+        auto snapshot = hgdb::rtl::DesignSnapshot::load(snapshot_filename_, key);
+        timings_["snapshot"] = watch.lap();
+        if (snapshot) {
+            design_ = std::make_shared<RTLDesign>();
+            design_->snapshot = std::move(snapshot);
+            return;
+        }
+    }
+
+    std::vector<std::shared_ptr<slang::SyntaxTree>> trees;
+    parse(trees);
+    timings_["parse"] = watch.lap();
+    load_design(trees);
+}
+
+bool RTL::update() {
+    if (!design_) throw std::runtime_error("RTL source has not been added");
+    timings_.clear();
+    hgdb::util::Stopwatch watch;
+    std::vector<std::shared_ptr<slang::SyntaxTree>> trees;
+    auto num_parsed = parse(trees);
+    timings_["parse"] = watch.lap();
+    // designs loaded from a snapshot have not been parsed at all. the top module is only used
+    // by the compilation
+    if (num_parsed == 0 && design_->db && get_design_key() == design_key_) return !has_error_;
+    return load_design(trees);
+}
+
+std::shared_ptr<QueryObject> RTL::bind_snapshot(const std::string &path,
+                                                const py::object &type) const {
+    auto const &snapshot = design_->snapshot;
+    if (type.is(py::type::of<InstanceObject>())) {
+        auto id = snapshot->find_instance(path);
+        if (id) return std::make_shared<InstanceObject>(ooze_, design_, *id);
+    } else if (type.is(py::type::of<VariableObject>())) {
+        auto id = snapshot->find_variable(path);
+        if (id) return std::make_shared<VariableObject>(ooze_, design_, *id);
+    } else if (type.is(py::type::of<PortObject>())) {
+        auto id = snapshot->find_port(path);
+        if (id) return std::make_shared<PortObject>(ooze_, design_, *id);
+    }
+    return nullptr;
 }
 
 std::shared_ptr<QueryObject> RTL::bind(const std::shared_ptr<QueryObject> &obj,
@@ -159,8 +561,19 @@ std::shared_ptr<QueryObject> RTL::bind(const std::shared_ptr<QueryObject> &obj,
     if (!py::hasattr(py_obj, "path")) return nullptr;
     auto const &py_path = py_obj.attr("path");
     auto const &path = py_path.cast<std::string>();
-    auto const &symbol = db_->select(path);
+    if (design_->snapshot) return bind_snapshot(path, type);
+    auto *db = design_->db.get();
+    auto const &symbol = db->select(path);
     if (!symbol) return nullptr;
+    // the symbol of a shared body doesn't identify the hierarchy, so the context comes from the
+    // path: the instance itself, or the instance a port or variable is declared in
+    auto context = hgdb::rtl::PathTable::none;
+    if (db->instance_caching()) {
+        auto context_path = slang::InstanceSymbol::isKind(symbol->kind)
+                                ? std::string_view(path)
+                                : std::string_view(path).substr(0, path.rfind('.'));
+        context = db->paths().find(context_path).value_or(hgdb::rtl::PathTable::none);
+    }
 
     if (type.is(py::type::of<InstanceObject>())) {
         // need to bind based on the path
@@ -168,36 +581,58 @@ std::shared_ptr<QueryObject> RTL::bind(const std::shared_ptr<QueryObject> &obj,
             return nullptr;
         }
         auto const &inst = symbol->as<slang::InstanceSymbol>();
-        return std::make_shared<InstanceObject>(ooze_, db_.get(), &inst);
+        return std::make_shared<InstanceObject>(ooze_, design_, &inst, context);
     } else if (type.is(py::type::of<VariableObject>())) {
         if (!slang::VariableSymbol::isKind(symbol->kind)) {
             return nullptr;
         }
         auto const &v = symbol->as<slang::VariableSymbol>();
-        return std::make_shared<VariableObject>(ooze_, db_.get(), &v);
+        return std::make_shared<VariableObject>(ooze_, design_, &v, context);
     } else if (type.is(py::type::of<PortObject>())) {
-        auto const *port = db_->get_port(symbol);
+        auto const *port = db->get_port(symbol);
         if (!port) {
             return nullptr;
         }
-        return std::make_shared<PortObject>(ooze_, db_.get(), port);
+        return std::make_shared<PortObject>(ooze_, design_, port, context);
     }
 
     return nullptr;
 }
 
-template <typename T>
-std::unique_ptr<InstanceObject> get_parent_instance(Ooze *ooze, const T &obj) {
-    const slang::InstanceSymbol *inst = nullptr;
-    if constexpr (std::is_base_of<slang::ValueSymbol, T>::value) {
-        inst = obj.db->get_parent_instance(obj.variable);
+std::unique_ptr<InstanceObject> get_parent_instance(Ooze *ooze, const RTLQueryObject &obj) {
+    obj.check_valid();
+    if (obj.snapshot) {
+        auto const *snapshot = obj.snapshot;
+        uint64_t parent = hgdb::rtl::DesignSnapshot::no_parent;
+        switch (obj.kind) {
+            case RTLQueryObject::RTLKind::Instance:
+                parent = snapshot->instance_parent(obj.id);
+                break;
+            case RTLQueryObject::RTLKind::Variable:
+                parent = snapshot->variable_instance(obj.id);
+                break;
+            case RTLQueryObject::RTLKind::Port:
+                parent = snapshot->port_instance(obj.id);
+                break;
+        }
+        if (parent == hgdb::rtl::DesignSnapshot::no_parent) return nullptr;
+        return std::make_unique<InstanceObject>(ooze, obj.design, parent);
+    }
 
-    } else if constexpr (std::is_same<slang::InstanceSymbol, T>::value) {
-        inst = obj.db->get_parent_instance(obj.instance);
+    if (obj.context != hgdb::rtl::PathTable::none) {
+        // instance nodes are parented by the node of their parent instance
+        auto parent = obj.kind == RTLQueryObject::RTLKind::Instance
+                          ? obj.db->paths().parent(obj.context)
+                          : obj.context;
+        if (parent == hgdb::rtl::PathTable::none) return nullptr;
+        auto const *inst = obj.db->get_context_instance(parent);
+        if (!inst) return nullptr;
+        return std::make_unique<InstanceObject>(ooze, obj.design, inst, parent);
     }
 
+    auto const *inst = obj.db->get_parent_instance(obj.symbol);
     if (!inst) return nullptr;
-    auto ptr = std::make_unique<InstanceObject>(ooze, obj.db, inst);
+    auto ptr = std::make_unique<InstanceObject>(ooze, obj.design, inst);
     return ptr;
 }
 
@@ -205,10 +640,10 @@ void init_instance_object(py::module &m) {
     auto cls =
         py::class_<InstanceObject, RTLQueryObject, std::shared_ptr<InstanceObject>>(m, "Instance");
     // we don't allow users to construct it by themself
-    cls.def_property_readonly("name", [](const InstanceObject &obj) { return obj.instance->name; })
+    cls.def_property_readonly("name", [](const InstanceObject &obj) { return obj.name(); })
         .def_property_readonly(
             "definition",
-            [](const std::shared_ptr<InstanceObject> &obj) { return obj->instance->body.name; })
+            [](const std::shared_ptr<InstanceObject> &obj) { return obj->definition(); })
         .def_property_readonly(
             "parent", [](const InstanceObject &obj) { return get_parent_instance(obj.ooze, obj); });
 }
@@ -216,7 +651,7 @@ void init_instance_object(py::module &m) {
 void init_variable_object(py::module &m) {
     auto cls =
         py::class_<VariableObject, RTLQueryObject, std::shared_ptr<VariableObject>>(m, "Variable");
-    cls.def_property_readonly("name", [](const VariableObject &obj) { return obj.variable->name; })
+    cls.def_property_readonly("name", [](const VariableObject &obj) { return obj.name(); })
         .def_property_readonly("instance",
                                [](const VariableObject &obj) -> std::unique_ptr<InstanceObject> {
                                    return get_parent_instance(obj.ooze, obj);
@@ -229,29 +664,14 @@ void init_variable_object(py::module &m) {
 
 void init_port_object(py::module &m) {
     auto cls = py::class_<PortObject, VariableObject, std::shared_ptr<PortObject>>(m, "Port");
-    cls.def_property_readonly("direction", [](const PortObject &port) -> std::string {
-        switch (port.port->direction) {
-            case (slang::ArgumentDirection::In):
-                return "in";
-            case (slang::ArgumentDirection::Out):
-                return "out";
-            case (slang::ArgumentDirection::InOut):
-                return "inout";
-            case (slang::ArgumentDirection::Ref):
-                return "ref";
-        }
-        throw std::runtime_error("Unknown port direction");
-    });
+    cls.def_property_readonly("direction", [](const PortObject &port) { return port.direction(); });
 }
 
 void init_rtl_object(py::module &m) {
     auto cls = py::class_<RTLQueryObject, QueryObject, std::shared_ptr<RTLQueryObject>>(
         m, "RTLQueryObject");
-    cls.def_property_readonly("path", [](const RTLQueryObject &obj) {
-        std::string name;
-        obj.symbol->getHierarchicalPath(name);
-        return name;
-    });
+    cls.def_property_readonly("path", [](const RTLQueryObject &obj) { return obj.path(); })
+        .def_property_readonly("valid", &RTLQueryObject::valid);
 }
 
 bool inside_instance(const std::shared_ptr<RTLQueryObject> &obj,
@@ -264,21 +684,59 @@ bool inside_instance(const std::shared_ptr<RTLQueryObject> &obj,
     }
     auto const &inst = std::dynamic_pointer_cast<InstanceObject>(parent);
     if (!inst) return false;
+    obj->check_valid();
+    inst->check_valid();
+    if (inst->design != obj->design) return false;
+    if (obj->snapshot) {
+        auto const *snapshot = obj->snapshot;
+        auto owner = hgdb::rtl::DesignSnapshot::no_parent;
+        switch (obj->kind) {
+            case RTLQueryObject::RTLKind::Instance:
+                return snapshot->instance_inside(obj->id, inst->id);
+            case RTLQueryObject::RTLKind::Variable:
+                owner = snapshot->variable_instance(obj->id);
+                break;
+            case RTLQueryObject::RTLKind::Port:
+                owner = snapshot->port_instance(obj->id);
+                break;
+        }
+        return owner == inst->id || snapshot->instance_inside(owner, inst->id);
+    }
+    if (obj->context != hgdb::rtl::PathTable::none && inst->context != hgdb::rtl::PathTable::none) {
+        auto const &paths = obj->db->paths();
+        if (obj->kind != RTLQueryObject::RTLKind::Instance && obj->context == inst->context) {
+            return true;
+        }
+        return paths.inside(obj->context, inst->context);
+    }
     auto const *instance = inst->instance;
     switch (obj->kind) {
         case RTLQueryObject::RTLKind::Instance: {
             auto const &child = std::reinterpret_pointer_cast<InstanceObject>(obj);
-            return hgdb::rtl::DesignDatabase::symbol_inside(child->instance, instance);
+            return child->db->symbol_inside(child->instance, instance);
         }
         case RTLQueryObject::RTLKind::Variable:
         case RTLQueryObject::RTLKind::Port: {
             auto const &child = std::reinterpret_pointer_cast<VariableObject>(obj);
-            return hgdb::rtl::DesignDatabase::symbol_inside(child->variable, instance);
+            return child->db->symbol_inside(child->variable, instance);
         }
     }
     return false;
 }
 
+// variables are upgraded to ports, the same way DesignDatabase::get_port() does
+std::optional<uint64_t> get_snapshot_port(const RTLQueryObject &obj) {
+    switch (obj.kind) {
+        case RTLQueryObject::RTLKind::Port:
+            return obj.id;
+        case RTLQueryObject::RTLKind::Variable:
+            return obj.snapshot->find_port(obj.snapshot->variable_path(obj.id));
+        case RTLQueryObject::RTLKind::Instance:
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
 std::shared_ptr<QueryObject> get_source(const std::shared_ptr<QueryObject> &target) {
     if (target->is_array()) {
         auto const &array = std::reinterpret_pointer_cast<QueryArray>(target);
@@ -293,21 +751,39 @@ std::shared_ptr<QueryObject> get_source(const std::shared_ptr<QueryObject> &targ
     } else {
         auto rtl_obj = std::dynamic_pointer_cast<RTLQueryObject>(target);
         if (!rtl_obj) return nullptr;
-        // notice that variable can be upgraded to port
-        const slang::PortSymbol *port_symbol = hgdb::rtl::DesignDatabase::get_port(rtl_obj->symbol);
-        if (!port_symbol) {
-            return nullptr;
+        rtl_obj->check_valid();
+        std::vector<std::shared_ptr<InstanceObject>> sources;
+        if (rtl_obj->snapshot) {
+            auto const *snapshot = rtl_obj->snapshot;
+            auto port = get_snapshot_port(*rtl_obj);
+            if (!port || snapshot->port_direction(*port) != hgdb::rtl::PortDirection::In) {
+                return nullptr;
+            }
+            for (auto id : snapshot->port_connections(*port)) {
+                sources.emplace_back(
+                    std::make_shared<InstanceObject>(target->ooze, rtl_obj->design, id));
+            }
+        } else {
+            // notice that variable can be upgraded to port
+            const slang::PortSymbol *port_symbol =
+                hgdb::rtl::DesignDatabase::get_port(rtl_obj->symbol);
+            if (!port_symbol) {
+                return nullptr;
+            }
+            if (port_symbol->direction != slang::ArgumentDirection::In) return nullptr;
+            for (auto const *inst : rtl_obj->db->get_connected_instances(port_symbol)) {
+                sources.emplace_back(
+                    std::make_shared<InstanceObject>(target->ooze, rtl_obj->design, inst));
+            }
         }
-        auto sources = rtl_obj->db->get_source_instances(port_symbol);
         if (sources.empty()) {
             return nullptr;
         } else if (sources.size() == 1) {
-            auto const *inst = *sources.begin();
-            return std::make_shared<InstanceObject>(target->ooze, rtl_obj->db, inst);
+            return sources.front();
         } else {
             auto result = std::make_shared<QueryArray>(target->ooze);
-            for (auto const *inst : sources) {
-                return std::make_shared<InstanceObject>(target->ooze, rtl_obj->db, inst);
+            for (auto const &inst : sources) {
+                result->add(inst);
             }
             return result;
         }
@@ -320,19 +796,29 @@ bool get_source_of_helper(const std::shared_ptr<QueryObject> &target,
     if (target->is_array()) {
         auto const &array = std::reinterpret_pointer_cast<QueryArray>(target);
         for (auto const &entry : array->data) {
-            auto r = get_source_of_helper(target, entry);
+            auto r = get_source_of_helper(entry, obj);
             if (r) return true;
         }
     } else {
         // we will try to upgrade the symbol to port if possible
         auto target_symbol = std::dynamic_pointer_cast<VariableObject>(target);
         if (!target_symbol) return false;
+        target_symbol->check_valid();
+        if (auto const *snapshot = target_symbol->snapshot) {
+            auto port = get_snapshot_port(*target_symbol);
+            auto obj_inst = std::dynamic_pointer_cast<InstanceObject>(obj);
+            if (!port || !obj_inst || obj_inst->design != target_symbol->design) return false;
+            if (snapshot->port_direction(*port) != hgdb::rtl::PortDirection::In) return false;
+            auto sources = snapshot->port_connections(*port);
+            return std::find(sources.begin(), sources.end(), obj_inst->id) != sources.end();
+        }
         auto const *port = hgdb::rtl::DesignDatabase::get_port(target_symbol->symbol);
         if (!port) return false;
         auto obj_inst = std::dynamic_pointer_cast<InstanceObject>(obj);
         if (!obj_inst) return false;
-        auto sources = target_symbol->db->get_source_instances(port);
-        return sources.find(obj_inst->instance) != sources.end();
+        if (port->direction != slang::ArgumentDirection::In) return false;
+        auto sources = target_symbol->db->get_connected_instances(port);
+        return std::find(sources.begin(), sources.end(), obj_inst->instance) != sources.end();
     }
     return false;
 }
@@ -345,6 +831,113 @@ std::function<bool(const std::shared_ptr<QueryObject> &)> get_source_of(
     return result;
 }
 
+struct ConeTargets {
+    std::shared_ptr<RTLDesign> design;
+    std::vector<const slang::Symbol *> symbols;
+    // snapshot-backed objects
+    std::vector<uint64_t> instances;
+    std::vector<uint64_t> ports;
+};
+
+void get_cone_targets(const std::shared_ptr<QueryObject> &target, ConeTargets &targets) {
+    if (target->is_array()) {
+        auto const &array = std::reinterpret_pointer_cast<QueryArray>(target);
+        for (auto const &entry : array->data) {
+            get_cone_targets(entry, targets);
+        }
+        return;
+    }
+    auto rtl_obj = std::dynamic_pointer_cast<RTLQueryObject>(target);
+    if (!rtl_obj) return;
+    rtl_obj->check_valid();
+    targets.design = rtl_obj->design;
+    if (rtl_obj->snapshot) {
+        if (rtl_obj->kind == RTLQueryObject::RTLKind::Instance) {
+            targets.instances.emplace_back(rtl_obj->id);
+        } else if (auto port = get_snapshot_port(*rtl_obj)) {
+            targets.ports.emplace_back(*port);
+        }
+        return;
+    }
+    if (rtl_obj->kind == RTLQueryObject::RTLKind::Instance) {
+        targets.symbols.emplace_back(rtl_obj->symbol);
+    } else if (auto const *port = hgdb::rtl::DesignDatabase::get_port(rtl_obj->symbol)) {
+        // variables are upgraded to ports
+        targets.symbols.emplace_back(port);
+    }
+}
+
+std::shared_ptr<QueryObject> get_cone(const std::shared_ptr<QueryObject> &target, bool fanin,
+                                      std::optional<uint64_t> depth, uint64_t num_threads) {
+    ConeTargets targets;
+    get_cone_targets(target, targets);
+    auto result = std::make_shared<QueryArray>(target->ooze);
+    auto max_depth = depth ? *depth : std::numeric_limits<uint64_t>::max();
+    if (!targets.design) return result;
+    if (auto const &snapshot = targets.design->snapshot) {
+        std::vector<uint64_t> ids;
+        {
+            py::gil_scoped_release release;
+            ids = snapshot->get_cone(targets.instances, targets.ports, fanin, max_depth);
+        }
+        result->data.reserve(ids.size());
+        for (auto id : ids) {
+            result->add(std::make_shared<InstanceObject>(target->ooze, targets.design, id));
+        }
+        return result;
+    }
+
+    auto const &db = targets.design->db;
+    std::vector<const slang::InstanceSymbol *> instances;
+    {
+        py::gil_scoped_release release;
+        instances = fanin ? db->get_fanin(targets.symbols, max_depth, num_threads)
+                          : db->get_fanout(targets.symbols, max_depth, num_threads);
+    }
+    result->data.reserve(instances.size());
+    for (auto const *inst : instances) {
+        result->add(std::make_shared<InstanceObject>(target->ooze, targets.design, inst));
+    }
+    return result;
+}
+
+// values that drive or load the targets, deduplicated in target order
+std::shared_ptr<QueryObject> get_driver_values(const std::shared_ptr<QueryObject> &target,
+                                               bool drivers) {
+    std::vector<std::shared_ptr<RTLQueryObject>> targets;
+    if (target->is_array()) {
+        auto const &array = std::reinterpret_pointer_cast<QueryArray>(target);
+        for (uint64_t i = 0; i < array->size(); i++) {
+            auto obj = std::dynamic_pointer_cast<RTLQueryObject>(array->get(i));
+            if (obj) targets.emplace_back(obj);
+        }
+    } else if (auto obj = std::dynamic_pointer_cast<RTLQueryObject>(target)) {
+        targets.emplace_back(obj);
+    }
+
+    auto result = std::make_shared<QueryArray>(target->ooze);
+    std::set<std::pair<const slang::ValueSymbol *, uint64_t>> visited;
+    for (auto const &obj : targets) {
+        obj->check_valid();
+        if (obj->snapshot) {
+            throw std::runtime_error("Driver queries are not available on RTL snapshots");
+        }
+        if (obj->kind == RTLQueryObject::RTLKind::Instance) continue;
+        auto *db = obj->db;
+        auto values = drivers ? db->get_drivers(obj->symbol) : db->get_loads(obj->symbol);
+        // assignments stay within the body, so the values share the context of the target
+        auto const *parent = db->get_parent_instance(obj->symbol);
+        for (auto const *value : values) {
+            auto context = db->get_parent_instance(value) == parent ? obj->context
+                                                                    : hgdb::rtl::PathTable::none;
+            if (!visited.emplace(value, context).second) continue;
+            result->add(
+                std::make_shared<VariableObject>(target->ooze, obj->design, value, context));
+        }
+    }
+    return result;
+}
+
 void init_helper_functions(py::module &m) {
     m.def(
         "inside",
@@ -364,11 +957,38 @@ void init_helper_functions(py::module &m) {
         "source_of",
         [](const std::shared_ptr<QueryObject> &target) { return get_source_of(target); },
         py::arg("target"));
+
+    // values assigned to or from variables, ports and nets through continuous assignments and
+    // procedural blocks
+    m.def(
+        "drivers",
+        [](const std::shared_ptr<QueryObject> &target) { return get_driver_values(target, true); },
+        py::arg("target"));
+    m.def(
+        "loads",
+        [](const std::shared_ptr<QueryObject> &target) { return get_driver_values(target, false); },
+        py::arg("target"));
+
+    // transitive cones through the connectivity graph. depth of None means no limit
+    m.def(
+        "fanin",
+        [](const std::shared_ptr<QueryObject> &target, std::optional<uint64_t> depth,
+           uint64_t num_threads) { return get_cone(target, true, depth, num_threads); },
+        py::arg("target"), py::arg("depth") = py::none(), py::arg("num_threads") = 1);
+    m.def(
+        "fanout",
+        [](const std::shared_ptr<QueryObject> &target, std::optional<uint64_t> depth,
+           uint64_t num_threads) { return get_cone(target, false, depth, num_threads); },
+        py::arg("target"), py::arg("depth") = py::none(), py::arg("num_threads") = 1);
 }
 
 void init_rtl(py::module &m) {
     py::class_<RTL, DataSource, std::shared_ptr<RTL>>(m, "RTL")
-        .def(py::init<>())
+        .def(py::init<uint64_t, std::string, bool>(), py::arg("num_threads") = 1,
+             py::arg("snapshot") = "", py::arg("instance_caching") = false)
+        .def("update", &RTL::update)
+        .def_property_readonly("timings", &RTL::timings)
+        .def_property_readonly("query_only", &RTL::query_only)
         .def("add_include_dir", &RTL::add_include_dir, py::arg("path"))
         .def("add_system_include_dir", &RTL::add_system_include_dir, py::arg("path"))
         .def("add_file", &RTL::add_file, py::arg("path"))
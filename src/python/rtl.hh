@@ -1,6 +1,7 @@
 #ifndef HGDB_RTL_PYTHON_RTL_HH
 #define HGDB_RTL_PYTHON_RTL_HH
 
+#include "../snapshot.hh"
 #include "data_source.hh"
 #include "object.hh"
 #include "slang/binding/OperatorExpressions.h"
@@ -8,30 +9,84 @@
 #include "slang/symbols/InstanceSymbols.h"
 #include "slang/symbols/PortSymbols.h"
 #include "slang/symbols/VariableSymbols.h"
+#include "slang/syntax/SyntaxTree.h"
+#include "slang/text/SourceManager.h"
+
+// an elaborated design, or the snapshot it is loaded from. query objects share it with the RTL
+// source, so re-elaborating never leaves them with freed symbols. the old design is marked
+// stale instead and its objects refuse to be used
+struct RTLDesign {
+    std::shared_ptr<slang::SourceManager> source_manager;
+    std::unique_ptr<slang::Compilation> compilation;
+    std::unique_ptr<hgdb::rtl::DesignDatabase> db;
+    std::unique_ptr<hgdb::rtl::DesignSnapshot> snapshot;
+    bool stale = false;
+};
 
 struct RTLQueryObject : public QueryObject {
 public:
     enum class RTLKind { Instance, Variable, Port };
     RTLQueryObject() = delete;
-    explicit RTLQueryObject(Ooze *ooze_, hgdb::rtl::DesignDatabase *db, const slang::Symbol *symbol,
-                            RTLKind kind)
-        : QueryObject(ooze_), db(db), symbol(symbol), kind(kind) {}
+    explicit RTLQueryObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design,
+                            const slang::Symbol *symbol, RTLKind kind,
+                            uint64_t context = hgdb::rtl::PathTable::none)
+        : QueryObject(ooze_),
+          design(std::move(design)),
+          db(this->design->db.get()),
+          symbol(symbol),
+          kind(kind),
+          context(context) {}
+    RTLQueryObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design, uint64_t id, RTLKind kind)
+        : QueryObject(ooze_),
+          design(std::move(design)),
+          db(nullptr),
+          symbol(nullptr),
+          kind(kind),
+          snapshot(this->design->snapshot.get()),
+          id(id) {}
+    std::shared_ptr<RTLDesign> design;
     hgdb::rtl::DesignDatabase *db;
 
     const slang::Symbol *symbol;
     RTLKind kind;
+
+    // set when the design is loaded from a snapshot. symbol is null in that case and id indexes
+    // the instance, variable or port table of the snapshot depending on the kind
+    const hgdb::rtl::DesignSnapshot *snapshot = nullptr;
+    uint64_t id = 0;
+
+    // path node the symbol is seen from, set when the design is elaborated with instance
+    // caching. it is the instance node for instances, and the node of the owning instance for
+    // ports and variables
+    uint64_t context = hgdb::rtl::PathTable::none;
+
+    [[nodiscard]] bool valid() const { return !design->stale; }
+    // throws if the design has been re-elaborated since the object was created
+    void check_valid() const;
+
+    [[nodiscard]] std::string path() const;
+    [[nodiscard]] std::string name() const;
+
+    bool get_attr(const std::string &name, NativeValue &value) const override;
 };
 
 struct InstanceObject : public RTLQueryObject {
 public:
     InstanceObject() = delete;
-    InstanceObject(Ooze *ooze_, hgdb::rtl::DesignDatabase *db,
-                   const slang::InstanceSymbol *instance)
-        : RTLQueryObject(ooze_, db, instance, RTLKind::Instance), instance(instance) {}
+    InstanceObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design,
+                   const slang::InstanceSymbol *instance,
+                   uint64_t context = hgdb::rtl::PathTable::none)
+        : RTLQueryObject(ooze_, std::move(design), instance, RTLKind::Instance, context),
+          instance(instance) {}
+    InstanceObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design, uint64_t id)
+        : RTLQueryObject(ooze_, std::move(design), id, RTLKind::Instance) {}
     // this holds instance information
     const slang::InstanceSymbol *instance = nullptr;
 
+    [[nodiscard]] std::string definition() const;
+
     [[nodiscard]] std::map<std::string, py::object> values() const override;
+    bool get_attr(const std::string &name, NativeValue &value) const override;
 
     [[maybe_unused]] [[nodiscard]] static bool is_kind(RTLKind kind) {
         return kind == RTLKind::Instance;
@@ -41,11 +96,18 @@ public:
 struct VariableObject : public RTLQueryObject {
 public:
     VariableObject() = delete;
-    VariableObject(Ooze *ooze_, hgdb::rtl::DesignDatabase *db, const slang::ValueSymbol *variable)
-        : RTLQueryObject(ooze_, db, variable, RTLKind::Variable), variable(variable) {}
+    VariableObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design,
+                   const slang::ValueSymbol *variable,
+                   uint64_t context = hgdb::rtl::PathTable::none)
+        : RTLQueryObject(ooze_, std::move(design), variable, RTLKind::Variable, context),
+          variable(variable) {}
+    VariableObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design, uint64_t id,
+                   RTLKind kind = RTLKind::Variable)
+        : RTLQueryObject(ooze_, std::move(design), id, kind) {}
     const slang::ValueSymbol *variable = nullptr;
 
     [[nodiscard]] std::map<std::string, py::object> values() const override;
+    bool get_attr(const std::string &name, NativeValue &value) const override;
 
     [[maybe_unused]] static bool is_kind(RTLKind kind) {
         return kind == RTLKind::Port || kind == RTLKind::Variable;
@@ -55,20 +117,38 @@ public:
 struct PortObject : public VariableObject {
 public:
     PortObject() = delete;
-    PortObject(Ooze *ooze_, hgdb::rtl::DesignDatabase *db, const slang::PortSymbol *port)
-        : VariableObject(ooze_, db, port), port(port) {
+    PortObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design, const slang::PortSymbol *port,
+               uint64_t context = hgdb::rtl::PathTable::none)
+        : VariableObject(ooze_, std::move(design), port, context), port(port) {
         kind = RTLKind::Port;
     }
+    PortObject(Ooze *ooze_, std::shared_ptr<RTLDesign> design, uint64_t id)
+        : VariableObject(ooze_, std::move(design), id, RTLKind::Port) {}
     const slang::PortSymbol *port = nullptr;
 
+    [[nodiscard]] std::string direction() const;
+
     [[nodiscard]] std::map<std::string, py::object> values() const override;
+    bool get_attr(const std::string &name, NativeValue &value) const override;
 
     [[maybe_unused]] static bool is_kind(RTLKind kind) { return kind == RTLKind::Port; }
 };
 
 class RTL : public DataSource {
 public:
-    inline RTL() : DataSource(DataSourceType::RTL) {}
+    // more than 1 thread parses the files and indexes the design in parallel. 0 means using all
+    // hardware threads. if a snapshot file is given, the design is loaded from it when its key
+    // matches the sources, and the file is (re)written after elaboration otherwise. the key
+    // covers the files included by the sources unless their names come from macros, see
+    // DesignSnapshot::compute_key().
+    // instance_caching lets slang share the bodies of identical instances, which saves memory
+    // and time on replicated designs. connectivity queries and snapshots are not available then
+    inline explicit RTL(uint64_t num_threads = 1, std::string snapshot = {},
+                        bool instance_caching = false)
+        : DataSource(DataSourceType::RTL),
+          num_threads_(num_threads),
+          instance_caching_(instance_caching),
+          snapshot_filename_(std::move(snapshot)) {}
     // methods to add files to the compilation unit
     inline void add_include_dir(const std::string &path) { include_dirs.emplace_back(path); }
     inline void add_system_include_dir(const std::string &path) {
@@ -80,7 +160,12 @@ public:
     }
     inline void set_top(const std::string &top) { top_ = top; }
 
-    void compile();
+    // re-elaborates the design after source files, the files they include or the options have
+    // changed. only the changed files are parsed again, the syntax trees of the others are
+    // reused. a changed include file or macro parses every file again. objects of the previous
+    // design become invalid. nothing happens if nothing has changed. returns false if the design
+    // has errors
+    bool update();
 
     [[nodiscard]] inline std::vector<py::handle> provides() const override {
         return {py::type::of<InstanceObject>(), py::type::of<VariableObject>(),
@@ -88,25 +173,65 @@ public:
     }
 
     std::shared_ptr<QueryArray> get_selector(py::handle handle) override;
+    std::shared_ptr<QueryArray> get_path_selector(py::handle handle, std::string_view pattern,
+                                                  bool regex) override;
 
     inline void on_added(Ooze * ooze) override;
 
     std::shared_ptr<QueryObject> bind(const std::shared_ptr<QueryObject> &obj,
                                       const py::object &type) override;
 
+    // phase name -> wall clock time in milliseconds
+    [[nodiscard]] const std::map<std::string, double> &timings() const { return timings_; }
+    // whether the design is served from a snapshot, without slang
+    [[nodiscard]] bool query_only() const { return design_ && design_->snapshot != nullptr; }
+
 private:
     std::vector<std::string> include_dirs;
     std::vector<std::string> include_sys_dirs_;
     std::vector<std::string> files_;
     std::map<std::string, std::string> macros_;
     std::string top_;
-
-    // the compilation object
-    std::unique_ptr<slang::Compilation> compilation_;
-    std::unique_ptr<hgdb::rtl::DesignDatabase> db_;
-    std::unique_ptr<slang::SourceManager> source_manager_;
+    uint64_t num_threads_;
+    bool instance_caching_;
+    std::map<std::string, double> timings_;
+
+    std::shared_ptr<RTLDesign> design_;
+    bool has_error_ = false;
+    std::string snapshot_filename_;
+
+    // parsed files, kept to re-parse only what changed. text is owned by the source manager
+    struct SourceFile {
+        hgdb::util::FileStamp stamp;
+        std::string_view text;
+        std::shared_ptr<slang::SyntaxTree> tree;
+        // files included while parsing the tree
+        std::map<std::string, hgdb::util::FileStamp> includes;
+    };
+    std::shared_ptr<slang::SourceManager> source_manager_;
+    std::map<std::string, SourceFile> source_files_;
+    // include directories and macros the files are parsed with
+    std::string parse_key_;
+    // files and options of the current design
+    std::string design_key_;
+    uint64_t revision_ = 0;
 
     Ooze *ooze_ = nullptr;
+
+    [[nodiscard]] slang::Bag get_options() const;
+    // syntax trees in file order. returns the number of files parsed
+    uint64_t parse(std::vector<std::shared_ptr<slang::SyntaxTree>> &trees);
+    void collect_includes(const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees,
+                          const std::vector<uint64_t> &changed,
+                          const std::vector<slang::SourceBuffer> &buffers);
+    [[nodiscard]] std::string get_design_key() const;
+    [[nodiscard]] uint64_t get_snapshot_key() const;
+    // returns false if the design has errors
+    bool compile(RTLDesign &design, const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees);
+    bool load_design(const std::vector<std::shared_ptr<slang::SyntaxTree>> &trees);
+
+    std::shared_ptr<QueryObject> bind_snapshot(const std::string &path,
+                                               const py::object &type) const;
 };
 
 #endif  // HGDB_RTL_PYTHON_RTL_HH
@@ -4,6 +4,8 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 namespace py = pybind11;
@@ -12,9 +14,25 @@ std::map<std::string, py::object> VCDSignal::values() const {
     return {{"name", py::cast(name)}, {"path", py::cast(path)}};
 }
 
-VCD::VCD(std::string path) : DataSource(DataSourceType::ValueChange), filename_(std::move(path)) {}
+bool VCDSignal::get_attr(const std::string &attr, NativeValue &value) const {
+    if (attr == "name") {
+        value = name;
+    } else if (attr == "path") {
+        value = path;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+VCD::VCD(std::string path, bool use_index, uint64_t num_threads, bool lazy,
+         uint64_t max_decoded_signals)
+    : DataSource(DataSourceType::ValueChange),
+      filename_(std::move(path)),
+      options_({use_index, num_threads, lazy, max_decoded_signals}) {}
 
-std::shared_ptr<QueryArray> create_signal_array(Ooze *ooze, const hgdb::vcd::VCDDatabase &db) {
+std::shared_ptr<QueryArray> create_signal_array(Ooze *ooze,
+                                               const hgdb::vcd::WaveformDatabase &db) {
     auto result = std::make_shared<QueryArray>(ooze);
     for (auto const &[id, signal] : db.signals) {
         auto s = std::make_shared<VCDSignal>(ooze);
@@ -60,7 +78,105 @@ void VCD::on_added(Ooze *ooze) {
     parse();
 }
 
-void VCD::parse() { db_ = std::make_unique<hgdb::vcd::VCDDatabase>(filename_); }
+void VCD::parse() { db_ = std::make_unique<hgdb::vcd::VCDDatabase>(filename_, options_); }
+
+void FST::parse() { db_ = std::make_unique<hgdb::fst::FSTDatabase>(filename_); }
+
+const hgdb::vcd::VCDSignal *get_signal(const hgdb::vcd::WaveformDatabase &db,
+                                       const std::string &path) {
+    auto it = db.signals.find(path);
+    if (it == db.signals.end()) throw py::key_error("Unable to find signal " + path);
+    return it->second.get();
+}
+
+std::vector<hgdb::vcd::VCDSamples> VCD::extract(const std::vector<std::string> &paths,
+                                                uint64_t t0, uint64_t t1,
+                                                const std::optional<std::string> &clock,
+                                                bool negedge) const {
+    std::vector<const hgdb::vcd::VCDSignal *> signals;
+    signals.reserve(paths.size());
+    for (auto const &path : paths) signals.emplace_back(get_signal(*db_, path));
+    const hgdb::vcd::VCDSignal *clock_signal = clock ? get_signal(*db_, *clock) : nullptr;
+
+    std::vector<hgdb::vcd::VCDSamples> result(signals.size());
+    // lazy formats decode every signal in a single pass. holding the stores keeps them decoded
+    // while the gil is released
+    auto pinned = signals;
+    if (clock_signal) pinned.emplace_back(clock_signal);
+    auto stores = db_->get_values(pinned, t1 > 0 ? t1 - 1 : 0);
+    py::gil_scoped_release release;
+    if (clock_signal) {
+        auto edges = clock_signal->get_edges(t0, t1, !negedge);
+        for (uint64_t i = 0; i < signals.size(); i++) {
+            result[i] = signals[i]->sample(edges);
+        }
+    } else {
+        for (uint64_t i = 0; i < signals.size(); i++) {
+            result[i] = signals[i]->get_transitions(t0, t1);
+        }
+    }
+    return result;
+}
+
+// contiguous uint64 array exposed through the buffer protocol, which allows numpy.asarray
+// and memoryview to use the data without copying
+class UInt64Array {
+public:
+    UInt64Array(std::vector<uint64_t> data, std::vector<py::ssize_t> shape)
+        : data(std::move(data)), shape(std::move(shape)) {}
+    std::vector<uint64_t> data;
+    std::vector<py::ssize_t> shape;
+
+    [[nodiscard]] py::buffer_info buffer() {
+        std::vector<py::ssize_t> strides(shape.size(), sizeof(uint64_t));
+        for (auto i = static_cast<int64_t>(shape.size()) - 2; i >= 0; i--) {
+            strides[i] = strides[i + 1] * shape[i + 1];
+        }
+        return py::buffer_info(data.data(), sizeof(uint64_t),
+                               py::format_descriptor<uint64_t>::format(),
+                               static_cast<py::ssize_t>(shape.size()), shape, strides, true);
+    }
+};
+
+std::vector<std::string> get_signal_paths(const py::handle &signals) {
+    std::vector<std::string> result;
+    auto get_path = [](const py::handle &obj) {
+        if (py::isinstance<py::str>(obj)) return obj.cast<std::string>();
+        return obj.attr("path").cast<std::string>();
+    };
+    if (py::isinstance<py::str>(signals) || py::hasattr(signals, "path")) {
+        result.emplace_back(get_path(signals));
+    } else {
+        for (auto const &obj : signals) result.emplace_back(get_path(obj));
+    }
+    return result;
+}
+
+py::dict extract(VCD &vcd, const py::object &signals, uint64_t t0, uint64_t t1,
+                 const py::object &clock, bool negedge) {
+    auto paths = get_signal_paths(signals);
+    std::optional<std::string> clock_path;
+    if (!clock.is_none()) {
+        auto clock_paths = get_signal_paths(clock);
+        if (clock_paths.size() != 1) throw py::value_error("Only one clock signal is allowed");
+        clock_path = clock_paths[0];
+    }
+    auto samples = vcd.extract(paths, t0, t1, clock_path, negedge);
+
+    py::dict result;
+    for (uint64_t i = 0; i < paths.size(); i++) {
+        auto &sample = samples[i];
+        auto size = static_cast<py::ssize_t>(sample.times.size());
+        std::vector<py::ssize_t> shape = {size};
+        // signals wider than 64 bits get one row of little-endian words per entry
+        if (sample.num_words > 1) shape.emplace_back(static_cast<py::ssize_t>(sample.num_words));
+        auto times = UInt64Array(std::move(sample.times), {size});
+        auto values = UInt64Array(std::move(sample.values), shape);
+        result[py::str(paths[i])] =
+            py::make_tuple(py::cast(std::move(times)), py::cast(std::move(values)));
+    }
+    return result;
+}
 
 class VCDValue : public QueryObject {
 public:
@@ -73,6 +189,17 @@ public:
     uint64_t time;
 
     const hgdb::vcd::VCDSignal *signal;
+
+    bool get_attr(const std::string &name, NativeValue &v) const override {
+        if (name == "path") {
+            v = path;
+        } else if (name == "time" && time <= std::numeric_limits<int64_t>::max()) {
+            v = static_cast<int64_t>(time);
+        } else {
+            return false;
+        }
+        return true;
+    }
 };
 
 // we define UInt and str wrapper for VCD values
@@ -82,12 +209,54 @@ public:
               const hgdb::vcd::VCDSignal *signal)
         : VCDValue(ooze, ValueType::UInt, std::move(path), time, signal), value(v) {}
     uint64_t value;
+    // only set for signals wider than 64 bits, little-endian
+    std::vector<uint64_t> words;
+
+    [[nodiscard]] py::object int_value() const {
+        if (words.size() <= 1) return py::int_(value);
+        py::object result = py::int_(0);
+        for (auto it = words.rbegin(); it != words.rend(); it++) {
+            result = (result << py::int_(64)) | py::int_(*it);
+        }
+        return result;
+    }
+
+    // little-endian bytes of the declared width, e.g. for numpy.frombuffer
+    [[nodiscard]] py::bytes bytes() const {
+        auto num_bytes = std::max<uint64_t>((signal->width + 7) / 8, 1);
+        std::string data(num_bytes, '\0');
+        for (uint64_t i = 0; i < num_bytes; i++) {
+            auto word = words.empty() ? (i < 8 ? value : 0) : words[i / 8];
+            data[i] = static_cast<char>(word >> ((i % 8) * 8));
+        }
+        return py::bytes(data);
+    }
 
     [[nodiscard]] std::map<std::string, py::object> values() const override {
-        return {{"path", py::cast(path)}, {"value", py::cast(value)}, {"time", py::cast(time)}};
+        return {{"path", py::cast(path)}, {"value", int_value()}, {"time", py::cast(time)}};
+    }
+
+    bool get_attr(const std::string &name, NativeValue &v) const override {
+        if (name != "value") return VCDValue::get_attr(name, v);
+        // wide values are compared as Python ints
+        if (words.size() > 1 || value > std::numeric_limits<int64_t>::max()) return false;
+        v = static_cast<int64_t>(value);
+        return true;
     }
 };
 
+std::shared_ptr<UIntValue> get_uint_value(Ooze *ooze, const std::string &path, uint64_t time,
+                                          const hgdb::vcd::VCDSignal *signal) {
+    if (signal->width <= 64) {
+        auto v = signal->get_uint_value(time);
+        return std::make_shared<UIntValue>(ooze, path, v, time, signal);
+    }
+    auto words = signal->get_wide_value(time);
+    auto result = std::make_shared<UIntValue>(ooze, path, words[0], time, signal);
+    result->words = std::move(words);
+    return result;
+}
+
 class StringValue : public VCDValue {
 public:
     StringValue(Ooze *ooze, std::string path, std::string value, uint64_t time,
@@ -99,6 +268,12 @@ public:
     [[nodiscard]] std::map<std::string, py::object> values() const override {
         return {{"path", py::cast(path)}, {"value", py::cast(value)}, {"time", py::cast(time)}};
     }
+
+    bool get_attr(const std::string &name, NativeValue &v) const override {
+        if (name != "value") return VCDValue::get_attr(name, v);
+        v = value;
+        return true;
+    }
 };
 
 std::function<std::shared_ptr<VCDValue>(const std::shared_ptr<VCDSignal> &)> get_value(
@@ -109,8 +284,7 @@ std::function<std::shared_ptr<VCDValue>(const std::shared_ptr<VCDSignal> &)> get
             auto v = s->signal->get_value(time);
             ptr = std::make_shared<StringValue>(s->ooze, s->path, v, time, s->signal);
         } else {
-            auto v = s->signal->get_uint_value(time);
-            ptr = std::make_shared<UIntValue>(s->ooze, s->path, v, time, s->signal);
+            ptr = get_uint_value(s->ooze, s->path, time, s->signal);
         }
         return ptr;
     };
@@ -118,6 +292,51 @@ std::function<std::shared_ptr<VCDValue>(const std::shared_ptr<VCDSignal> &)> get
     return func;
 }
 
+// get_value() for Python. the stores of every signal in the array are loaded at once, which
+// lazy formats decode in a single pass
+class ValueMapper : public ArrayMapper {
+public:
+    ValueMapper(uint64_t time, bool use_str) : time_(time), func_(get_value(time, use_str)) {}
+
+    std::shared_ptr<void> prepare(const std::vector<std::shared_ptr<QueryObject>> &objs) override {
+        std::map<hgdb::vcd::WaveformDatabase *, std::vector<const hgdb::vcd::VCDSignal *>> signals;
+        for (auto const &obj : objs) {
+            auto s = std::dynamic_pointer_cast<VCDSignal>(obj);
+            if (s && s->signal->db) signals[s->signal->db].emplace_back(s->signal);
+        }
+        // holding the stores keeps them decoded until every signal is mapped
+        using Stores = std::vector<std::shared_ptr<const hgdb::vcd::VCDValueStore>>;
+        auto stores = std::make_shared<Stores>();
+        for (auto const &[db, db_signals] : signals) {
+            auto loaded = db->get_values(db_signals, time_);
+            stores->insert(stores->end(), loaded.begin(), loaded.end());
+        }
+        return stores;
+    }
+
+    std::shared_ptr<QueryObject> map(const std::shared_ptr<QueryObject> &obj) override {
+        auto s = std::dynamic_pointer_cast<VCDSignal>(obj);
+        if (!s) throw py::type_error("get_value() can only be applied to VCDSignal");
+        return func_(s);
+    }
+
+private:
+    uint64_t time_;
+    std::function<std::shared_ptr<VCDValue>(const std::shared_ptr<VCDSignal> &)> func_;
+};
+
+std::function<std::shared_ptr<QueryObject>(QueryObject *)> time_mapper(uint64_t time) {
+    auto value = get_value(time);
+    auto func = [value](QueryObject *obj) -> std::shared_ptr<QueryObject> {
+        auto ptr = obj->shared_from_this();
+        auto v = std::dynamic_pointer_cast<VCDSignal>(ptr);
+        if (!v) return nullptr;
+        auto r = value(v);
+        return r;
+    };
+    return func;
+}
+
 class VCDTimeGenerator : public FilterMapperGenerator {
 public:
     explicit VCDTimeGenerator(const std::set<uint64_t> &times) : times_(times), it(times.begin()) {}
@@ -128,15 +347,7 @@ public:
         } else {
             auto t = *it;
             it++;
-            auto value = get_value(t);
-            auto func = [value](QueryObject *obj) -> std::shared_ptr<QueryObject> {
-                auto ptr = obj->shared_from_this();
-                auto v = std::dynamic_pointer_cast<VCDSignal>(ptr);
-                if (!v) return nullptr;
-                auto r = value(v);
-                return r;
-            };
-            return func;
+            return time_mapper(t);
         }
     }
 
@@ -145,10 +356,206 @@ private:
     std::set<uint64_t>::const_iterator it;
 };
 
+// visits the clock edges only
+class VCDEdgeGenerator : public FilterMapperGenerator {
+public:
+    explicit VCDEdgeGenerator(std::vector<uint64_t> edges) : edges_(std::move(edges)) {}
+
+    std::optional<std::function<std::shared_ptr<QueryObject>(QueryObject *)>> next() override {
+        if (index_ >= edges_.size()) return std::nullopt;
+        return time_mapper(edges_[index_++]);
+    }
+
+private:
+    std::vector<uint64_t> edges_;
+    uint64_t index_ = 0;
+};
+
 std::unique_ptr<FilterMapperGenerator> VCD::filter_generator() const {
     return std::make_unique<VCDTimeGenerator>(db_->times);
 }
 
+std::vector<uint64_t> VCD::get_edges(const py::object &clock, bool posedge) const {
+    auto paths = get_signal_paths(clock);
+    if (paths.size() != 1) throw py::value_error("Only one clock signal is allowed");
+    auto const *signal = get_signal(*db_, paths[0]);
+    return signal->get_edges(0, std::numeric_limits<uint64_t>::max(), posedge);
+}
+
+std::unique_ptr<FilterMapperGenerator> VCD::filter_generator(const py::object &clock,
+                                                             bool posedge) const {
+    return std::make_unique<VCDEdgeGenerator>(get_edges(clock, posedge));
+}
+
+// a signal value, or a single bit of it, used in native predicates. an empty path refers to
+// the signal when() is called on
+struct ValueExpr {
+    std::string path;
+    std::optional<uint64_t> bit;
+};
+
+struct ValuePredicate {
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge, And, Or, Not };
+    Op op;
+    // only used by comparisons
+    ValueExpr lhs;
+    uint64_t rhs = 0;
+    std::vector<std::shared_ptr<ValuePredicate>> args;
+
+    static std::shared_ptr<ValuePredicate> compare(const ValueExpr &expr, Op op, uint64_t value) {
+        auto result = std::make_shared<ValuePredicate>();
+        result->op = op;
+        result->lhs = expr;
+        result->rhs = value;
+        return result;
+    }
+
+    static std::shared_ptr<ValuePredicate> combine(
+        Op op, std::vector<std::shared_ptr<ValuePredicate>> args) {
+        auto result = std::make_shared<ValuePredicate>();
+        result->op = op;
+        result->args = std::move(args);
+        return result;
+    }
+
+    void get_paths(std::vector<std::string> &paths) const {
+        if (args.empty()) {
+            if (std::find(paths.begin(), paths.end(), lhs.path) == paths.end()) {
+                paths.emplace_back(lhs.path);
+            }
+        }
+        for (auto const &arg : args) arg->get_paths(paths);
+    }
+
+    // evaluates all the samples at once. samples are indexed the same way as paths
+    [[nodiscard]] std::vector<uint8_t> eval(const std::vector<std::string> &paths,
+                                            const std::vector<hgdb::vcd::VCDSamples> &samples,
+                                            uint64_t size) const {
+        std::vector<uint8_t> result(size, 0);
+        switch (op) {
+            case Op::And:
+            case Op::Or: {
+                result = args[0]->eval(paths, samples, size);
+                for (uint64_t i = 1; i < args.size(); i++) {
+                    auto other = args[i]->eval(paths, samples, size);
+                    for (uint64_t j = 0; j < size; j++) {
+                        result[j] = op == Op::And ? (result[j] & other[j]) : (result[j] | other[j]);
+                    }
+                }
+                break;
+            }
+            case Op::Not: {
+                result = args[0]->eval(paths, samples, size);
+                for (auto &r : result) r = !r;
+                break;
+            }
+            default: {
+                auto index = std::find(paths.begin(), paths.end(), lhs.path) - paths.begin();
+                auto const &sample = samples[index];
+                auto num_words = sample.num_words;
+                for (uint64_t i = 0; i < size; i++) {
+                    auto const *words = sample.values.data() + i * num_words;
+                    uint64_t value;
+                    // anything that doesn't fit in the first word makes the value larger than rhs
+                    bool overflow = false;
+                    if (lhs.bit) {
+                        auto bit = *lhs.bit;
+                        value = bit / 64 < num_words ? (words[bit / 64] >> (bit % 64)) & 1 : 0;
+                    } else {
+                        value = words[0];
+                        for (uint64_t w = 1; w < num_words; w++) overflow |= words[w] != 0;
+                    }
+                    result[i] = check(value, overflow);
+                }
+                break;
+            }
+        }
+        return result;
+    }
+
+private:
+    [[nodiscard]] bool check(uint64_t value, bool overflow) const {
+        switch (op) {
+            case Op::Eq:
+                return !overflow && value == rhs;
+            case Op::Ne:
+                return overflow || value != rhs;
+            case Op::Lt:
+                return !overflow && value < rhs;
+            case Op::Le:
+                return !overflow && value <= rhs;
+            case Op::Gt:
+                return overflow || value > rhs;
+            case Op::Ge:
+                return overflow || value >= rhs;
+            default:
+                return false;
+        }
+    }
+};
+
+std::shared_ptr<ValuePredicate> to_predicate(const py::handle &obj) {
+    if (py::isinstance<ValuePredicate>(obj)) return obj.cast<std::shared_ptr<ValuePredicate>>();
+    // a value by itself is true when it's not zero
+    if (py::isinstance<ValueExpr>(obj)) {
+        return ValuePredicate::compare(obj.cast<ValueExpr>(), ValuePredicate::Op::Ne, 0);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<QueryArray> VCD::when(const std::shared_ptr<QueryObject> &obj,
+                                      const py::object &predicate, const py::object &clock,
+                                      bool posedge) const {
+    auto pred = to_predicate(predicate);
+    if (!pred) return nullptr;
+
+    // figure out which signal value refers to
+    std::vector<std::shared_ptr<VCDSignal>> targets;
+    if (auto signal = std::dynamic_pointer_cast<VCDSignal>(obj)) {
+        targets.emplace_back(signal);
+    } else if (obj->is_array()) {
+        for (auto const &entry : std::reinterpret_pointer_cast<QueryArray>(obj)->data) {
+            if (auto s = std::dynamic_pointer_cast<VCDSignal>(entry)) targets.emplace_back(s);
+        }
+    }
+    std::vector<std::string> paths;
+    pred->get_paths(paths);
+    std::vector<const hgdb::vcd::VCDSignal *> signals;
+    for (auto const &path : paths) {
+        if (!path.empty()) {
+            signals.emplace_back(get_signal(*db_, path));
+        } else if (targets.size() == 1) {
+            signals.emplace_back(targets[0]->signal);
+        } else {
+            throw py::value_error("value has to specify a path when there are multiple signals");
+        }
+    }
+
+    auto times = clock.is_none() ? std::vector<uint64_t>(db_->times.begin(), db_->times.end())
+                                 : get_edges(clock, posedge);
+    std::vector<uint64_t> matches;
+    {
+        // same as extract(), the stores are decoded and held before releasing the gil
+        auto stores = db_->get_values(signals);
+        py::gil_scoped_release release;
+        std::vector<hgdb::vcd::VCDSamples> samples;
+        samples.reserve(signals.size());
+        for (auto const *signal : signals) samples.emplace_back(signal->sample(times));
+        auto result = pred->eval(paths, samples, times.size());
+        for (uint64_t i = 0; i < times.size(); i++) {
+            if (result[i]) matches.emplace_back(times[i]);
+        }
+    }
+
+    // same objects as the ones passed to Python predicates
+    auto result = std::make_shared<QueryArray>(obj->ooze);
+    for (auto t : matches) {
+        auto o = obj->map(time_mapper(t));
+        if (o) result->add(o);
+    }
+    return result;
+}
+
 std::shared_ptr<VCDValue> pre_value(const std::shared_ptr<VCDValue> &value) {
     auto *db = value->signal->db;
     auto time = value->time;
@@ -164,8 +571,7 @@ std::shared_ptr<VCDValue> pre_value(const std::shared_ptr<VCDValue> &value) {
                 return std::make_shared<StringValue>(value->ooze, value->path, v, t, value->signal);
             }
             case VCDValue::ValueType::UInt: {
-                auto v = value->signal->get_uint_value(t);
-                return std::make_shared<UIntValue>(value->ooze, value->path, v, t, value->signal);
+                return get_uint_value(value->ooze, value->path, t, value->signal);
             }
             default: {
                 return nullptr;
@@ -182,12 +588,66 @@ void init_vcd(py::module &m) {
     vcd.def_property_readonly("name", [](const VCDSignal &s) { return s.name; });
 
     auto source = py::class_<VCD, DataSource, std::shared_ptr<VCD>>(m, "VCD");
-    source.def(py::init<const std::string>(), py::arg("filename"));
+    // num_threads = 0 uses all hardware threads
+    source.def(py::init<const std::string, bool, uint64_t, bool, uint64_t>(),
+               py::arg("filename"), py::arg("use_index") = false, py::arg("num_threads") = 1,
+               py::arg("lazy") = false, py::arg("max_decoded_signals") = 1024);
     source.def_property_readonly("stats", [](const VCD &vcd) { return vcd.get_stats(); });
+    source.def_property_readonly("loaded_from_index", &VCD::loaded_from_index);
+    source.def("extract", &extract, py::arg("signals"), py::arg("t0") = 0,
+               py::arg("t1") = std::numeric_limits<uint64_t>::max(), py::arg("clock") = py::none(),
+               py::arg("negedge") = false);
+
+    auto fst = py::class_<FST, VCD, std::shared_ptr<FST>>(m, "FST");
+    fst.def(py::init<const std::string>(), py::arg("filename"));
+
+    // native predicates for when(), e.g. when(value > 2) or when(value("top.a")[0] == 1)
+    using Op = ValuePredicate::Op;
+    auto expr = py::class_<ValueExpr>(m, "ValueExpr");
+    expr.def(py::init<>());
+    expr.def("__call__", [](const ValueExpr &, const std::string &path) {
+        return ValueExpr{path, std::nullopt};
+    });
+    expr.def("__getitem__",
+             [](const ValueExpr &e, uint64_t bit) { return ValueExpr{e.path, bit}; });
+    auto def_compare = [&expr](const char *name, Op op) {
+        expr.def(name, [op](const ValueExpr &e, uint64_t v) {
+            return ValuePredicate::compare(e, op, v);
+        });
+    };
+    def_compare("__eq__", Op::Eq);
+    def_compare("__ne__", Op::Ne);
+    def_compare("__lt__", Op::Lt);
+    def_compare("__le__", Op::Le);
+    def_compare("__gt__", Op::Gt);
+    def_compare("__ge__", Op::Ge);
+    m.attr("value") = ValueExpr{};
+
+    auto pred = py::class_<ValuePredicate, std::shared_ptr<ValuePredicate>>(m, "ValuePredicate");
+    auto def_combine = [&pred](const char *name, Op op) {
+        pred.def(name, [op](const std::shared_ptr<ValuePredicate> &p, const py::object &other) {
+            auto rhs = to_predicate(other);
+            if (!rhs) throw py::type_error("Unsupported predicate");
+            return ValuePredicate::combine(op, {p, rhs});
+        });
+    };
+    def_combine("__and__", Op::And);
+    def_combine("__or__", Op::Or);
+    pred.def("__invert__", [](const std::shared_ptr<ValuePredicate> &p) {
+        return ValuePredicate::combine(Op::Not, {p});
+    });
+
+    py::class_<UInt64Array>(m, "UInt64Array", py::buffer_protocol())
+        .def_buffer(&UInt64Array::buffer)
+        .def("__len__", [](const UInt64Array &a) { return a.shape[0]; })
+        .def_property_readonly("shape",
+                               [](const UInt64Array &a) { return py::tuple(py::cast(a.shape)); });
 
-    m.def("get_value", &get_value, py::arg("time"), py::arg("use_str"));
+    py::class_<ValueMapper, ArrayMapper, std::shared_ptr<ValueMapper>>(m, "ValueMapper");
     m.def(
-        "get_value", [](uint64_t time) { return get_value(time, false); }, py::arg("time"));
+        "get_value",
+        [](uint64_t time, bool use_str) { return std::make_shared<ValueMapper>(time, use_str); },
+        py::arg("time"), py::arg("use_str") = false);
     m.def("pre_value", &pre_value, py::arg("value"));
 
     auto value = py::class_<VCDValue, QueryObject, std::shared_ptr<VCDValue>>(m, "VCDValue");
@@ -195,8 +655,9 @@ void init_vcd(py::module &m) {
     value.def_property_readonly("time", [](VCDValue &v) { return v.time; });
 
     auto uint = py::class_<UIntValue, VCDValue, std::shared_ptr<UIntValue>>(m, "UIntValue");
-    uint.def("__int__", [](const UIntValue &v) { return v.value; });
-    uint.def_property_readonly("value", [](const UIntValue &v) { return v.value; });
+    uint.def("__int__", &UIntValue::int_value);
+    uint.def_property_readonly("value", &UIntValue::int_value);
+    uint.def_property_readonly("bytes", &UIntValue::bytes);
 
     auto str = py::class_<StringValue, VCDValue, std::shared_ptr<StringValue>>(m, "StringValue");
     str.def("__str__", [](const StringValue &s) { return s.value; });
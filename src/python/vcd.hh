@@ -1,6 +1,7 @@
 #ifndef HGDB_RTL_PYTHON_VCD_HH
 #define HGDB_RTL_PYTHON_VCD_HH
 
+#include "../fst.hh"
 #include "../vcd.hh"
 #include "data_source.hh"
 
@@ -11,12 +12,14 @@ struct VCDSignal: public QueryObject {
     hgdb::vcd::VCDSignal *signal = nullptr;
 
     [[nodiscard]] std::map<std::string, pybind11::object> values() const override;
+    bool get_attr(const std::string &attr, NativeValue &value) const override;
 };
 
 
 class VCD: public DataSource {
 public:
-    explicit VCD(std::string path);
+    explicit VCD(std::string path, bool use_index = false, uint64_t num_threads = 1,
+                 bool lazy = false, uint64_t max_decoded_signals = 1024);
 
     [[nodiscard]] inline std::vector<py::handle> provides() const override {
         return {py::type::of<VCDSignal>()};
@@ -27,16 +30,42 @@ public:
     std::shared_ptr<QueryObject> bind(const std::shared_ptr<QueryObject> &obj, const py::object &type) override;
 
     [[nodiscard]] auto get_stats() const { return db_->get_stats(); }
+    [[nodiscard]] bool loaded_from_index() const { return db_->loaded_from_index(); }
+
+    // value changes in [t0, t1) of each path, or the values at the clock edges in [t0, t1)
+    // if clock is set
+    [[nodiscard]] std::vector<hgdb::vcd::VCDSamples> extract(
+        const std::vector<std::string> &paths, uint64_t t0, uint64_t t1,
+        const std::optional<std::string> &clock, bool negedge) const;
 
     void on_added(Ooze *ooze) override;
 
     std::unique_ptr<FilterMapperGenerator> filter_generator() const override;
+    std::unique_ptr<FilterMapperGenerator> filter_generator(const py::object &clock,
+                                                            bool posedge) const override;
+    std::shared_ptr<QueryArray> when(const std::shared_ptr<QueryObject> &obj,
+                                     const py::object &predicate, const py::object &clock,
+                                     bool posedge) const override;
 
-private:
-    std::unique_ptr<hgdb::vcd::VCDDatabase> db_;
+protected:
+    std::unique_ptr<hgdb::vcd::WaveformDatabase> db_;
     std::string filename_;
+
+    virtual void parse();
+    [[nodiscard]] std::vector<uint64_t> get_edges(const py::object &clock, bool posedge) const;
+
+private:
+    hgdb::vcd::VCDOptions options_;
     Ooze *ooze_ = nullptr;
-    void parse();
+};
+
+// FST waveforms share the same signal and value objects as VCD
+class FST : public VCD {
+public:
+    explicit FST(std::string path) : VCD(std::move(path)) {}
+
+protected:
+    void parse() override;
 };
 
 #endif  // HGDB_RTL_PYTHON_VCD_HH
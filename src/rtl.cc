@@ -1,20 +1,29 @@
 #include "rtl.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <stack>
+#include <unordered_set>
 
 #include "fmt/format.h"
+#include "slang/binding/MiscExpressions.h"
 #include "slang/binding/OperatorExpressions.h"
+#include "slang/binding/SelectExpressions.h"
 #include "slang/symbols/ASTVisitor.h"
 #include "slang/symbols/InstanceSymbols.h"
+#include "slang/symbols/MemberSymbols.h"
 #include "slang/symbols/PortSymbols.h"
 #include "slang/symbols/VariableSymbols.h"
+#include "snapshot.hh"
+#include "util.hh"
 
 namespace hgdb::rtl {
 
-DesignDatabase::DesignDatabase(slang::Compilation &compilation) : compilation_(compilation) {
-    index_values();
+DesignDatabase::DesignDatabase(slang::Compilation &compilation, uint64_t num_threads,
+                               bool instance_caching)
+    : compilation_(compilation), instance_caching_(instance_caching) {
+    index_values(num_threads);
 }
 
 const slang::Symbol *DesignDatabase::select(const std::string &path) {
@@ -77,7 +86,7 @@ private:
 std::set<const slang::ValueSymbol *> DesignDatabase::get_connected_symbols(
     const slang::InstanceSymbol *instance, const slang::PortSymbol *port) {
     auto const *conn = instance->getPortConnection(*port);
-    if (conn) {
+    if (conn && conn->expr) {
         auto const *other = conn->expr;
         std::set<const slang::ValueSymbol *> symbols;
         SymbolExprVisitor visitor(symbols);
@@ -113,186 +122,605 @@ std::string DesignDatabase::get_symbol_path(const slang::Symbol *symbol) {
     return result;
 }
 
+std::string DesignDatabase::get_path(const slang::Symbol *symbol) const {
+    auto id = get_path_id(symbol);
+    return id ? std::string(paths_.path(*id)) : get_symbol_path(symbol);
+}
+
+std::string DesignDatabase::get_path(const slang::Symbol *symbol, uint64_t context) const {
+    if (context == PathTable::none) return get_path(symbol);
+    auto path = std::string(paths_.path(context));
+    if (slang::InstanceSymbol::isKind(symbol->kind)) return path;
+    return path.append(".").append(symbol->name);
+}
+
+const slang::InstanceSymbol *DesignDatabase::get_context_instance(uint64_t context) const {
+    return context < path_symbols_.size() ? path_symbols_[context].instance : nullptr;
+}
+
+std::span<const slang::PortSymbol *const> DesignDatabase::get_body_ports(
+    const slang::InstanceSymbol *instance) const {
+    auto it = body_index_.find(&instance->body);
+    if (it == body_index_.end()) return {};
+    return {ports_.data() + body_port_offsets_[it->second],
+            ports_.data() + body_port_offsets_[it->second + 1]};
+}
+
+std::span<const slang::VariableSymbol *const> DesignDatabase::get_body_variables(
+    const slang::InstanceSymbol *instance) const {
+    auto it = body_index_.find(&instance->body);
+    if (it == body_index_.end()) return {};
+    return {variables_.data() + body_variable_offsets_[it->second],
+            variables_.data() + body_variable_offsets_[it->second + 1]};
+}
+
+std::optional<uint64_t> DesignDatabase::get_path_id(const slang::Symbol *symbol) const {
+    auto it = path_ids_.find(symbol);
+    if (it == path_ids_.end()) return std::nullopt;
+    return it->second;
+}
+
 bool DesignDatabase::symbol_inside(const slang::Symbol *child,
-                                   const slang::InstanceSymbol *parent) {
-    // there are two approaches. the easiest way is just to compare their hierarchy path
+                                   const slang::InstanceSymbol *parent) const {
     if (!child || !parent) return false;
-    auto child_inst_name = get_symbol_path(child);
-    auto parent_inst_name = get_symbol_path(parent);
-    auto pos = child_inst_name.find(parent_inst_name);
-    if (pos != std::string::npos) {
-        // has to have a dot afterwards
-        if (child_inst_name.length() > parent_inst_name.length()) {
-            return child_inst_name[parent_inst_name.length()] == '.';
-        }
-    }
-    return false;
+    auto child_id = get_path_id(child);
+    auto parent_id = get_path_id(parent);
+    if (child_id && parent_id) return paths_.inside(*child_id, *parent_id);
+    // symbols outside the index fall back to comparing their paths
+    auto child_path = get_path(child);
+    auto parent_path = get_path(parent);
+    return child_path.size() > parent_path.size() && child_path.starts_with(parent_path) &&
+           child_path[parent_path.size()] == '.';
 }
 
-class InstanceConnectedVisitor {
-public:
-    explicit InstanceConnectedVisitor(std::set<const slang::InstanceSymbol *> &instances,
-                                      const slang::ValueSymbol *target_symbol,
-                                      slang::ArgumentDirection target_dir)
-        : instances_(instances), target_symbol_(target_symbol), target_dir_(target_dir) {}
-
-    void visit(const slang::InstanceSymbol *instance) {
-        for (auto const &member : instance->body.members()) {
-            if (slang::InstanceSymbol::isKind(member.kind)) {
-                auto const *inst = &member.as<slang::InstanceSymbol>();
-                visitInstance(inst);
+PathSelection DesignDatabase::select_paths(const PathPattern &pattern) const {
+    PathSelection result;
+    std::vector<std::pair<uint64_t, PathPattern::State>> stack;
+    auto const &roots = paths_.roots();
+    for (auto it = roots.rbegin(); it != roots.rend(); it++) {
+        auto path = paths_.path(*it);
+        stack.emplace_back(*it, pattern.advance(pattern.initial(), path, 0));
+    }
+    while (!stack.empty()) {
+        auto [id, state] = std::move(stack.back());
+        stack.pop_back();
+        if (PathPattern::dead(state)) continue;
+        auto path = paths_.path(id);
+        auto const &symbols = path_symbols_[id];
+        if (pattern.accepts(state, path)) {
+            if (symbols.instance) {
+                result.instances.emplace_back(symbols.instance);
+                result.instance_contexts.emplace_back(id);
+            }
+            if (symbols.port) {
+                result.ports.emplace_back(symbols.port);
+                result.port_contexts.emplace_back(paths_.parent(id));
+            }
+            if (symbols.variable) {
+                result.variables.emplace_back(symbols.variable);
+                result.variable_contexts.emplace_back(paths_.parent(id));
             }
         }
-    }
-
-    void visitInstance(const slang::InstanceSymbol *instance) {
-        // find out if they have any connections to targeted symbol
-        auto const &port_list = instance->body.getPortList();
-        for (auto const *port : port_list) {
-            auto const &p = port->as<slang::PortSymbol>();
-            if (p.direction != target_dir_) {
-                continue;
+        // members of shared bodies don't have nodes, so they are matched in every context
+        if (instance_caching_ && symbols.instance) {
+            auto member_path = std::string(path).append(".");
+            auto match = [&](const slang::Symbol *symbol) {
+                member_path.resize(path.size() + 1);
+                member_path.append(symbol->name);
+                return pattern.accepts(pattern.advance(state, member_path, path.size() + 1),
+                                       member_path);
+            };
+            for (auto const *port : get_body_ports(symbols.instance)) {
+                if (!match(port)) continue;
+                result.ports.emplace_back(port);
+                result.port_contexts.emplace_back(id);
             }
-            // need to figure out if we need input or output
-            // need to get the port connection
-            auto const &conn = instance->getPortConnection(p);
-            auto const &expr = conn->expr;
-            std::set<const slang::ValueSymbol *> connected_symbols;
-            SymbolExprVisitor visitor(connected_symbols);
-            visitor.visitExpr(*expr);
-            if (connected_symbols.find(target_symbol_) != connected_symbols.end()) {
-                instances_.emplace(instance);
-                return;
+            for (auto const *variable : get_body_variables(symbols.instance)) {
+                if (!match(variable)) continue;
+                result.variables.emplace_back(variable);
+                result.variable_contexts.emplace_back(id);
             }
         }
+        // children are pushed in reverse to keep the hierarchy order
+        auto first = stack.size();
+        for (auto child = paths_.first_child(id); child != PathTable::none;
+             child = paths_.next_sibling(child)) {
+            stack.emplace_back(child, pattern.advance(state, paths_.path(child), path.size() + 1));
+        }
+        std::reverse(stack.begin() + static_cast<int64_t>(first), stack.end());
     }
+    return result;
+}
 
-private:
-    std::set<const slang::InstanceSymbol *> &instances_;
-    const slang::ValueSymbol *target_symbol_;
-    slang::ArgumentDirection target_dir_;
-};
+void DesignDatabase::build_connectivity() {
+    // concurrent queries wait for the graph to be complete
+    std::call_once(connectivity_built_, [this] { build_connectivity_graph(); });
+}
+
+void DesignDatabase::build_connectivity_graph() {
+    // connections are shared between the contexts of a body, so symbols don't identify
+    // instances
+    if (instance_caching_) {
+        throw std::runtime_error("Connectivity queries are not supported with instance caching");
+    }
+
+    // port connections of every instance, grouped by the parent instance
+    struct Connection {
+        const slang::InstanceSymbol *instance;
+        const slang::PortSymbol *port;
+        std::set<const slang::ValueSymbol *> symbols;
+    };
+    std::unordered_map<const slang::InstanceSymbol *, std::vector<Connection>> connections;
+    for (auto const *inst : instances_) {
+        if (hierarchy_map_.find(inst) == hierarchy_map_.end()) continue;
+        auto &conns = connections[hierarchy_map_.at(inst)];
+        for (auto const *p : inst->body.getPortList()) {
+            if (!slang::PortSymbol::isKind(p->kind)) continue;
+            auto const *port = &p->as<slang::PortSymbol>();
+            conns.emplace_back(Connection{inst, port, get_connected_symbols(inst, port)});
+        }
+    }
+
+    std::unordered_map<const slang::PortSymbol *, std::set<const slang::InstanceSymbol *>>
+        port_edges;
+    std::unordered_map<const slang::InstanceSymbol *, std::set<const slang::InstanceSymbol *>>
+        source_edges, sink_edges;
+    for (auto const &[parent, conns] : connections) {
+        // net -> instance ports it connects to. only instances declared directly in the parent
+        // body take part
+        std::unordered_map<const slang::ValueSymbol *,
+                           std::vector<std::pair<const slang::InstanceSymbol *,
+                                                 slang::ArgumentDirection>>>
+            nets;
+        for (auto const &conn : conns) {
+            if (&conn.instance->getParentScope()->asSymbol() != &parent->body) continue;
+            for (auto const *s : conn.symbols) {
+                nets[s].emplace_back(conn.instance, conn.port->direction);
+            }
+        }
 
-std::set<const slang::InstanceSymbol *> DesignDatabase::get_connected_instances(
-    const slang::InstanceSymbol *target_instance, const slang::PortSymbol *port,
-    slang::ArgumentDirection direction) {
-    std::set<const slang::InstanceSymbol *> result;
-    // if direction doesn't match
-    if (port->direction != direction) return result;
-    // this is an input port
-    auto port_symbols = get_connected_symbols(target_instance, port);
-    // notice that we need to get the instance symbols
-    for (auto const *s : port_symbols) {
-        // depends on the type of the symbol, we need to compute different things
-        // if it is a variable, then we see if it's used to connected to another
-        // instance
-        // if it's a port, then it has to be connected through outside
-        if (slang::VariableSymbol::isKind(s->kind)) {
-            // test if it's a port or not
-            if (target_instance->body.findPort(s->name)) {
-                // legal SystemVerilog only allows parent's port to be connected,
-                // if the connection is a port
-                if (hierarchy_map_.find(target_instance) == hierarchy_map_.end()) {
-                    continue;
+        for (auto const &conn : conns) {
+            auto direction = conn.port->direction;
+            auto &port_result = port_edges[conn.port];
+            if (direction == slang::ArgumentDirection::InOut) {
+                // inout ports connect to the other ports on their nets in both directions.
+                // instance level connectivity only follows inputs and outputs
+                for (auto const *s : conn.symbols) {
+                    if (nets.find(s) == nets.end()) continue;
+                    for (auto const &[inst, inst_direction] : nets.at(s)) {
+                        if (inst != conn.instance &&
+                            inst_direction != slang::ArgumentDirection::Ref) {
+                            port_result.emplace(inst);
+                        }
+                    }
                 }
-                auto const *parent = hierarchy_map_.at(target_instance);
-                if (&parent->body == &s->getParentScope()->asSymbol()) {
-                    result.emplace(parent);
+                continue;
+            }
+            if (direction != slang::ArgumentDirection::In &&
+                direction != slang::ArgumentDirection::Out) {
+                continue;
+            }
+            auto other_direction = direction == slang::ArgumentDirection::In
+                                       ? slang::ArgumentDirection::Out
+                                       : slang::ArgumentDirection::In;
+            auto &instance_result = direction == slang::ArgumentDirection::In
+                                        ? source_edges[conn.instance]
+                                        : sink_edges[conn.instance];
+            for (auto const *s : conn.symbols) {
+                // instance level connectivity only follows variables. legal SystemVerilog only
+                // allows parent's port to be connected, if the connection is a port
+                auto is_variable = slang::VariableSymbol::isKind(s->kind);
+                auto is_port = is_variable && conn.instance->body.findPort(s->name);
+                if (is_port && &parent->body == &s->getParentScope()->asSymbol()) {
+                    instance_result.emplace(parent);
                 }
-            } else {
-                auto const &var = s->as<slang::VariableSymbol>();
-                // need to find if it's connected to any instances
-                // we use a visitor to find that connection
-                // before doing that we need to find parent instance
-                if (hierarchy_map_.find(target_instance) == hierarchy_map_.end()) {
-                    continue;
+                if (nets.find(s) == nets.end()) continue;
+                for (auto const &[inst, inst_direction] : nets.at(s)) {
+                    if (inst_direction != other_direction) continue;
+                    port_result.emplace(inst);
+                    if (is_variable && !is_port) instance_result.emplace(inst);
                 }
-                auto const *parent_instance = hierarchy_map_.at(target_instance);
-                InstanceConnectedVisitor visitor(result, &var,
-                                                 direction == slang::ArgumentDirection::In
-                                                     ? slang::ArgumentDirection::Out
-                                                     : slang::ArgumentDirection::In);
-                visitor.visit(parent_instance);
             }
         }
     }
 
-    return result;
+    // flatten into CSR. rows are in hierarchy order so that query results are deterministic
+    static const std::set<const slang::InstanceSymbol *> empty;
+    auto find_edges = [](const auto &edges, const auto *key) -> const auto & {
+        auto it = edges.find(key);
+        return it == edges.end() ? empty : it->second;
+    };
+    for (uint64_t i = 0; i < instances_.size(); i++) instance_index_.emplace(instances_[i], i);
+    auto hierarchy_order = [this](const slang::InstanceSymbol *inst) {
+        return instance_index_.at(inst);
+    };
+    for (auto const *inst : instances_) {
+        source_graph_.add_row(find_edges(source_edges, inst), hierarchy_order);
+        sink_graph_.add_row(find_edges(sink_edges, inst), hierarchy_order);
+    }
+    for (uint64_t i = 0; i < ports_.size(); i++) {
+        auto const *port = ports_[i];
+        port_index_.emplace(port, i);
+        port_graph_.add_row(find_edges(port_edges, port), hierarchy_order);
+    }
+}
+
+std::span<const slang::InstanceSymbol *const> DesignDatabase::get_connected_instances(
+    const slang::PortSymbol *port) {
+    build_connectivity();
+    if (port_index_.find(port) == port_index_.end()) return {};
+    return port_graph_.row(port_index_.at(port));
 }
 
 std::set<const slang::InstanceSymbol *> DesignDatabase::get_source_instances(
     const slang::InstanceSymbol *instance) {
     // given the instance, we find the source instances that connect to the target instance
-    std::set<const slang::InstanceSymbol *> result;
-    auto const &ports = instance->body.getPortList();
-    for (auto const &port_s : ports) {
-        if (slang::PortSymbol::isKind(port_s->kind)) {
-            auto const &p = port_s->as<slang::PortSymbol>();
-            auto instances = get_connected_instances(instance, &p, slang::ArgumentDirection::In);
-            for (auto const *inst : instances) {
-                result.emplace(inst);
+    build_connectivity();
+    if (instance_index_.find(instance) == instance_index_.end()) return {};
+    auto row = source_graph_.row(instance_index_.at(instance));
+    return {row.begin(), row.end()};
+}
+
+std::set<const slang::InstanceSymbol *> DesignDatabase::get_source_instances(
+    const slang::PortSymbol *port) {
+    if (port->direction != slang::ArgumentDirection::In) return {};
+    auto row = get_connected_instances(port);
+    return {row.begin(), row.end()};
+}
+
+std::set<const slang::InstanceSymbol *> DesignDatabase::get_sink_instances(
+    const slang::InstanceSymbol *instance) {
+    // given the instance, we find the sink instances that the target instance connects to
+    build_connectivity();
+    if (instance_index_.find(instance) == instance_index_.end()) return {};
+    auto row = sink_graph_.row(instance_index_.at(instance));
+    return {row.begin(), row.end()};
+}
+
+std::set<const slang::InstanceSymbol *> DesignDatabase::get_sink_instances(
+    const slang::PortSymbol *port) {
+    if (port->direction != slang::ArgumentDirection::Out) return {};
+    auto row = get_connected_instances(port);
+    return {row.begin(), row.end()};
+}
+
+std::vector<const slang::InstanceSymbol *> DesignDatabase::get_fanin(
+    const std::vector<const slang::Symbol *> &targets, uint64_t depth, uint64_t num_threads) {
+    return get_cone(targets, true, depth, num_threads);
+}
+
+std::vector<const slang::InstanceSymbol *> DesignDatabase::get_fanout(
+    const std::vector<const slang::Symbol *> &targets, uint64_t depth, uint64_t num_threads) {
+    return get_cone(targets, false, depth, num_threads);
+}
+
+std::vector<const slang::InstanceSymbol *> DesignDatabase::get_cone(
+    const std::vector<const slang::Symbol *> &targets, bool fanin, uint64_t depth,
+    uint64_t num_threads) {
+    // small frontiers are not worth the synchronization
+    static constexpr uint64_t parallel_frontier_size = 1024;
+
+    build_connectivity();
+    auto const &graph = fanin ? source_graph_ : sink_graph_;
+    auto direction = fanin ? slang::ArgumentDirection::In : slang::ArgumentDirection::Out;
+
+    std::vector<bool> visited(instances_.size(), false);
+    std::vector<uint64_t> frontier;
+    // the first hop of a port comes from the port connections instead of the graph
+    std::vector<const slang::InstanceSymbol *> port_hop;
+    for (auto const *target : targets) {
+        if (!target) continue;
+        if (slang::InstanceSymbol::isKind(target->kind)) {
+            auto const *inst = &target->as<slang::InstanceSymbol>();
+            if (instance_index_.find(inst) == instance_index_.end()) continue;
+            auto index = instance_index_.at(inst);
+            if (!visited[index]) frontier.emplace_back(index);
+            visited[index] = true;
+        } else if (slang::PortSymbol::isKind(target->kind)) {
+            auto const *port = &target->as<slang::PortSymbol>();
+            if (port->direction != direction) continue;
+            auto row = get_connected_instances(port);
+            port_hop.insert(port_hop.end(), row.begin(), row.end());
+        }
+    }
+
+    std::shared_ptr<util::ThreadPool> pool;
+    if (num_threads != 1) pool = get_pool(num_threads);
+
+    std::vector<const slang::InstanceSymbol *> result;
+    std::vector<std::vector<const slang::InstanceSymbol *>> candidates;
+    for (uint64_t hop = 0; hop < depth && (!frontier.empty() || !port_hop.empty()); hop++) {
+        // neighbors of every frontier node are collected independently, then merged in frontier
+        // order so the result doesn't depend on the thread count
+        candidates.assign(frontier.size(), {});
+        auto expand = [&](uint64_t i) {
+            for (auto const *inst : graph.row(frontier[i])) {
+                if (!visited[instance_index_.at(inst)]) candidates[i].emplace_back(inst);
+            }
+        };
+        if (pool && frontier.size() >= parallel_frontier_size) {
+            util::parallel_for(*pool, frontier.size(), expand);
+        } else {
+            for (uint64_t i = 0; i < frontier.size(); i++) expand(i);
+        }
+        if (hop == 0) candidates.emplace_back(std::move(port_hop));
+
+        frontier.clear();
+        for (auto const &insts : candidates) {
+            for (auto const *inst : insts) {
+                auto index = instance_index_.at(inst);
+                if (visited[index]) continue;
+                visited[index] = true;
+                frontier.emplace_back(index);
+                result.emplace_back(inst);
             }
         }
+        port_hop.clear();
     }
 
     return result;
 }
 
-std::set<const slang::InstanceSymbol *> DesignDatabase::get_connected_instances(
-    const slang::PortSymbol *port) {
-    auto const &instance_body = port->getParentScope()->asSymbol().as<slang::InstanceBodySymbol>();
-    std::set<const slang::InstanceSymbol *> result;
-    auto parents = compilation_.getParentInstances(instance_body);
-    if (parents.empty()) return {};
-    auto const *instance = parents.back();
-    if (hierarchy_map_.find(instance) == hierarchy_map_.end()) return {};
-    auto const *parent_instance = hierarchy_map_.at(instance);
-    auto const &connections = instance->getPortConnection(*port);
-    std::set<const slang::ValueSymbol *> symbols;
-    SymbolExprVisitor visitor(symbols);
-    visitor.visitExpr(*connections->expr);
-    for (auto const *sym : symbols) {
-        InstanceConnectedVisitor v(result, sym,
-                                   port->direction == slang::ArgumentDirection::In
-                                       ? slang::ArgumentDirection::Out
-                                       : slang::ArgumentDirection::In);
-        v.visit(parent_instance);
+std::shared_ptr<util::ThreadPool> DesignDatabase::get_pool(uint64_t num_threads) {
+    std::lock_guard lock(pool_mutex_);
+    if (!pool_ || pool_->size() != util::get_num_threads(num_threads)) {
+        pool_ = std::make_shared<util::ThreadPool>(num_threads);
     }
-    return result;
+    return pool_;
 }
 
-std::set<const slang::InstanceSymbol *> DesignDatabase::get_source_instances(
-    const slang::PortSymbol *port) {
-    if (port->direction != slang::ArgumentDirection::In)
-        return {};
-    else
-        return get_connected_instances(port);
+PortDirection to_port_direction(slang::ArgumentDirection direction) {
+    switch (direction) {
+        case slang::ArgumentDirection::In:
+            return PortDirection::In;
+        case slang::ArgumentDirection::Out:
+            return PortDirection::Out;
+        case slang::ArgumentDirection::InOut:
+            return PortDirection::InOut;
+        case slang::ArgumentDirection::Ref:
+            return PortDirection::Ref;
+    }
+    throw std::runtime_error("Unknown port direction");
 }
 
-std::set<const slang::InstanceSymbol *> DesignDatabase::get_sink_instances(
-    const slang::InstanceSymbol *instance) {
-    // given the instance, we find the source instances that connect to the target instance
-    std::set<const slang::InstanceSymbol *> result;
-    auto const &ports = instance->body.getPortList();
-    for (auto const &port_s : ports) {
-        if (slang::PortSymbol::isKind(port_s->kind)) {
-            auto const &p = port_s->as<slang::PortSymbol>();
-            auto instances = get_connected_instances(instance, &p, slang::ArgumentDirection::Out);
-            for (auto const *inst : instances) {
-                result.emplace(inst);
+bool is_net_or_variable(const slang::Symbol &symbol) {
+    return slang::VariableSymbol::isKind(symbol.kind) || slang::NetSymbol::isKind(symbol.kind);
+}
+
+// variables and nets read by an expression
+class ValueReadVisitor : public slang::ASTVisitor<ValueReadVisitor, false, true> {
+public:
+    explicit ValueReadVisitor(std::vector<const slang::ValueSymbol *> &symbols)
+        : symbols_(symbols) {}
+
+    [[maybe_unused]] void handle(const slang::NamedValueExpression &expr) {
+        if (is_net_or_variable(expr.symbol)) symbols_.emplace_back(&expr.symbol);
+    }
+
+private:
+    std::vector<const slang::ValueSymbol *> &symbols_;
+};
+
+// assignments of an instance body, excluding its child instances
+class DriverVisitor : public slang::ASTVisitor<DriverVisitor, true, true> {
+public:
+    using DriverMap =
+        std::unordered_map<const slang::ValueSymbol *, std::set<const slang::ValueSymbol *>>;
+    DriverVisitor(DriverMap &drivers, DriverMap &loads) : drivers_(drivers), loads_(loads) {}
+
+    [[maybe_unused]] void handle(const slang::InstanceSymbol &) {}
+
+    [[maybe_unused]] void handle(const slang::ContinuousAssignSymbol &assign) {
+        auto const &expr = assign.getAssignment();
+        if (expr.kind == slang::ExpressionKind::Assignment) {
+            handle(expr.as<slang::AssignmentExpression>());
+        }
+    }
+
+    [[maybe_unused]] void handle(const slang::AssignmentExpression &expr) {
+        targets_.clear();
+        sources_.clear();
+        ValueReadVisitor reads(sources_);
+        add_targets(expr.left(), reads);
+        if (expr.isCompound()) expr.left().visit(reads);
+        expr.right().visit(reads);
+        add_edges();
+    }
+
+    // declarations with an initializer, e.g. wire w = a & b or logic x = y. the initializer of
+    // a net is a continuous assignment, the one of a variable its initial value
+    [[maybe_unused]] void handle(const slang::NetSymbol &symbol) { handle_initializer(symbol); }
+    [[maybe_unused]] void handle(const slang::VariableSymbol &symbol) {
+        handle_initializer(symbol);
+    }
+
+private:
+    DriverMap &drivers_;
+    DriverMap &loads_;
+    std::vector<const slang::ValueSymbol *> targets_;
+    std::vector<const slang::ValueSymbol *> sources_;
+
+    template <typename T>
+    void handle_initializer(const T &symbol) {
+        if (auto const *init = symbol.getInitializer()) {
+            targets_.assign(1, &symbol);
+            sources_.clear();
+            ValueReadVisitor reads(sources_);
+            init->visit(reads);
+            add_edges();
+        }
+        visitDefault(symbol);
+    }
+
+    void add_edges() {
+        for (auto const *target : targets_) {
+            auto &drivers = drivers_[target];
+            for (auto const *source : sources_) {
+                drivers.emplace(source);
+                loads_[source].emplace(target);
             }
         }
     }
 
-    return result;
+    // selects and member accesses assign to their base value. their indices are read
+    void add_targets(const slang::Expression &expr, ValueReadVisitor &reads) {
+        switch (expr.kind) {
+            case slang::ExpressionKind::NamedValue: {
+                auto const &symbol = expr.as<slang::NamedValueExpression>().symbol;
+                if (is_net_or_variable(symbol)) targets_.emplace_back(&symbol);
+                break;
+            }
+            case slang::ExpressionKind::ElementSelect: {
+                auto const &select = expr.as<slang::ElementSelectExpression>();
+                add_targets(select.value(), reads);
+                select.selector().visit(reads);
+                break;
+            }
+            case slang::ExpressionKind::RangeSelect: {
+                auto const &select = expr.as<slang::RangeSelectExpression>();
+                add_targets(select.value(), reads);
+                select.left().visit(reads);
+                select.right().visit(reads);
+                break;
+            }
+            case slang::ExpressionKind::MemberAccess:
+                add_targets(expr.as<slang::MemberAccessExpression>().value(), reads);
+                break;
+            case slang::ExpressionKind::Concatenation:
+                for (auto const *operand : expr.as<slang::ConcatenationExpression>().operands()) {
+                    add_targets(*operand, reads);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+void DesignDatabase::build_drivers() {
+    // concurrent queries wait for the graph to be complete
+    std::call_once(drivers_built_, [this] { build_driver_graph(); });
 }
 
-std::set<const slang::InstanceSymbol *> DesignDatabase::get_sink_instances(
-    const slang::PortSymbol *port) {
-    if (port->direction != slang::ArgumentDirection::Out)
-        return {};
-    else
-        return get_connected_instances(port);
+void DesignDatabase::build_driver_graph() {
+    util::Stopwatch watch;
+
+    // shared bodies are only visited once. slang binds statements lazily, so this stays on one
+    // thread
+    DriverVisitor::DriverMap drivers, loads;
+    DriverVisitor visitor(drivers, loads);
+    for (auto const *inst : instances_) {
+        if (body_map_.at(&inst->body) != inst) continue;
+        inst->body.visit(visitor);
+    }
+
+    // every value that is assigned or read gets a row in both graphs. variables come in
+    // hierarchy order, the other values such as nets follow sorted by path so that the rows
+    // don't depend on symbol addresses
+    std::vector<const slang::ValueSymbol *> values;
+    std::unordered_set<const slang::ValueSymbol *> indexed;
+    for (auto const *var : variables_) {
+        if (indexed.emplace(var).second) values.emplace_back(var);
+    }
+    std::vector<std::pair<std::string, const slang::ValueSymbol *>> others;
+    for (auto const *map : {&drivers, &loads}) {
+        for (auto const &[value, edges] : *map) {
+            if (indexed.emplace(value).second) others.emplace_back(get_symbol_path(value), value);
+        }
+    }
+    std::sort(others.begin(), others.end());
+    for (auto const &[path, value] : others) values.emplace_back(value);
+
+    std::unordered_map<const slang::ValueSymbol *, uint64_t> value_index;
+    for (auto const *value : values) value_index.emplace(value, value_index.size());
+    auto index_order = [&value_index](const slang::ValueSymbol *value) {
+        return value_index.at(value);
+    };
+    static const std::set<const slang::ValueSymbol *> empty;
+    ValueGraph driver_graph, load_graph;
+    for (auto const *value : values) {
+        auto driver = drivers.find(value);
+        driver_graph.add_row(driver == drivers.end() ? empty : driver->second, index_order);
+        auto load = loads.find(value);
+        load_graph.add_row(load == loads.end() ? empty : load->second, index_order);
+    }
+    value_index_ = std::move(value_index);
+    driver_graph_ = std::move(driver_graph);
+    load_graph_ = std::move(load_graph);
+    timings_["drivers"] = watch.lap();
+}
+
+// ports don't take part in expressions, their internal symbols do
+const slang::ValueSymbol *get_value_symbol(const slang::Symbol *symbol) {
+    if (slang::PortSymbol::isKind(symbol->kind)) {
+        auto const *internal = symbol->as<slang::PortSymbol>().internalSymbol;
+        if (!internal || !slang::ValueSymbol::isKind(internal->kind)) return nullptr;
+        return &internal->as<slang::ValueSymbol>();
+    }
+    if (!slang::ValueSymbol::isKind(symbol->kind)) return nullptr;
+    return &symbol->as<slang::ValueSymbol>();
+}
+
+std::span<const slang::ValueSymbol *const> DesignDatabase::get_drivers(
+    const slang::Symbol *value) {
+    build_drivers();
+    auto it = value_index_.find(get_value_symbol(value));
+    if (it == value_index_.end()) return {};
+    return driver_graph_.row(it->second);
+}
+
+std::span<const slang::ValueSymbol *const> DesignDatabase::get_loads(const slang::Symbol *value) {
+    build_drivers();
+    auto it = value_index_.find(get_value_symbol(value));
+    if (it == value_index_.end()) return {};
+    return load_graph_.row(it->second);
+}
+
+bool DesignDatabase::save_snapshot(const std::string &filename, uint64_t key) {
+    if (instance_caching_) return false;
+    build_connectivity();
+
+    SnapshotData data;
+    auto index_of = [this](const slang::InstanceSymbol *inst) {
+        if (!inst) return SnapshotData::no_parent;
+        auto it = instance_index_.find(inst);
+        return it == instance_index_.end() ? SnapshotData::no_parent : it->second;
+    };
+    data.instances.reserve(instances_.size());
+    for (auto const *inst : instances_) {
+        auto it = hierarchy_map_.find(inst);
+        auto parent = it == hierarchy_map_.end() ? SnapshotData::no_parent : index_of(it->second);
+        data.instances.emplace_back(SnapshotData::Instance{
+            get_path(inst), std::string(inst->name), std::string(inst->body.name), parent});
+    }
+    // ports and variables are always declared directly in an instance body
+    data.ports.reserve(ports_.size());
+    for (auto const *port : ports_) {
+        auto instance = index_of(get_parent_instance(port));
+        if (instance == SnapshotData::no_parent) return false;
+        data.ports.emplace_back(SnapshotData::Port{get_path(port), std::string(port->name),
+                                                   instance, to_port_direction(port->direction)});
+    }
+    data.variables.reserve(variables_.size());
+    for (auto const *var : variables_) {
+        auto instance = index_of(get_parent_instance(var));
+        if (instance == SnapshotData::no_parent) return false;
+        data.variables.emplace_back(
+            SnapshotData::Variable{get_path(var), std::string(var->name), instance});
+    }
+
+    auto to_rows = [&index_of](const ConnectivityGraph &graph,
+                               std::vector<std::vector<uint64_t>> &rows) {
+        rows.resize(graph.size());
+        for (uint64_t i = 0; i < graph.size(); i++) {
+            for (auto const *inst : graph.row(i)) rows[i].emplace_back(index_of(inst));
+        }
+    };
+    to_rows(source_graph_, data.sources);
+    to_rows(sink_graph_, data.sinks);
+    to_rows(port_graph_, data.port_connections);
+
+    return DesignSnapshot::save(data, filename, key);
 }
 
 const slang::InstanceSymbol *DesignDatabase::get_parent_instance(const slang::Symbol *symbol) {
@@ -319,31 +747,67 @@ const slang::PortSymbol *DesignDatabase::get_port(const slang::Symbol *variable)
 
 class InstanceValueVisitor : public slang::ASTVisitor<InstanceValueVisitor, false, false> {
 public:
-    InstanceValueVisitor(slang::Compilation &compilation,
+    InstanceValueVisitor(bool instance_caching,
                          std::unordered_map<std::string, const slang::InstanceSymbol *> &instances,
                          std::unordered_map<const slang::InstanceSymbol *,
-                                            const slang::InstanceSymbol *> &hierarchy_map)
-        : compilation_(compilation), instances_(instances), hierarchy_map_(hierarchy_map) {}
+                                            const slang::InstanceSymbol *> &hierarchy_map,
+                         std::vector<const slang::InstanceSymbol *> &order,
+                         std::vector<std::string> &paths, std::vector<uint64_t> &parents)
+        : instance_caching_(instance_caching),
+          instances_(instances),
+          hierarchy_map_(hierarchy_map),
+          order_(order),
+          paths_(paths),
+          parents_(parents) {}
 
     [[maybe_unused]] void handle(const slang::InstanceSymbol &instance) {
-        std::string instance_name;
-        instance.getHierarchicalPath(instance_name);
-        instances_.emplace(instance_name, &instance);
+        auto parent = stack_.empty() ? PathTable::none : stack_.top().second;
+        auto instance_name = get_path(instance, parent);
+        auto index = parent;
+        if (instances_.emplace(instance_name, &instance).second) {
+            index = order_.size();
+            order_.emplace_back(&instance);
+            paths_.emplace_back(std::move(instance_name));
+            parents_.emplace_back(parent);
+        }
+        // slang elaborates lazily and is not thread-safe. make sure the port list exists before
+        // the bodies are read from multiple threads
+        (void)instance.body.getPortList();
         if (!stack_.empty()) {
-            hierarchy_map_.emplace(&instance, stack_.top());
+            hierarchy_map_.emplace(&instance, stack_.top().first);
         }
-        stack_.emplace(&instance);
+        stack_.emplace(&instance, index);
         visitDefault(instance);
         stack_.pop();
     }
 
 private:
-    slang::Compilation &compilation_;
+    bool instance_caching_;
     std::unordered_map<std::string, const slang::InstanceSymbol *> &instances_;
     std::unordered_map<const slang::InstanceSymbol *, const slang::InstanceSymbol *>
         &hierarchy_map_;
-
-    std::stack<const slang::InstanceSymbol *> stack_;
+    std::vector<const slang::InstanceSymbol *> &order_;
+    std::vector<std::string> &paths_;
+    std::vector<uint64_t> &parents_;
+
+    // instance and the index of its context
+    std::stack<std::pair<const slang::InstanceSymbol *, uint64_t>> stack_;
+    // length of the slang path of the instance a body was created for
+    std::unordered_map<const slang::InstanceBodySymbol *, uint64_t> prefix_sizes_;
+
+    std::string get_path(const slang::InstanceSymbol &instance, uint64_t parent) {
+        auto path = DesignDatabase::get_symbol_path(&instance);
+        if (!instance_caching_ || parent == PathTable::none) return path;
+        // a shared body only has the path of the instance it was created for, so the part
+        // below the body is moved to the path of the current context
+        auto const &body = stack_.top().first->body;
+        auto it = prefix_sizes_.find(&body);
+        if (it == prefix_sizes_.end()) {
+            auto const *owner = body.parentInstance ? body.parentInstance : stack_.top().first;
+            it = prefix_sizes_.emplace(&body, DesignDatabase::get_symbol_path(owner).size()).first;
+        }
+        return paths_[parent] + path.substr(it->second);
+    }
 };
 
 class VariableVisitor {
@@ -369,37 +833,126 @@ private:
     std::vector<const slang::VariableSymbol *> &symbols_;
 };
 
-void DesignDatabase::index_values() {
-    // InstanceVisitor visitor(instances_map_, hierarchy_map_);
-    // visitor.visit(compilation_.getRoot());
-    InstanceValueVisitor visitor(compilation_, instances_map_, hierarchy_map_);
+void DesignDatabase::index_values(uint64_t num_threads) {
+    util::Stopwatch watch;
+    // instances are kept in hierarchy pre-order so that the result doesn't depend on hashing
+    // or the number of threads
+    std::vector<std::string> instance_paths;
+    std::vector<uint64_t> instance_parents;
+    InstanceValueVisitor visitor(instance_caching_, instances_map_, hierarchy_map_, instances_,
+                                 instance_paths, instance_parents);
     visitor.visit(compilation_.getRoot());
+    timings_["hierarchy"] = watch.lap();
+
+    // without instance caching every instance has its own body
+    std::vector<const slang::InstanceSymbol *> bodies;
+    body_map_.reserve(instances_.size());
+    for (auto const *inst : instances_) {
+        if (body_map_.emplace(&inst->body, inst).second) {
+            body_index_.emplace(&inst->body, bodies.size());
+            bodies.emplace_back(inst);
+        }
+    }
+
+    // ports and variables are collected per shard of consecutive bodies, i.e. subtrees of the
+    // hierarchy, then concatenated in shard order
+    num_threads = util::get_num_threads(num_threads);
+    auto num_shards = num_threads == 1 ? 1 : std::min<uint64_t>(bodies.size(), num_threads * 4);
+    std::vector<std::vector<const slang::PortSymbol *>> shard_ports(num_shards);
+    std::vector<std::vector<const slang::VariableSymbol *>> shard_variables(num_shards);
+    std::vector<uint64_t> num_body_ports(bodies.size()), num_body_variables(bodies.size());
+    // paths are built here as well since walking the hierarchy is the expensive part. shared
+    // bodies are resolved per context on demand instead
+    struct MemberPath {
+        const slang::Symbol *symbol;
+        const slang::InstanceSymbol *instance;
+        std::string path;
+    };
+    std::vector<std::vector<MemberPath>> shard_paths(num_shards);
+    auto shard_size = num_shards ? (bodies.size() + num_shards - 1) / num_shards : 0;
+    auto index_shard = [&](uint64_t shard) {
+        auto end = std::min<uint64_t>((shard + 1) * shard_size, bodies.size());
+        auto &ports = shard_ports[shard];
+        auto &variables = shard_variables[shard];
+        for (auto i = shard * shard_size; i < end; i++) {
+            auto const *inst = bodies[i];
+            auto num_ports = ports.size();
+            auto num_variables = variables.size();
+            for (auto const &p : inst->body.getPortList()) {
+                ports.emplace_back(&(p->as<slang::PortSymbol>()));
+            }
+            // variables as well, using a visitor
+            VariableVisitor v(variables);
+            v.visitInst(inst);
+            num_body_ports[i] = ports.size() - num_ports;
+            num_body_variables[i] = variables.size() - num_variables;
+
+            if (instance_caching_) continue;
+            for (auto j = num_ports; j < ports.size(); j++) {
+                shard_paths[shard].emplace_back(
+                    MemberPath{ports[j], inst, get_symbol_path(ports[j])});
+            }
+            for (auto j = num_variables; j < variables.size(); j++) {
+                shard_paths[shard].emplace_back(
+                    MemberPath{variables[j], inst, get_symbol_path(variables[j])});
+            }
+        }
+    };
+    if (num_shards > 1) {
+        util::ThreadPool pool(num_threads);
+        util::parallel_for(pool, num_shards, index_shard);
+    } else if (num_shards == 1) {
+        index_shard(0);
+    }
+    for (uint64_t i = 0; i < num_shards; i++) {
+        ports_.insert(ports_.end(), shard_ports[i].begin(), shard_ports[i].end());
+        variables_.insert(variables_.end(), shard_variables[i].begin(), shard_variables[i].end());
+    }
+    body_port_offsets_.reserve(bodies.size() + 1);
+    body_variable_offsets_.reserve(bodies.size() + 1);
+    for (uint64_t i = 0; i < bodies.size(); i++) {
+        body_port_offsets_.emplace_back(body_port_offsets_.back() + num_body_ports[i]);
+        body_variable_offsets_.emplace_back(body_variable_offsets_.back() +
+                                            num_body_variables[i]);
+    }
 
-    instances_.reserve(instances_map_.size());
-    for (auto const &[inst_name, inst] : instances_map_) {
-        auto const &port_list = inst->body.getPortList();
-        for (auto const &p : port_list) {
-            ports_.emplace_back(&(p->as<slang::PortSymbol>()));
+    // instances are interned first since they are the parents of everything else. a port and
+    // its internal variable share the same node
+    path_ids_.reserve(instances_.size() + ports_.size() + variables_.size());
+    instance_contexts_.reserve(instances_.size());
+    for (uint64_t i = 0; i < instances_.size(); i++) {
+        auto const *inst = instances_[i];
+        auto parent = instance_parents[i];
+        auto id = paths_.add(instance_paths[i],
+                             parent == PathTable::none ? parent : instance_contexts_[parent]);
+        instance_contexts_.emplace_back(id);
+        // shared instances keep their first context
+        path_ids_.emplace(inst, id);
+        path_symbols_.resize(paths_.size());
+        path_symbols_[id].instance = inst;
+    }
+    for (auto const &member_paths : shard_paths) {
+        for (auto const &[symbol, instance, path] : member_paths) {
+            auto id = paths_.add(path, path_ids_.at(instance));
+            path_ids_.emplace(symbol, id);
+            path_symbols_.resize(paths_.size());
+            if (slang::PortSymbol::isKind(symbol->kind)) {
+                path_symbols_[id].port = &symbol->as<slang::PortSymbol>();
+            } else {
+                path_symbols_[id].variable = &symbol->as<slang::VariableSymbol>();
+            }
         }
-        // variables as well, using a visitor
-        VariableVisitor v(variables_);
-        v.visitInst(inst);
-        instances_.emplace_back(inst);
     }
+    paths_.finalize();
+    timings_["index"] = watch.lap();
 }
 
 const slang::InstanceSymbol *DesignDatabase::get_instance_from_scope(const slang::Scope *scope) {
-    // if performance becomes an issue, turn this into a lookup table
     if (!scope) return nullptr;
     auto const &symbol = scope->asSymbol();
-    if (slang::InstanceBodySymbol::isKind(symbol.kind)) {
-        for (auto const &instance : instances_map_) {
-            if (&instance.second->body == &symbol) {
-                return instance.second;
-            }
-        }
-    }
-    return nullptr;
+    if (!slang::InstanceBodySymbol::isKind(symbol.kind)) return nullptr;
+    auto it = body_map_.find(&symbol);
+    return it != body_map_.end() ? it->second : nullptr;
 }
 
 }  // namespace hgdb::rtl
\ No newline at end of file
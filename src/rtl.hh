@@ -1,17 +1,71 @@
 #ifndef HGDB_RTL_RTL_HH
 #define HGDB_RTL_RTL_HH
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <span>
 #include <unordered_map>
 
+#include "path.hh"
 #include "slang/compilation/Compilation.h"
 #include "slang/symbols/PortSymbols.h"
+#include "util.hh"
 
 namespace hgdb::rtl {
 
+// adjacency lists of symbols in CSR form, one row per node
+template <typename T>
+class SymbolGraph {
+public:
+    void add_row(const std::set<const T *> &symbols) {
+        edges_.insert(edges_.end(), symbols.begin(), symbols.end());
+        offsets_.emplace_back(edges_.size());
+    }
+    // the row is ordered by key(symbol) instead of the pointer order of the set
+    template <typename Key>
+    void add_row(const std::set<const T *> &symbols, const Key &key) {
+        auto begin = edges_.size();
+        add_row(symbols);
+        std::sort(edges_.begin() + static_cast<int64_t>(begin), edges_.end(),
+                  [&key](const T *a, const T *b) { return key(a) < key(b); });
+    }
+    [[nodiscard]] std::span<const T *const> row(uint64_t index) const {
+        return {edges_.data() + offsets_[index], edges_.data() + offsets_[index + 1]};
+    }
+    [[nodiscard]] uint64_t size() const { return offsets_.size() - 1; }
+
+private:
+    std::vector<uint64_t> offsets_ = {0};
+    std::vector<const T *> edges_;
+};
+
+using ConnectivityGraph = SymbolGraph<slang::InstanceSymbol>;
+using ValueGraph = SymbolGraph<slang::ValueSymbol>;
+
+// symbols selected by a path pattern, in hierarchy order. the contexts are the path nodes of
+// the instances, or of the instance the port or variable is declared in
+struct PathSelection {
+    std::vector<const slang::InstanceSymbol *> instances;
+    std::vector<const slang::PortSymbol *> ports;
+    std::vector<const slang::VariableSymbol *> variables;
+    std::vector<uint64_t> instance_contexts;
+    std::vector<uint64_t> port_contexts;
+    std::vector<uint64_t> variable_contexts;
+};
+
 class DesignDatabase {
 public:
-    explicit DesignDatabase(slang::Compilation &compilation);
+    // more than 1 thread shards the port and variable collection. 0 means using all hardware
+    // threads. instance_caching has to match the compilation option. slang then shares the body
+    // of instances with the same definition and parameters, including every symbol below it.
+    // instances are indexed per hierarchical context, see instance_contexts(), while ports and
+    // variables are collected once per body and resolved per context on demand. connectivity
+    // queries and snapshots need a compilation without instance caching
+    explicit DesignDatabase(slang::Compilation &compilation, uint64_t num_threads = 1,
+                            bool instance_caching = false);
     const slang::Symbol *select(const std::string &path);
     const slang::InstanceSymbol *get_instance(const std::string &path);
     static std::set<const slang::ValueSymbol *> get_connected_symbols(
@@ -21,8 +75,19 @@ public:
     std::set<const slang::ValueSymbol *> get_connected_symbols(const std::string &path,
                                                                const std::string &port_name);
     static std::string get_instance_definition_name(const slang::InstanceSymbol *symbol);
+    // builds the path through slang. see get_path() for indexed symbols
     static std::string get_symbol_path(const slang::Symbol *symbol);
-    static bool symbol_inside(const slang::Symbol *child, const slang::InstanceSymbol *parent);
+    [[nodiscard]] std::string get_path(const slang::Symbol *symbol) const;
+    // path of an instance in its context, or of a port or variable in the context of the
+    // instance it is declared in
+    [[nodiscard]] std::string get_path(const slang::Symbol *symbol, uint64_t context) const;
+    // node of an indexed instance, port or variable in paths()
+    [[nodiscard]] std::optional<uint64_t> get_path_id(const slang::Symbol *symbol) const;
+    [[nodiscard]] const PathTable &paths() const { return paths_; }
+    [[nodiscard]] bool symbol_inside(const slang::Symbol *child,
+                                     const slang::InstanceSymbol *parent) const;
+    // walks the path table, skipping subtrees that can't match the pattern
+    [[nodiscard]] PathSelection select_paths(const PathPattern &pattern) const;
     std::set<const slang::InstanceSymbol *> get_source_instances(
         const slang::InstanceSymbol *instance);
     std::set<const slang::InstanceSymbol *> get_source_instances(const slang::PortSymbol *port);
@@ -32,25 +97,112 @@ public:
     const slang::InstanceSymbol *get_parent_instance(const slang::Symbol *symbol);
     static const slang::PortSymbol *get_port(const slang::Symbol *variable);
 
+    // driver/load edges between instance ports through the nets of their parent scope. built on
+    // the first source/sink query, after which these are plain array reads. safe to call from
+    // several threads, a build that throws is retried by the next query
+    void build_connectivity();
+    // instances on the other side of the port's connections, in hierarchy order. these are the
+    // sources of an input port, the sinks of an output port and both for an inout port
+    std::span<const slang::InstanceSymbol *const> get_connected_instances(
+        const slang::PortSymbol *port);
+
+    // instances within depth hops of the targets, following source (fanin) or sink (fanout)
+    // edges, in BFS order. targets are instances or ports; a port only starts from its own
+    // connections when its direction matches. frontiers are expanded in parallel when
+    // num_threads is not 1
+    std::vector<const slang::InstanceSymbol *> get_fanin(
+        const std::vector<const slang::Symbol *> &targets, uint64_t depth,
+        uint64_t num_threads = 1);
+    std::vector<const slang::InstanceSymbol *> get_fanout(
+        const std::vector<const slang::Symbol *> &targets, uint64_t depth,
+        uint64_t num_threads = 1);
+
+    // data dependencies between variables and nets through continuous assignments and
+    // procedural blocks. drivers are the values read by the assignments to a value, loads the
+    // values assigned from it. ports stand for their internal symbol. port connections and
+    // control dependencies are not included, see get_connected_instances() for the former.
+    // built on the first query. rows are in hierarchy order. safe to call from several threads,
+    // a build that throws is retried by the next query
+    void build_drivers();
+    std::span<const slang::ValueSymbol *const> get_drivers(const slang::Symbol *value);
+    std::span<const slang::ValueSymbol *const> get_loads(const slang::Symbol *value);
+
+    // ports and variables are listed once per instance body
     const std::vector<const slang::VariableSymbol *> &variables() const { return variables_; }
     const std::vector<const slang::InstanceSymbol *> &instances() const { return instances_; }
     const std::vector<const slang::PortSymbol *> &ports() const { return ports_; }
 
+    [[nodiscard]] bool instance_caching() const { return instance_caching_; }
+    // path node of every entry in instances(). a shared instance has one entry per context
+    [[nodiscard]] const std::vector<uint64_t> &instance_contexts() const {
+        return instance_contexts_;
+    }
+    [[nodiscard]] const slang::InstanceSymbol *get_context_instance(uint64_t context) const;
+    std::span<const slang::PortSymbol *const> get_body_ports(
+        const slang::InstanceSymbol *instance) const;
+    std::span<const slang::VariableSymbol *const> get_body_variables(
+        const slang::InstanceSymbol *instance) const;
+
+    // phase name -> wall clock time in milliseconds
+    const std::map<std::string, double> &timings() const { return timings_; }
+
+    // writes the hierarchy, ports, variables and connectivity to a file that DesignSnapshot can
+    // load without elaborating the design again
+    bool save_snapshot(const std::string &filename, uint64_t key);
+
 private:
     slang::Compilation &compilation_;
+    bool instance_caching_;
     std::unordered_map<std::string, const slang::InstanceSymbol *> instances_map_;
     std::unordered_map<const slang::InstanceSymbol *, const slang::InstanceSymbol *> hierarchy_map_;
+    // instance body -> instance, used to answer parent/scope queries
+    std::unordered_map<const slang::Symbol *, const slang::InstanceSymbol *> body_map_;
     std::vector<const slang::InstanceSymbol *> instances_;
     std::vector<const slang::PortSymbol *> ports_;
     std::vector<const slang::VariableSymbol *> variables_;
+    std::map<std::string, double> timings_;
+    PathTable paths_;
+    std::unordered_map<const slang::Symbol *, uint64_t> path_ids_;
+    // symbols of every path node. a port and its internal variable share a node
+    struct PathSymbols {
+        const slang::InstanceSymbol *instance = nullptr;
+        const slang::PortSymbol *port = nullptr;
+        const slang::VariableSymbol *variable = nullptr;
+    };
+    std::vector<PathSymbols> path_symbols_;
+    std::vector<uint64_t> instance_contexts_;
+    // members of every body in ports_ and variables_, in CSR form
+    std::unordered_map<const slang::Symbol *, uint64_t> body_index_;
+    std::vector<uint64_t> body_port_offsets_ = {0};
+    std::vector<uint64_t> body_variable_offsets_ = {0};
 
-    void index_values();
-    std::set<const slang::InstanceSymbol *> get_connected_instances(
-        const slang::InstanceSymbol *target_instance, const slang::PortSymbol *port,
-        slang::ArgumentDirection direction);
-    const slang::InstanceSymbol *get_instance_from_scope(const slang::Scope *scope);
+    // rows are indexed by the position in instances_ and ports_
+    std::once_flag connectivity_built_;
+    std::unordered_map<const slang::InstanceSymbol *, uint64_t> instance_index_;
+    std::unordered_map<const slang::PortSymbol *, uint64_t> port_index_;
+    // see get_connected_instances()
+    ConnectivityGraph port_graph_;
+    ConnectivityGraph source_graph_;
+    ConnectivityGraph sink_graph_;
+
+    std::once_flag drivers_built_;
+    std::unordered_map<const slang::ValueSymbol *, uint64_t> value_index_;
+    ValueGraph driver_graph_;
+    ValueGraph load_graph_;
 
-    std::set<const slang::InstanceSymbol *> get_connected_instances(const slang::PortSymbol *port);
+    // cone queries reuse the pool as long as they ask for the same number of threads. callers
+    // keep the pool alive while a query with another count replaces it
+    std::mutex pool_mutex_;
+    std::shared_ptr<util::ThreadPool> pool_;
+
+    void index_values(uint64_t num_threads);
+    void build_connectivity_graph();
+    void build_driver_graph();
+    std::shared_ptr<util::ThreadPool> get_pool(uint64_t num_threads);
+    const slang::InstanceSymbol *get_instance_from_scope(const slang::Scope *scope);
+    std::vector<const slang::InstanceSymbol *> get_cone(
+        const std::vector<const slang::Symbol *> &targets, bool fanin, uint64_t depth,
+        uint64_t num_threads);
 };
 
 }  // namespace hgdb::rtl
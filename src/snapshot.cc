@@ -0,0 +1,424 @@
+#include "snapshot.hh"
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+
+namespace hgdb::rtl {
+
+std::string_view port_direction_name(PortDirection direction) {
+    switch (direction) {
+        case PortDirection::In:
+            return "in";
+        case PortDirection::Out:
+            return "out";
+        case PortDirection::InOut:
+            return "inout";
+        case PortDirection::Ref:
+            return "ref";
+    }
+    throw std::runtime_error("Unknown port direction");
+}
+
+// names of the files included with `include "name" or `include <name>
+std::vector<std::pair<std::string, bool>> scan_includes(std::string_view content) {
+    constexpr std::string_view directive = "`include";
+    std::vector<std::pair<std::string, bool>> result;
+    for (auto pos = content.find(directive); pos != std::string_view::npos;
+         pos = content.find(directive, pos)) {
+        pos = content.find_first_not_of(" \t", pos + directive.size());
+        if (pos == std::string_view::npos) break;
+        if (content[pos] != '"' && content[pos] != '<') continue;
+        auto system = content[pos] == '<';
+        auto end = content.find_first_of(system ? ">\n" : "\"\n", pos + 1);
+        if (end == std::string_view::npos) break;
+        result.emplace_back(std::string(content.substr(pos + 1, end - pos - 1)), system);
+        pos = end;
+    }
+    return result;
+}
+
+// quoted names are looked up next to the including file first
+std::optional<std::string> find_include(const std::string &name, bool system,
+                                        const std::string &including_file,
+                                        const std::vector<std::string> &include_dirs) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!system) {
+        auto path = fs::path(including_file).parent_path() / name;
+        if (fs::is_regular_file(path, ec)) return path.string();
+    }
+    for (auto const &dir : include_dirs) {
+        auto path = fs::path(dir) / name;
+        if (fs::is_regular_file(path, ec)) return path.string();
+    }
+    return std::nullopt;
+}
+
+uint64_t DesignSnapshot::compute_key(const std::vector<std::string> &files,
+                                     const std::vector<std::string> &include_dirs,
+                                     const std::map<std::string, std::string> &macros,
+                                     const std::string &top) {
+    util::KeyHasher hasher;
+    // include files are hashed once, in the order they are first found
+    std::set<std::string> includes;
+    std::vector<std::string> pending;
+    for (auto const &filename : files) {
+        hasher.add(filename);
+        pending.emplace_back(filename);
+        while (!pending.empty()) {
+            auto current = std::move(pending.back());
+            pending.pop_back();
+            auto content = util::read_file(current);
+            hasher.add(content);
+            for (auto const &[name, system] : scan_includes(content)) {
+                // missing files are part of the key through their name
+                hasher.add(name);
+                auto path = find_include(name, system, current, include_dirs);
+                if (path && includes.emplace(*path).second) pending.emplace_back(*path);
+            }
+        }
+    }
+    for (auto const &dir : include_dirs) hasher.add(dir);
+    for (auto const &[name, value] : macros) {
+        hasher.add(name);
+        hasher.add(value);
+    }
+    hasher.add(top);
+    return hasher.value();
+}
+
+bool DesignSnapshot::save(const SnapshotData &data, const std::string &filename, uint64_t key) {
+    std::vector<char> strings;
+    auto add_string = [&strings](const std::string &str) {
+        StringRef ref{strings.size(), str.size()};
+        strings.insert(strings.end(), str.begin(), str.end());
+        return ref;
+    };
+
+    auto num_instances = data.instances.size();
+    std::vector<InstanceEntry> instances(num_instances);
+    for (uint64_t i = 0; i < num_instances; i++) {
+        auto const &inst = data.instances[i];
+        instances[i] = {add_string(inst.path), add_string(inst.name), add_string(inst.definition),
+                        inst.parent, i};
+    }
+    // children come after their parent in pre-order, so walking backwards propagates the
+    // subtree end all the way up
+    for (uint64_t i = num_instances; i > 0; i--) {
+        auto const &inst = instances[i - 1];
+        if (inst.parent == no_parent) continue;
+        auto &parent = instances[inst.parent];
+        parent.subtree_end = std::max(parent.subtree_end, inst.subtree_end);
+    }
+
+    std::vector<PortEntry> ports;
+    ports.reserve(data.ports.size());
+    for (auto const &port : data.ports) {
+        ports.emplace_back(PortEntry{add_string(port.path), add_string(port.name), port.instance,
+                                     static_cast<uint64_t>(port.direction)});
+    }
+    std::vector<VariableEntry> variables;
+    variables.reserve(data.variables.size());
+    for (auto const &var : data.variables) {
+        variables.emplace_back(
+            VariableEntry{add_string(var.path), add_string(var.name), var.instance});
+    }
+
+    auto sort_by_path = [](const auto &entries) {
+        std::vector<uint64_t> order(entries.size());
+        for (uint64_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&entries](uint64_t a, uint64_t b) {
+            return entries[a].path < entries[b].path;
+        });
+        return order;
+    };
+    auto instance_order = sort_by_path(data.instances);
+    auto port_order = sort_by_path(data.ports);
+    auto variable_order = sort_by_path(data.variables);
+
+    std::vector<uint64_t> edges;
+    auto flatten = [&edges](const std::vector<std::vector<uint64_t>> &rows, uint64_t num_rows) {
+        std::vector<uint64_t> offsets = {edges.size()};
+        for (uint64_t i = 0; i < num_rows; i++) {
+            if (i < rows.size()) edges.insert(edges.end(), rows[i].begin(), rows[i].end());
+            offsets.emplace_back(edges.size());
+        }
+        return offsets;
+    };
+    auto source_offsets = flatten(data.sources, num_instances);
+    auto sink_offsets = flatten(data.sinks, num_instances);
+    auto port_offsets = flatten(data.port_connections, ports.size());
+
+    Header header{};
+    header.magic = magic;
+    header.version = version;
+    header.key = key;
+    header.num_instances = num_instances;
+    header.num_ports = ports.size();
+    header.num_variables = variables.size();
+    header.num_edges = edges.size();
+    header.strings_size = strings.size();
+
+    util::SectionWriter writer(filename);
+    if (!writer.good()) return false;
+    writer.write(&header, 1);
+    writer.write(instances.data(), instances.size());
+    writer.write(ports.data(), ports.size());
+    writer.write(variables.data(), variables.size());
+    writer.write(instance_order.data(), instance_order.size());
+    writer.write(port_order.data(), port_order.size());
+    writer.write(variable_order.data(), variable_order.size());
+    writer.write(source_offsets.data(), source_offsets.size());
+    writer.write(sink_offsets.data(), sink_offsets.size());
+    writer.write(port_offsets.data(), port_offsets.size());
+    writer.write(edges.data(), edges.size());
+    writer.write(strings.data(), strings.size());
+    return writer.commit();
+}
+
+std::unique_ptr<DesignSnapshot> DesignSnapshot::load(const std::string &filename, uint64_t key) {
+    auto file = std::make_unique<util::MappedFile>(filename);
+    if (!file->is_open() || file->size() < sizeof(Header)) return nullptr;
+    auto const *base = file->data();
+    auto const &header = *reinterpret_cast<const Header *>(base);
+    if (header.magic != magic || header.version != version || header.key != key) return nullptr;
+
+    auto num_instances = header.num_instances;
+    auto num_ports = header.num_ports;
+    auto num_variables = header.num_variables;
+    // the graph offsets have one more entry than rows, so their counts are checked before the + 1
+    auto const max_count = file->size() / sizeof(uint64_t);
+    if (num_instances >= max_count || num_ports >= max_count) return nullptr;
+    util::SectionReader reader(file->size(), sizeof(Header));
+    auto const instances_offset = reader.next(num_instances, sizeof(InstanceEntry));
+    auto const ports_offset = reader.next(num_ports, sizeof(PortEntry));
+    auto const variables_offset = reader.next(num_variables, sizeof(VariableEntry));
+    auto const instance_order_offset = reader.next(num_instances, sizeof(uint64_t));
+    auto const port_order_offset = reader.next(num_ports, sizeof(uint64_t));
+    auto const variable_order_offset = reader.next(num_variables, sizeof(uint64_t));
+    auto const source_offset = reader.next(num_instances + 1, sizeof(uint64_t));
+    auto const sink_offset = reader.next(num_instances + 1, sizeof(uint64_t));
+    auto const port_offset = reader.next(num_ports + 1, sizeof(uint64_t));
+    auto const edges_offset = reader.next(header.num_edges, sizeof(uint64_t));
+    auto const strings_offset = reader.next(header.strings_size, 1);
+    if (!reader.valid()) return nullptr;
+
+    std::unique_ptr<DesignSnapshot> result(new DesignSnapshot());
+    auto &s = *result;
+    s.header_ = &header;
+    s.instances_ = reinterpret_cast<const InstanceEntry *>(base + instances_offset);
+    s.ports_ = reinterpret_cast<const PortEntry *>(base + ports_offset);
+    s.variables_ = reinterpret_cast<const VariableEntry *>(base + variables_offset);
+    s.instance_order_ = reinterpret_cast<const uint64_t *>(base + instance_order_offset);
+    s.port_order_ = reinterpret_cast<const uint64_t *>(base + port_order_offset);
+    s.variable_order_ = reinterpret_cast<const uint64_t *>(base + variable_order_offset);
+    s.sources_.offsets = reinterpret_cast<const uint64_t *>(base + source_offset);
+    s.sinks_.offsets = reinterpret_cast<const uint64_t *>(base + sink_offset);
+    s.port_connections_.offsets = reinterpret_cast<const uint64_t *>(base + port_offset);
+    s.edges_ = reinterpret_cast<const uint64_t *>(base + edges_offset);
+    s.strings_ = base + strings_offset;
+
+    // validate every reference once so that accessors don't need to
+    auto valid_string = [&header](const StringRef &ref) {
+        return ref.offset <= header.strings_size && ref.size <= header.strings_size - ref.offset;
+    };
+    for (uint64_t i = 0; i < num_instances; i++) {
+        auto const &inst = s.instances_[i];
+        if (!valid_string(inst.path) || !valid_string(inst.name) ||
+            !valid_string(inst.definition) || inst.subtree_end < i ||
+            inst.subtree_end >= num_instances || (inst.parent != no_parent && inst.parent >= i) ||
+            s.instance_order_[i] >= num_instances) {
+            return nullptr;
+        }
+    }
+    for (uint64_t i = 0; i < num_ports; i++) {
+        auto const &port = s.ports_[i];
+        if (!valid_string(port.path) || !valid_string(port.name) ||
+            port.instance >= num_instances ||
+            port.direction > static_cast<uint64_t>(PortDirection::Ref) ||
+            s.port_order_[i] >= num_ports) {
+            return nullptr;
+        }
+    }
+    for (uint64_t i = 0; i < num_variables; i++) {
+        auto const &var = s.variables_[i];
+        if (!valid_string(var.path) || !valid_string(var.name) ||
+            var.instance >= num_instances || s.variable_order_[i] >= num_variables) {
+            return nullptr;
+        }
+    }
+    auto valid_graph = [&](const Graph &graph, uint64_t num_rows) {
+        for (uint64_t i = 0; i < num_rows; i++) {
+            if (graph.offsets[i] > graph.offsets[i + 1]) return false;
+        }
+        return graph.offsets[num_rows] <= header.num_edges;
+    };
+    if (!valid_graph(s.sources_, num_instances) || !valid_graph(s.sinks_, num_instances) ||
+        !valid_graph(s.port_connections_, num_ports)) {
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < header.num_edges; i++) {
+        if (s.edges_[i] >= num_instances) return nullptr;
+    }
+
+    s.file_ = std::move(file);
+    return result;
+}
+
+std::string_view DesignSnapshot::instance_path(uint64_t id) const {
+    return get_string(instances_[id].path);
+}
+
+std::string_view DesignSnapshot::instance_name(uint64_t id) const {
+    return get_string(instances_[id].name);
+}
+
+std::string_view DesignSnapshot::instance_definition(uint64_t id) const {
+    return get_string(instances_[id].definition);
+}
+
+uint64_t DesignSnapshot::instance_parent(uint64_t id) const { return instances_[id].parent; }
+
+bool DesignSnapshot::instance_inside(uint64_t child, uint64_t parent) const {
+    // pre-order numbering puts every descendant right after the instance itself
+    return child > parent && child <= instances_[parent].subtree_end;
+}
+
+std::string_view DesignSnapshot::port_path(uint64_t id) const {
+    return get_string(ports_[id].path);
+}
+
+std::string_view DesignSnapshot::port_name(uint64_t id) const {
+    return get_string(ports_[id].name);
+}
+
+uint64_t DesignSnapshot::port_instance(uint64_t id) const { return ports_[id].instance; }
+
+PortDirection DesignSnapshot::port_direction(uint64_t id) const {
+    return static_cast<PortDirection>(ports_[id].direction);
+}
+
+std::string_view DesignSnapshot::variable_path(uint64_t id) const {
+    return get_string(variables_[id].path);
+}
+
+std::string_view DesignSnapshot::variable_name(uint64_t id) const {
+    return get_string(variables_[id].name);
+}
+
+uint64_t DesignSnapshot::variable_instance(uint64_t id) const { return variables_[id].instance; }
+
+template <typename T>
+std::optional<uint64_t> DesignSnapshot::find(const T *entries, const uint64_t *order,
+                                              uint64_t size, std::string_view path) const {
+    auto const *end = order + size;
+    auto const *it = std::lower_bound(order, end, path, [&](uint64_t index, std::string_view p) {
+        return get_string(entries[index].path) < p;
+    });
+    if (it == end || get_string(entries[*it].path) != path) return std::nullopt;
+    return *it;
+}
+
+std::optional<uint64_t> DesignSnapshot::find_instance(std::string_view path) const {
+    return find(instances_, instance_order_, num_instances(), path);
+}
+
+std::optional<uint64_t> DesignSnapshot::find_port(std::string_view path) const {
+    return find(ports_, port_order_, num_ports(), path);
+}
+
+std::optional<uint64_t> DesignSnapshot::find_variable(std::string_view path) const {
+    return find(variables_, variable_order_, num_variables(), path);
+}
+
+std::span<const uint64_t> DesignSnapshot::sources(uint64_t instance) const {
+    return sources_.row(edges_, instance);
+}
+
+std::span<const uint64_t> DesignSnapshot::sinks(uint64_t instance) const {
+    return sinks_.row(edges_, instance);
+}
+
+std::span<const uint64_t> DesignSnapshot::port_connections(uint64_t port) const {
+    return port_connections_.row(edges_, port);
+}
+
+DesignSnapshot::Selection DesignSnapshot::select_paths(const PathPattern &pattern) const {
+    Selection result;
+    // pattern state of every instance that can still lead to a match
+    std::vector<PathPattern::State> states(num_instances());
+    std::vector<bool> alive(num_instances(), false);
+    auto advance = [&](uint64_t parent, std::string_view path) {
+        if (parent == no_parent) return pattern.advance(pattern.initial(), path, 0);
+        return pattern.advance(states[parent], path, instance_path(parent).size() + 1);
+    };
+    for (uint64_t i = 0; i < num_instances();) {
+        auto path = instance_path(i);
+        auto state = advance(instances_[i].parent, path);
+        if (PathPattern::dead(state)) {
+            i = instances_[i].subtree_end + 1;
+            continue;
+        }
+        if (pattern.accepts(state, path)) result.instances.emplace_back(i);
+        states[i] = std::move(state);
+        alive[i] = true;
+        i++;
+    }
+    for (uint64_t i = 0; i < num_ports(); i++) {
+        auto instance = ports_[i].instance;
+        if (!alive[instance]) continue;
+        auto path = port_path(i);
+        if (pattern.accepts(advance(instance, path), path)) result.ports.emplace_back(i);
+    }
+    for (uint64_t i = 0; i < num_variables(); i++) {
+        auto instance = variables_[i].instance;
+        if (!alive[instance]) continue;
+        auto path = variable_path(i);
+        if (pattern.accepts(advance(instance, path), path)) result.variables.emplace_back(i);
+    }
+    return result;
+}
+
+std::vector<uint64_t> DesignSnapshot::get_cone(const std::vector<uint64_t> &instances,
+                                               const std::vector<uint64_t> &ports, bool fanin,
+                                               uint64_t depth) const {
+    auto direction = fanin ? PortDirection::In : PortDirection::Out;
+    std::vector<bool> visited(num_instances(), false);
+    std::vector<uint64_t> frontier;
+    for (auto id : instances) {
+        if (!visited[id]) frontier.emplace_back(id);
+        visited[id] = true;
+    }
+    // the first hop of a port comes from the port connections instead of the graph
+    std::vector<uint64_t> port_hop;
+    for (auto id : ports) {
+        if (port_direction(id) != direction) continue;
+        auto row = port_connections(id);
+        port_hop.insert(port_hop.end(), row.begin(), row.end());
+    }
+
+    // same visiting order as the slang-backed database, so both give identical results
+    std::vector<uint64_t> result;
+    std::vector<uint64_t> next;
+    for (uint64_t hop = 0; hop < depth && (!frontier.empty() || !port_hop.empty()); hop++) {
+        for (auto id : frontier) {
+            auto row = fanin ? sources(id) : sinks(id);
+            next.insert(next.end(), row.begin(), row.end());
+        }
+        if (hop == 0) next.insert(next.end(), port_hop.begin(), port_hop.end());
+        frontier.clear();
+        for (auto id : next) {
+            if (visited[id]) continue;
+            visited[id] = true;
+            frontier.emplace_back(id);
+            result.emplace_back(id);
+        }
+        next.clear();
+        port_hop.clear();
+    }
+    return result;
+}
+
+}  // namespace hgdb::rtl
@@ -0,0 +1,190 @@
+#ifndef HGDB_RTL_SNAPSHOT_HH
+#define HGDB_RTL_SNAPSHOT_HH
+
+#include <array>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "path.hh"
+#include "util.hh"
+
+namespace hgdb::rtl {
+
+enum class PortDirection : uint64_t { In, Out, InOut, Ref };
+
+std::string_view port_direction_name(PortDirection direction);
+
+// plain copy of an elaborated design, filled in by DesignDatabase::save_snapshot(). instances
+// are in hierarchy pre-order and are referred to by their index
+struct SnapshotData {
+    static constexpr uint64_t no_parent = std::numeric_limits<uint64_t>::max();
+
+    struct Instance {
+        std::string path;
+        std::string name;
+        std::string definition;
+        uint64_t parent;
+    };
+    struct Port {
+        std::string path;
+        std::string name;
+        uint64_t instance;
+        PortDirection direction;
+    };
+    struct Variable {
+        std::string path;
+        std::string name;
+        uint64_t instance;
+    };
+
+    std::vector<Instance> instances;
+    std::vector<Port> ports;
+    std::vector<Variable> variables;
+    // connectivity rows, see DesignDatabase::build_connectivity()
+    std::vector<std::vector<uint64_t>> sources;
+    std::vector<std::vector<uint64_t>> sinks;
+    std::vector<std::vector<uint64_t>> port_connections;
+};
+
+// read-only design database memory mapped from a snapshot file. it only needs the snapshot, so
+// queries can be answered without elaborating the design. the file is keyed on the content of
+// the design sources, see compute_key()
+class DesignSnapshot {
+public:
+    static constexpr uint64_t no_parent = SnapshotData::no_parent;
+
+    // hash of the file list, their content, the include directories, the macros and the top
+    // module. the content of included files is found by scanning the sources for `include
+    // directives, so includes whose name comes from a macro are not part of the key
+    static uint64_t compute_key(const std::vector<std::string> &files,
+                                const std::vector<std::string> &include_dirs,
+                                const std::map<std::string, std::string> &macros,
+                                const std::string &top);
+    static bool save(const SnapshotData &data, const std::string &filename, uint64_t key);
+    // returns nullptr if the file is missing, malformed, or has a different key
+    static std::unique_ptr<DesignSnapshot> load(const std::string &filename, uint64_t key);
+
+    [[nodiscard]] uint64_t num_instances() const { return header_->num_instances; }
+    [[nodiscard]] uint64_t num_ports() const { return header_->num_ports; }
+    [[nodiscard]] uint64_t num_variables() const { return header_->num_variables; }
+
+    [[nodiscard]] std::string_view instance_path(uint64_t id) const;
+    [[nodiscard]] std::string_view instance_name(uint64_t id) const;
+    [[nodiscard]] std::string_view instance_definition(uint64_t id) const;
+    [[nodiscard]] uint64_t instance_parent(uint64_t id) const;
+    // whether child is strictly below parent in the hierarchy
+    [[nodiscard]] bool instance_inside(uint64_t child, uint64_t parent) const;
+
+    [[nodiscard]] std::string_view port_path(uint64_t id) const;
+    [[nodiscard]] std::string_view port_name(uint64_t id) const;
+    [[nodiscard]] uint64_t port_instance(uint64_t id) const;
+    [[nodiscard]] PortDirection port_direction(uint64_t id) const;
+
+    [[nodiscard]] std::string_view variable_path(uint64_t id) const;
+    [[nodiscard]] std::string_view variable_name(uint64_t id) const;
+    [[nodiscard]] uint64_t variable_instance(uint64_t id) const;
+
+    [[nodiscard]] std::optional<uint64_t> find_instance(std::string_view path) const;
+    [[nodiscard]] std::optional<uint64_t> find_port(std::string_view path) const;
+    [[nodiscard]] std::optional<uint64_t> find_variable(std::string_view path) const;
+
+    [[nodiscard]] std::span<const uint64_t> sources(uint64_t instance) const;
+    [[nodiscard]] std::span<const uint64_t> sinks(uint64_t instance) const;
+    // sources of an input port or sinks of an output port
+    [[nodiscard]] std::span<const uint64_t> port_connections(uint64_t port) const;
+
+    struct Selection {
+        std::vector<uint64_t> instances;
+        std::vector<uint64_t> ports;
+        std::vector<uint64_t> variables;
+    };
+    // same as DesignDatabase::select_paths(). subtrees are skipped through the pre-order ranges
+    [[nodiscard]] Selection select_paths(const PathPattern &pattern) const;
+
+    // same as DesignDatabase::get_fanin()/get_fanout()
+    [[nodiscard]] std::vector<uint64_t> get_cone(const std::vector<uint64_t> &instances,
+                                                 const std::vector<uint64_t> &ports, bool fanin,
+                                                 uint64_t depth) const;
+
+private:
+    static constexpr std::array<char, 8> magic = {'O', 'O', 'Z', 'E', 'R', 'T', 'L', '\0'};
+    static constexpr uint64_t version = 1;
+
+    struct Header {
+        std::array<char, 8> magic;
+        uint64_t version;
+        uint64_t key;
+        uint64_t num_instances;
+        uint64_t num_ports;
+        uint64_t num_variables;
+        uint64_t num_edges;
+        uint64_t strings_size;
+    };
+
+    struct StringRef {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct InstanceEntry {
+        StringRef path;
+        StringRef name;
+        StringRef definition;
+        uint64_t parent;
+        // last instance of the pre-order subtree
+        uint64_t subtree_end;
+    };
+
+    struct PortEntry {
+        StringRef path;
+        StringRef name;
+        uint64_t instance;
+        uint64_t direction;
+    };
+
+    struct VariableEntry {
+        StringRef path;
+        StringRef name;
+        uint64_t instance;
+    };
+
+    // a CSR graph has num_rows + 1 offsets into the shared edge array
+    struct Graph {
+        const uint64_t *offsets;
+        [[nodiscard]] std::span<const uint64_t> row(const uint64_t *edges, uint64_t index) const {
+            return {edges + offsets[index], edges + offsets[index + 1]};
+        }
+    };
+
+    std::unique_ptr<util::MappedFile> file_;
+    const Header *header_ = nullptr;
+    const InstanceEntry *instances_ = nullptr;
+    const PortEntry *ports_ = nullptr;
+    const VariableEntry *variables_ = nullptr;
+    // indices sorted by path, used for lookups
+    const uint64_t *instance_order_ = nullptr;
+    const uint64_t *port_order_ = nullptr;
+    const uint64_t *variable_order_ = nullptr;
+    Graph sources_{};
+    Graph sinks_{};
+    Graph port_connections_{};
+    const uint64_t *edges_ = nullptr;
+    const char *strings_ = nullptr;
+
+    [[nodiscard]] std::string_view get_string(const StringRef &ref) const {
+        return {strings_ + ref.offset, ref.size};
+    }
+    template <typename T>
+    [[nodiscard]] std::optional<uint64_t> find(const T *entries, const uint64_t *order,
+                                               uint64_t size, std::string_view path) const;
+};
+
+}  // namespace hgdb::rtl
+
+#endif  // HGDB_RTL_SNAPSHOT_HH
@@ -0,0 +1,157 @@
+#include "util.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+
+namespace hgdb::util {
+
+MappedFile::MappedFile(const std::string &filename) {
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    auto *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the file descriptor is closed
+    close(fd);
+    if (ptr == MAP_FAILED) return;
+    data_ = reinterpret_cast<const char *>(ptr);
+    size_ = st.st_size;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+std::string read_file(const std::string &filename) {
+    std::ifstream stream(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+SectionWriter::SectionWriter(const std::string &filename)
+    : filename_(filename),
+      temp_filename_(filename + ".tmp"),
+      stream_(temp_filename_, std::ios::binary | std::ios::trunc) {}
+
+SectionWriter::~SectionWriter() {
+    if (committed_) return;
+    stream_.close();
+    std::error_code ec;
+    std::filesystem::remove(temp_filename_, ec);
+}
+
+bool SectionWriter::commit() {
+    stream_.close();
+    if (!stream_.good()) return false;
+    std::error_code ec;
+    std::filesystem::rename(temp_filename_, filename_, ec);
+    committed_ = !ec;
+    return committed_;
+}
+
+bool get_file_stamp(const std::string &filename, FileStamp &stamp) {
+    struct stat st {};
+    if (stat(filename.c_str(), &st) != 0) return false;
+    stamp.size = st.st_size;
+    stamp.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1'000'000'000ull +
+                  static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    return true;
+}
+
+std::string_view StringArena::add(std::string_view str) {
+    size_ += str.size();
+    char *ptr;
+    if (str.size() > block_size / 4) {
+        // large strings get their own block. the current block stays open
+        auto block = std::make_unique<char[]>(str.size());
+        ptr = block.get();
+        blocks_.insert(blocks_.end() - (blocks_.empty() ? 0 : 1), std::move(block));
+    } else {
+        if (block_used_ + str.size() > block_size) {
+            blocks_.emplace_back(std::make_unique<char[]>(block_size));
+            block_used_ = 0;
+        }
+        ptr = blocks_.back().get() + block_used_;
+        block_used_ += str.size();
+    }
+    std::copy(str.begin(), str.end(), ptr);
+    return {ptr, str.size()};
+}
+
+uint64_t get_num_threads(uint64_t num_threads) {
+    if (num_threads > 0) return num_threads;
+    auto hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 0 ? hardware_threads : 1;
+}
+
+ThreadPool::ThreadPool(uint64_t num_threads) {
+    num_threads = get_num_threads(num_threads);
+    workers_.reserve(num_threads);
+    for (uint64_t i = 0; i < num_threads; i++) {
+        workers_.emplace_back([this]() { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+void parallel_for(ThreadPool &pool, uint64_t size, const std::function<void(uint64_t)> &func) {
+    if (size == 0) return;
+    // a few blocks per thread to balance uneven work
+    auto num_blocks = std::min<uint64_t>(size, pool.size() * 4);
+    auto block_size = (size + num_blocks - 1) / num_blocks;
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_blocks);
+    for (uint64_t start = 0; start < size; start += block_size) {
+        auto end = std::min(start + block_size, size);
+        futures.emplace_back(pool.enqueue([start, end, &func]() {
+            for (auto i = start; i < end; i++) func(i);
+        }));
+    }
+    // the blocks reference func and the caller's state, so all of them have to finish before an
+    // exception is passed on
+    std::exception_ptr error;
+    for (auto &future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+}  // namespace hgdb::util
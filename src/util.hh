@@ -0,0 +1,211 @@
+#ifndef HGDB_RTL_UTIL_HH
+#define HGDB_RTL_UTIL_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hgdb::util {
+
+// read-only memory mapped file. pages are loaded by the OS on first access
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+    [[nodiscard]] const char *data() const { return data_; }
+    [[nodiscard]] uint64_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+// used to validate derived files against the source they are generated from
+struct FileStamp {
+    uint64_t size = 0;
+    uint64_t mtime = 0;
+
+    bool operator==(const FileStamp &other) const = default;
+};
+
+bool get_file_stamp(const std::string &filename, FileStamp &stamp);
+
+// whole content of a file, empty if it can't be read
+std::string read_file(const std::string &filename);
+
+// the binary files derived from sources (VCD index, log store, design snapshot) are a header
+// followed by sections of arrays. every section is padded to 8 bytes, so the arrays can be used
+// directly from the mapped file
+inline uint64_t align(uint64_t size) { return (size + 7) & ~7ull; }
+
+// writes the sections to a temporary file that replaces the target on commit(), so a partially
+// written file is never picked up
+class SectionWriter {
+public:
+    explicit SectionWriter(const std::string &filename);
+    SectionWriter(const SectionWriter &) = delete;
+    SectionWriter &operator=(const SectionWriter &) = delete;
+    // the temporary file is removed if it's not committed
+    ~SectionWriter();
+
+    [[nodiscard]] bool good() const { return stream_.good(); }
+
+    template <typename T>
+    void write(const T *data, uint64_t size) {
+        stream_.write(reinterpret_cast<const char *>(data),
+                      static_cast<std::streamsize>(size * sizeof(T)));
+        constexpr char padding[8] = {};
+        auto remainder = (size * sizeof(T)) % 8;
+        if (remainder) stream_.write(padding, static_cast<std::streamsize>(8 - remainder));
+    }
+
+    bool commit();
+
+private:
+    std::string filename_;
+    std::string temp_filename_;
+    std::ofstream stream_;
+    bool committed_ = false;
+};
+
+// computes the offsets of the sections after the header, in the order they are written. counts
+// are checked against the file size before they are multiplied, so the offsets can't overflow
+class SectionReader {
+public:
+    SectionReader(uint64_t file_size, uint64_t header_size)
+        : file_size_(file_size), pos_(align(header_size)) {}
+
+    uint64_t next(uint64_t count, uint64_t element_size) {
+        auto offset = pos_;
+        if (!valid() || count > file_size_ / element_size) {
+            valid_ = false;
+            return 0;
+        }
+        pos_ += align(count * element_size);
+        return offset;
+    }
+
+    // whether every section is inside the file
+    [[nodiscard]] bool valid() const { return valid_ && pos_ <= file_size_; }
+    // end of the sections read so far
+    [[nodiscard]] uint64_t pos() const { return pos_; }
+
+private:
+    uint64_t file_size_;
+    uint64_t pos_;
+    bool valid_ = true;
+};
+
+// 64-bit FNV-1a over a sequence of strings, used to key files derived from several inputs
+class KeyHasher {
+public:
+    void add(std::string_view data) {
+        // length first so that concatenations don't collide
+        add_bytes(std::to_string(data.size()));
+        add_bytes(data);
+    }
+
+    [[nodiscard]] uint64_t value() const { return hash_; }
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+
+    void add_bytes(std::string_view data) {
+        for (auto c : data) {
+            hash_ ^= static_cast<uint8_t>(c);
+            hash_ *= 0x100000001b3ull;
+        }
+    }
+};
+
+// fixed-size worker pool. tasks are executed in FIFO order
+class ThreadPool {
+public:
+    // 0 means using all the hardware threads
+    explicit ThreadPool(uint64_t num_threads);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    template <typename F>
+    auto enqueue(F &&func) -> std::future<std::invoke_result_t<F>> {
+        using R = std::invoke_result_t<F>;
+        // std::function has to be copyable, hence the shared pointer
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        auto result = task->get_future();
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.emplace([task]() { (*task)(); });
+        }
+        cond_.notify_one();
+        return result;
+    }
+
+    [[nodiscard]] uint64_t size() const { return workers_.size(); }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+
+    void run();
+};
+
+uint64_t get_num_threads(uint64_t num_threads);
+
+// wall clock time of a phase, in milliseconds
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+    double lap() {
+        auto now = std::chrono::steady_clock::now();
+        auto result = std::chrono::duration<double, std::milli>(now - start_).count();
+        start_ = now;
+        return result;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// append-only string storage. strings are copied into large blocks, so views into the arena
+// stay valid for its whole lifetime
+class StringArena {
+public:
+    std::string_view add(std::string_view str);
+
+    [[nodiscard]] uint64_t size() const { return size_; }
+
+private:
+    static constexpr uint64_t block_size = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    uint64_t block_used_ = block_size;
+    uint64_t size_ = 0;
+};
+
+// calls func(i) for every i in [0, size) using the pool and waits for all of them to finish.
+// the first exception thrown by func is re-thrown once every block has finished
+void parallel_for(ThreadPool &pool, uint64_t size, const std::function<void(uint64_t)> &func);
+
+}  // namespace hgdb::util
+
+#endif  // HGDB_RTL_UTIL_HH
@@ -1,35 +1,825 @@
 #include "vcd.hh"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <string_view>
 #include <vector>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "fmt/format.h"
 #include "vcd/vcd.hh"
 
 namespace hgdb::vcd {
 
-std::string VCDSignal::get_value(uint64_t time) const {
-    // map is a b-tree
-    auto const &ref_time = raw_values->lower_bound(time);
-    if (ref_time != raw_values->end()) {
-        return ref_time->second;
+// 2-bit encoding for each 4-state bit
+constexpr uint8_t code_0 = 0b00;
+constexpr uint8_t code_1 = 0b01;
+constexpr uint8_t code_x = 0b10;
+constexpr uint8_t code_z = 0b11;
+constexpr uint8_t code_invalid = 0xFF;
+
+uint8_t encode_bit(char c) {
+    switch (c) {
+        case '0':
+            return code_0;
+        case '1':
+            return code_1;
+        case 'x':
+        case 'X':
+            return code_x;
+        case 'z':
+        case 'Z':
+            return code_z;
+        default:
+            return code_invalid;
+    }
+}
+
+constexpr char decode_bit(uint8_t code) {
+    constexpr std::array<char, 4> chars = {'0', '1', 'x', 'z'};
+    return chars[code & 0b11];
+}
+
+// characters of 4 consecutive codes, most significant first
+constexpr auto code_chars = [] {
+    std::array<std::array<char, 4>, 256> result{};
+    for (uint64_t codes = 0; codes < 256; codes++) {
+        for (uint64_t k = 0; k < 4; k++) {
+            result[codes][3 - k] = decode_bit(codes >> (k * 2));
+        }
+    }
+    return result;
+}();
+
+// values are processed 32 bits at a time, which fills a 64-bit word with codes.
+// spread_bits moves bit i to bit 2i and compress_bits does the opposite
+uint64_t spread_bits(uint64_t x) {
+#if defined(__BMI2__)
+    return _pdep_u64(x, 0x5555555555555555ull);
+#else
+    x &= 0xFFFFFFFFull;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+#endif
+}
+
+uint64_t compress_bits(uint64_t x) {
+#if defined(__BMI2__)
+    return _pext_u64(x, 0x5555555555555555ull);
+#else
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+    return x;
+#endif
+}
+
+uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// classifies 32 characters. bit k of lo/hi is the low/high bit of the code of c[k].
+// returns false if any of them is not 4-state
+bool classify_chars(const char *c, uint32_t &lo, uint32_t &hi) {
+#if defined(__AVX2__)
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(c));
+    // letters are lower-cased. '0' and '1' already have the bit set
+    auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    auto is_0 = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('0'));
+    auto is_1 = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('1'));
+    auto is_x = _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('x'));
+    auto is_z = _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('z'));
+    auto valid = _mm256_or_si256(_mm256_or_si256(is_0, is_1), _mm256_or_si256(is_x, is_z));
+    lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(is_1, is_z)));
+    hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(is_x, is_z)));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(valid)) == 0xFFFFFFFFu;
+#elif defined(__SSE2__)
+    uint32_t valid = 0;
+    lo = 0;
+    hi = 0;
+    for (uint64_t half = 0; half < 2; half++) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(c + half * 16));
+        auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        auto is_0 = _mm_cmpeq_epi8(v, _mm_set1_epi8('0'));
+        auto is_1 = _mm_cmpeq_epi8(v, _mm_set1_epi8('1'));
+        auto is_x = _mm_cmpeq_epi8(lower, _mm_set1_epi8('x'));
+        auto is_z = _mm_cmpeq_epi8(lower, _mm_set1_epi8('z'));
+        auto shift = half * 16;
+        valid |= static_cast<uint32_t>(_mm_movemask_epi8(
+                     _mm_or_si128(_mm_or_si128(is_0, is_1), _mm_or_si128(is_x, is_z))))
+                 << shift;
+        lo |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(is_1, is_z))) << shift;
+        hi |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(is_x, is_z))) << shift;
+    }
+    return valid == 0xFFFFFFFFu;
+#else
+    lo = 0;
+    hi = 0;
+    for (uint64_t k = 0; k < 32; k++) {
+        auto code = encode_bit(c[k]);
+        if (code == code_invalid) return false;
+        lo |= static_cast<uint32_t>(code & 1) << k;
+        hi |= static_cast<uint32_t>(code >> 1) << k;
+    }
+    return true;
+#endif
+}
+
+// encodes the value into words of 32 codes, least significant bit first.
+// returns false if the value is not 4-state
+bool encode_value(std::string_view value, std::vector<uint64_t> &codes) {
+    auto len = value.size();
+    codes.assign((len + 31) / 32, 0);
+    uint64_t block = 0;
+    for (; (block + 1) * 32 <= len; block++) {
+        uint32_t lo, hi;
+        if (!classify_chars(value.data() + len - (block + 1) * 32, lo, hi)) return false;
+        // the string starts with the most significant bit
+        codes[block] = spread_bits(reverse_bits(lo)) | (spread_bits(reverse_bits(hi)) << 1);
+    }
+    // leftover characters at the front of the string
+    for (auto bit = block * 32; bit < len; bit++) {
+        auto code = encode_bit(value[len - bit - 1]);
+        if (code == code_invalid) return false;
+        codes[block] |= static_cast<uint64_t>(code) << ((bit % 32) * 2);
+    }
+    return true;
+}
+
+// VCD values are left-extended to the signal width. 0 and 1 extend with 0 while x and z extend
+// with themselves, so we can always store the shortest form
+std::string_view trim_value(std::string_view value) {
+    while (value.size() > 1) {
+        auto c = value[0];
+        auto next = value[1];
+        if (c == '0' && (next == '0' || next == '1')) {
+            value.remove_prefix(1);
+        } else if (auto lower = c | 0x20; (lower == 'x' || lower == 'z') && (next | 0x20) == lower) {
+            value.remove_prefix(1);
+        } else {
+            break;
+        }
+    }
+    return value;
+}
+
+// rolling hash over (time, value) entries: h' = h * multiplier + entry_hash
+constexpr uint64_t fingerprint_multiplier = 0x100000001b3ull;
+
+// finalizer from splitmix64 so that nearby inputs do not collide
+uint64_t mix_hash(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+uint64_t entry_hash(uint64_t time, std::string_view value) {
+    // case-insensitive, since X and Z are decoded as x and z. 8 characters at a time
+    constexpr uint64_t lower = 0x2020202020202020ull;
+    auto h = mix_hash(time ^ (value.size() * 0x9e3779b97f4a7c15ull));
+    for (uint64_t i = 0; i < value.size(); i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, value.data() + i, std::min<uint64_t>(8, value.size() - i));
+        h = mix_hash(h ^ (word | lower));
+    }
+    return h;
+}
+
+// inverse of the multiplier modulo 2^64 through newton's iteration
+constexpr uint64_t multiplicative_inverse(uint64_t value) {
+    uint64_t result = value;
+    for (auto i = 0; i < 5; i++) result *= 2 - value * result;
+    return result;
+}
+constexpr uint64_t fingerprint_inverse = multiplicative_inverse(fingerprint_multiplier);
+static_assert(fingerprint_multiplier * fingerprint_inverse == 1);
+
+uint64_t fingerprint_power(uint64_t n) {
+    uint64_t result = 1, base = fingerprint_multiplier;
+    while (n) {
+        if (n & 1) result *= base;
+        base *= base;
+        n >>= 1;
+    }
+    return result;
+}
+
+uint8_t extension_code(uint8_t msb_code) { return msb_code == code_1 ? code_0 : msb_code; }
+
+void write_varint(std::vector<uint8_t> &data, uint64_t value) {
+    while (value >= 0x80) {
+        data.emplace_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.emplace_back(static_cast<uint8_t>(value));
+}
+
+uint64_t read_varint(const uint8_t *data, uint64_t &pos) {
+    uint64_t result = 0;
+    uint64_t shift = 0;
+    while (true) {
+        auto b = data[pos++];
+        result |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    return result;
+}
+
+// bounded version for data read from an index file. fails if the varint doesn't end before size
+// or doesn't fit into 64 bits
+bool read_varint(const uint8_t *data, uint64_t size, uint64_t &pos, uint64_t &value) {
+    value = 0;
+    for (uint64_t shift = 0; pos < size && shift < 64; shift += 7) {
+        auto b = data[pos++];
+        value |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool VCDValueStore::check_mapped_times() const {
+    auto const &[times, times_size, checkpoints, num_checkpoints, bits, num_bits] = *mapped_;
+    uint64_t pos = 0, t = 0;
+    for (uint64_t i = 0; i < size_; i++) {
+        auto offset = pos;
+        uint64_t delta;
+        if (!read_varint(times, times_size, pos, delta)) return false;
+        // the first entry is stored as the absolute time
+        if (i > 0 && (delta == 0 || delta > std::numeric_limits<uint64_t>::max() - t)) {
+            return false;
+        }
+        t += delta;
+        if (i % checkpoint_interval == 0) {
+            auto const &checkpoint = checkpoints[i / checkpoint_interval];
+            if (checkpoint.offset != offset || checkpoint.time != t) return false;
+        }
+    }
+    return pos == times_size && (size_ == 0 || t == last_time_);
+}
+
+void VCDValueStore::add(uint64_t time, std::string_view value) {
+    if (size_ > 0 && time <= last_time_) return;
+    auto trimmed = trim_value(value);
+    // reused across calls to avoid allocations
+    thread_local std::vector<uint64_t> codes;
+    if (packed_ && !encode_value(trimmed, codes)) unpack();
+    // timestamps come in order. keep the first value if the time is duplicated
+    if (!add_time(time)) return;
+
+    if (packed_) {
+        if (trimmed.size() > width_) resize_width(trimmed.size());
+        auto index = size_;
+        bits_.resize((((index + 1) * width_ * 2) + 63) / 64, 0);
+        auto len = trimmed.size();
+        auto pos = index * width_ * 2;
+        for (uint64_t i = 0; i < codes.size(); i++) {
+            write_codes(pos + i * 64, codes[i], std::min<uint64_t>(32, len - i * 32));
+        }
+        auto ext = len > 0 ? extension_code(encode_bit(trimmed[0])) : code_0;
+        fill_codes(pos + len * 2, ext, width_ - len);
     } else {
-        return "";
+        strings_.emplace_back(trimmed);
     }
+    size_++;
+    fingerprint_ = fingerprint_ * fingerprint_multiplier + entry_hash(time, trimmed);
 }
 
-uint64_t VCDSignal::get_uint_value(uint64_t time) const {
-    std::string raw_value = get_value(time);
-    uint64_t bits = raw_value.size();
+void VCDValueStore::append(const VCDValueStore &other) {
+    if (other.empty()) return;
+    if (mapped_) materialize();
+    if (packed_ && !other.packed_) unpack();
+    if (packed_ && other.width_ > width_) resize_width(other.width_);
+
+    auto const *times = other.times_data();
+    uint64_t pos = 0, t = 0;
+    auto old_size = size_;
+    for (uint64_t i = 0; i < other.size_; i++) {
+        // the first entry is stored as the absolute time
+        t += read_varint(times, pos);
+        if (!add_time(t)) continue;
+        if (packed_) {
+            auto index = size_;
+            bits_.resize((((index + 1) * width_ * 2) + 63) / 64, 0);
+            copy_codes(index, other, i);
+        } else {
+            strings_.emplace_back(other.value(i));
+        }
+        size_++;
+    }
+    if (size_ - old_size == other.size_) {
+        fingerprint_ = fingerprint_ * fingerprint_power(other.size_) + other.fingerprint_;
+    } else {
+        // some entries are dropped, so the history has to be hashed again
+        compute_fingerprint();
+    }
+}
+
+uint64_t VCDValueStore::entry_fingerprint(uint64_t time, std::string_view value) {
+    return entry_hash(time, trim_value(value));
+}
+
+void VCDValueStore::compute_fingerprint() {
+    fingerprint_ = 0;
+    for (uint64_t i = 0; i < size_; i++) {
+        fingerprint_ = fingerprint_ * fingerprint_multiplier + entry_hash(time(i), value(i));
+    }
+}
+
+bool VCDValueStore::add_time(uint64_t time) {
+    if (size_ > 0 && time <= last_time_) return false;
+    if (mapped_) materialize();
+    if (size_ % checkpoint_interval == 0) {
+        checkpoints_.emplace_back(Checkpoint{time, times_.size()});
+    }
+    write_varint(times_, size_ > 0 ? time - last_time_ : time);
+    last_time_ = time;
+    return true;
+}
+
+uint64_t VCDValueStore::lower_bound(uint64_t time) const {
+    if (size_ == 0 || time > last_time_) return size_;
+    // find the block that may contain the time
+    auto const *checkpoints = checkpoints_data();
+    auto const *checkpoints_end = checkpoints + num_checkpoints();
+    auto const *it = std::upper_bound(
+        checkpoints, checkpoints_end, time,
+        [](uint64_t t, const Checkpoint &checkpoint) { return t < checkpoint.time; });
+    if (it == checkpoints) return 0;
+    it--;
+    auto block = static_cast<uint64_t>(std::distance(checkpoints, it));
+    auto index = block * checkpoint_interval;
+    auto pos = it->offset;
+    auto t = it->time;
+    if (t >= time) return index;
+    auto const *times = times_data();
+    read_varint(times, pos);
+    // the answer is at most in the first entry of the next block
+    for (index++; index < size_; index++) {
+        t += read_varint(times, pos);
+        if (t >= time) return index;
+    }
+    return size_;
+}
+
+void VCDValueStore::time_range(uint64_t begin, uint64_t end, std::vector<uint64_t> &result) const {
+    end = std::min(end, size_);
+    if (begin >= end) return;
+    auto const &checkpoint = checkpoints_data()[begin / checkpoint_interval];
+    auto const *times = times_data();
+    auto pos = checkpoint.offset;
+    auto t = checkpoint.time;
+    read_varint(times, pos);
+    for (auto index = begin - begin % checkpoint_interval; index < end; index++) {
+        if (index >= begin) result.emplace_back(t);
+        if (index + 1 < end) t += read_varint(times, pos);
+    }
+}
+
+std::optional<uint64_t> VCDValueStore::find(uint64_t time) const {
+    // fast path since we mostly query the latest timestamp during parsing
+    if (size_ == 0 || time > last_time_) return std::nullopt;
+    if (time == last_time_) return size_ - 1;
+    auto index = lower_bound(time);
+    if (index < size_ && this->time(index) == time) return index;
+    return std::nullopt;
+}
+
+uint64_t VCDValueStore::time(uint64_t index) const {
+    auto const &checkpoint = checkpoints_data()[index / checkpoint_interval];
+    auto const *times = times_data();
+    auto pos = checkpoint.offset;
+    auto t = checkpoint.time;
+    read_varint(times, pos);
+    for (uint64_t i = 0; i < index % checkpoint_interval; i++) {
+        t += read_varint(times, pos);
+    }
+    return t;
+}
+
+std::string VCDValueStore::value(uint64_t index) const {
+    if (!packed_) return strings_[index];
+    std::string result(width_, '0');
+    auto pos = index * width_ * 2;
+    for (uint64_t bit = 0; bit < width_; bit += 32) {
+        auto codes = read_codes(pos + bit * 2);
+        auto n = std::min<uint64_t>(32, width_ - bit);
+        // the string is filled from the end since it starts with the most significant bit
+        uint64_t k = 0;
+        for (; k + 4 <= n; k += 4) {
+            auto const &chars = code_chars[(codes >> (k * 2)) & 0xFF];
+            std::memcpy(result.data() + width_ - bit - k - 4, chars.data(), 4);
+        }
+        for (; k < n; k++) {
+            result[width_ - bit - k - 1] = decode_bit(codes >> (k * 2));
+        }
+    }
+    return std::string(trim_value(result));
+}
+
+uint64_t VCDValueStore::uint_value(uint64_t index) const {
+    if (!packed_) return 0;
     uint64_t result = 0;
-    for (uint64_t i = 0; i < bits; i++) {
-        auto bit = bits - i - 1;
-        char v = raw_value[i];
-        if (v == '1') {
-            result |= 1 << bit;
-        } else if (v == 'z' || v == 'x') {
+    auto pos = index * width_ * 2;
+    for (uint64_t bit = 0; bit < width_; bit += 32) {
+        auto n = std::min<uint64_t>(32, width_ - bit);
+        auto codes = read_codes(pos + bit * 2) & code_mask(n);
+        if (codes & 0xAAAAAAAAAAAAAAAAull) {
             // invalid value we display 0, which is consistent with Verilator
             return 0;
         }
+        if (bit < 64) result |= compress_bits(codes) << bit;
+    }
+    return result;
+}
+
+bool VCDValueStore::words_value(uint64_t index, uint64_t *words, uint64_t num_words) const {
+    if (!packed_) return false;
+    auto pos = index * width_ * 2;
+    for (uint64_t bit = 0; bit < width_; bit += 32) {
+        auto n = std::min<uint64_t>(32, width_ - bit);
+        auto codes = read_codes(pos + bit * 2) & code_mask(n);
+        if (codes & 0xAAAAAAAAAAAAAAAAull) {
+            std::fill(words, words + num_words, 0);
+            return false;
+        }
+        if (bit / 64 < num_words) words[bit / 64] |= compress_bits(codes) << (bit % 64);
+    }
+    return true;
+}
+
+bool VCDValueStore::value_equal(uint64_t index, std::string_view value) const {
+    auto trimmed = trim_value(value);
+    if (!packed_) return strings_[index] == trimmed;
+    if (trimmed.size() > width_) return false;
+    thread_local std::vector<uint64_t> codes;
+    if (!encode_value(trimmed, codes)) return false;
+    auto len = trimmed.size();
+    auto ext = len > 0 ? extension_code(encode_bit(trimmed[0])) : code_0;
+    auto pattern = 0x5555555555555555ull * ext;
+    auto pos = index * width_ * 2;
+    for (uint64_t bit = 0; bit < width_; bit += 32) {
+        auto n = std::min<uint64_t>(32, width_ - bit);
+        auto num_codes = bit < len ? std::min<uint64_t>(n, len - bit) : 0;
+        auto expected = bit < len ? codes[bit / 32] : 0;
+        expected |= pattern & code_mask(n) & ~code_mask(num_codes);
+        if ((read_codes(pos + bit * 2) & code_mask(n)) != expected) return false;
+    }
+    return true;
+}
+
+VCDValueStore VCDValueStore::slice(uint64_t count) const {
+    VCDValueStore result;
+    if (count >= size_) {
+        result = *this;
+        if (result.mapped_) result.materialize();
+        return result;
+    }
+    if (count == 0) return result;
+    result.size_ = count;
+    result.width_ = width_;
+    result.last_time_ = time(count - 1);
+    result.packed_ = packed_;
+    // compute where the varint of entry count starts
+    auto num_checkpoints = (count + checkpoint_interval - 1) / checkpoint_interval;
+    auto const *checkpoints = checkpoints_data();
+    result.checkpoints_ = std::vector(checkpoints, checkpoints + num_checkpoints);
+    auto const &last_checkpoint = result.checkpoints_.back();
+    auto const *times = times_data();
+    auto pos = last_checkpoint.offset;
+    auto remaining = count - (num_checkpoints - 1) * checkpoint_interval;
+    for (uint64_t i = 0; i < remaining; i++) read_varint(times, pos);
+    result.times_ = std::vector(times, times + pos);
+    if (packed_) {
+        auto words = (count * width_ * 2 + 63) / 64;
+        auto const *bits = bits_data();
+        result.bits_ = std::vector(bits, bits + words);
+        // clear out the bits that don't belong to the slice
+        auto used_bits = (count * width_ * 2) % 64;
+        if (used_bits) result.bits_.back() &= (1ull << used_bits) - 1;
+    } else {
+        result.strings_ = std::vector(strings_.begin(), strings_.begin() + count);
+    }
+    result.compute_fingerprint();
+    return result;
+}
+
+void VCDValueStore::pop_back() {
+    if (size_ == 0) return;
+    if (mapped_) materialize();
+    auto index = size_ - 1;
+    // the multiplier is odd, so the last step of the rolling hash can be undone
+    fingerprint_ = (fingerprint_ - entry_fingerprint(last_time_, value(index))) *
+                   fingerprint_inverse;
+    auto const &checkpoint = checkpoints_[index / checkpoint_interval];
+    auto pos = checkpoint.offset;
+    if (index % checkpoint_interval == 0) {
+        checkpoints_.pop_back();
+        last_time_ = index > 0 ? time(index - 1) : 0;
+    } else {
+        auto t = checkpoint.time;
+        read_varint(times_.data(), pos);
+        for (uint64_t i = 1; i < index % checkpoint_interval; i++) {
+            t += read_varint(times_.data(), pos);
+        }
+        last_time_ = t;
+    }
+    times_.resize(pos);
+    size_ = index;
+    if (packed_) {
+        bits_.resize((size_ * width_ * 2 + 63) / 64);
+        // codes are or-ed in, so the bits of the removed entry have to be cleared
+        auto used_bits = (size_ * width_ * 2) % 64;
+        if (used_bits) bits_.back() &= (1ull << used_bits) - 1;
+    } else {
+        strings_.pop_back();
+    }
+}
+
+bool VCDValueStore::same_values(const VCDValueStore &other) const {
+    if (size_ != other.size_) return false;
+    if (times_size() != other.times_size()) return false;
+    if (!std::equal(times_data(), times_data() + times_size(), other.times_data())) return false;
+    if (width_ != other.width_ || packed_ != other.packed_) {
+        // slices keep the width of the original store
+        for (uint64_t i = 0; i < size_; i++) {
+            if (value(i) != other.value(i)) return false;
+        }
+        return true;
+    }
+    if (packed_) {
+        auto words = (size_ * width_ * 2 + 63) / 64;
+        return std::equal(bits_data(), bits_data() + words, other.bits_data());
+    } else {
+        return strings_ == other.strings_;
+    }
+}
+
+void VCDValueStore::shrink_to_fit() {
+    times_.shrink_to_fit();
+    checkpoints_.shrink_to_fit();
+    bits_.shrink_to_fit();
+    strings_.shrink_to_fit();
+}
+
+uint64_t VCDValueStore::value_bytes() const {
+    if (packed_) return (size_ * width_ * 2 + 7) / 8;
+    uint64_t result = 0;
+    for (auto const &s : strings_) result += s.size();
+    return result;
+}
+
+uint64_t VCDValueStore::size_in_bytes() const {
+    uint64_t result = sizeof(VCDValueStore);
+    result += times_.capacity() * sizeof(uint8_t);
+    result += checkpoints_.capacity() * sizeof(Checkpoint);
+    result += bits_.capacity() * sizeof(uint64_t);
+    result += strings_.capacity() * sizeof(std::string);
+    for (auto const &s : strings_) {
+        // small strings are stored inline
+        if (s.capacity() > sizeof(std::string)) result += s.capacity();
+    }
+    return result;
+}
+
+uint8_t VCDValueStore::get_bit(uint64_t index, uint64_t bit) const {
+    auto pos = (index * width_ + bit) * 2;
+    return (bits_data()[pos / 64] >> (pos % 64)) & 0b11;
+}
+
+uint64_t VCDValueStore::code_mask(uint64_t count) {
+    return count >= 32 ? ~0ull : (1ull << (count * 2)) - 1;
+}
+
+uint64_t VCDValueStore::read_codes(uint64_t pos) const {
+    auto const *bits = bits_data();
+    auto word = pos / 64;
+    auto shift = pos % 64;
+    auto result = bits[word] >> shift;
+    if (shift && word + 1 < num_bits()) result |= bits[word + 1] << (64 - shift);
+    return result;
+}
+
+void VCDValueStore::write_codes(uint64_t pos, uint64_t codes, uint64_t count) {
+    // the target range is always zero, so we can just or the codes in
+    codes &= code_mask(count);
+    auto word = pos / 64;
+    auto shift = pos % 64;
+    bits_[word] |= codes << shift;
+    if (shift && shift + count * 2 > 64) bits_[word + 1] |= codes >> (64 - shift);
+}
+
+void VCDValueStore::fill_codes(uint64_t pos, uint8_t code, uint64_t count) {
+    if (code == code_0) return;
+    auto pattern = 0x5555555555555555ull * code;
+    for (uint64_t i = 0; i < count; i += 32) {
+        write_codes(pos + i * 2, pattern, std::min<uint64_t>(32, count - i));
+    }
+}
+
+void VCDValueStore::copy_codes(uint64_t index, const VCDValueStore &other, uint64_t other_index) {
+    auto src = other_index * other.width_ * 2;
+    auto dst = index * width_ * 2;
+    for (uint64_t bit = 0; bit < other.width_; bit += 32) {
+        write_codes(dst + bit * 2, other.read_codes(src + bit * 2),
+                    std::min<uint64_t>(32, other.width_ - bit));
+    }
+    auto ext = other.width_ > 0 ? extension_code(other.get_bit(other_index, other.width_ - 1))
+                                : code_0;
+    fill_codes(dst + other.width_ * 2, ext, width_ - other.width_);
+}
+
+void VCDValueStore::resize_width(uint64_t width) {
+    if (width <= width_) return;
+    if (width_ == 0) {
+        // entries without any bits extend with 0, which is what the zero-filled bits hold
+        width_ = width;
+        bits_.assign((size_ * width_ * 2 + 63) / 64, 0);
+        return;
+    }
+    // repack every entry into the new width. since the width only grows, this only happens a
+    // handful of times per signal
+    VCDValueStore old;
+    old.size_ = size_;
+    old.width_ = width_;
+    old.bits_ = std::move(bits_);
+    width_ = width;
+    bits_ = std::vector<uint64_t>((size_ * width_ * 2 + 63) / 64, 0);
+    for (uint64_t index = 0; index < size_; index++) {
+        copy_codes(index, old, index);
+    }
+}
+
+void VCDValueStore::materialize() {
+    // copy the mapped arrays so that the store can be modified
+    auto mapped = *mapped_;
+    times_ = std::vector(mapped.times, mapped.times + mapped.times_size);
+    checkpoints_ = std::vector(mapped.checkpoints, mapped.checkpoints + mapped.num_checkpoints);
+    bits_ = std::vector(mapped.bits, mapped.bits + mapped.num_bits);
+    mapped_ = std::nullopt;
+}
+
+void VCDValueStore::unpack() {
+    strings_.reserve(size_);
+    for (uint64_t index = 0; index < size_; index++) {
+        strings_.emplace_back(value(index));
+    }
+    packed_ = false;
+    bits_.clear();
+    bits_.shrink_to_fit();
+}
+
+std::string VCDSignal::get_value(uint64_t time) const {
+    auto store = values(time);
+    if (!store) return "";
+    auto index = store->lower_bound(time);
+    if (index < store->size()) {
+        return store->value(index);
+    } else {
+        return "";
+    }
+}
+
+uint64_t VCDSignal::get_uint_value(uint64_t time) const {
+    auto store = values(time);
+    if (!store) return 0;
+    auto index = store->lower_bound(time);
+    if (index < store->size()) {
+        return store->uint_value(index);
+    } else {
+        return 0;
+    }
+}
+
+std::vector<uint64_t> VCDSignal::get_wide_value(uint64_t time) const {
+    auto store = values(time);
+    std::vector<uint64_t> result(num_words(store.get()), 0);
+    if (!store) return result;
+    auto index = store->lower_bound(time);
+    if (index < store->size()) {
+        store->words_value(index, result.data(), result.size());
+    }
+    return result;
+}
+
+uint64_t VCDSignal::num_words(const VCDValueStore *store) const {
+    auto num_bits = std::max(width, store ? store->width() : 0);
+    return std::max<uint64_t>((num_bits + 63) / 64, 1);
+}
+
+// copies the values of the entries into samples
+void read_samples(const VCDValueStore &store, const std::vector<uint64_t> &indices,
+                  VCDSamples &samples) {
+    samples.values.resize(indices.size() * samples.num_words, 0);
+    for (uint64_t i = 0; i < indices.size(); i++) {
+        auto index = indices[i];
+        if (index >= store.size()) continue;
+        if (samples.num_words == 1) {
+            samples.values[i] = store.uint_value(index);
+        } else {
+            store.words_value(index, samples.values.data() + i * samples.num_words,
+                              samples.num_words);
+        }
+    }
+}
+
+VCDSamples VCDSignal::get_transitions(uint64_t t0, uint64_t t1) const {
+    VCDSamples result;
+    auto store = t0 < t1 ? values(t1 - 1) : nullptr;
+    result.num_words = num_words(store.get());
+    if (!store) return result;
+    auto begin = store->lower_bound(t0);
+    auto end = store->lower_bound(t1);
+    store->time_range(begin, end, result.times);
+    std::vector<uint64_t> indices(end - begin);
+    for (uint64_t i = 0; i < indices.size(); i++) indices[i] = begin + i;
+    read_samples(*store, indices, result);
+    return result;
+}
+
+VCDSamples VCDSignal::sample(const std::vector<uint64_t> &times) const {
+    VCDSamples result;
+    auto store = times.empty() ? nullptr : values(times.back());
+    result.num_words = num_words(store.get());
+    result.times = times;
+    if (!store || times.empty()) {
+        result.values.resize(times.size() * result.num_words, 0);
+        return result;
+    }
+    // same as calling get_value() on every time, but walks the entries only once
+    auto begin = store->lower_bound(times.front());
+    auto end = std::min(store->lower_bound(times.back()) + 1, store->size());
+    std::vector<uint64_t> entry_times;
+    store->time_range(begin, end, entry_times);
+    std::vector<uint64_t> indices(times.size());
+    uint64_t pos = 0;
+    for (uint64_t i = 0; i < times.size(); i++) {
+        while (pos < entry_times.size() && entry_times[pos] < times[i]) pos++;
+        indices[i] = begin + pos;
+    }
+    read_samples(*store, indices, result);
+    return result;
+}
+
+std::vector<uint64_t> VCDSignal::get_edges(uint64_t t0, uint64_t t1, bool posedge) const {
+    std::vector<uint64_t> result;
+    if (t0 >= t1) return result;
+    auto store = values(t1 - 1);
+    if (!store) return result;
+    auto begin = store->lower_bound(t0);
+    auto end = store->lower_bound(t1);
+    std::vector<uint64_t> times;
+    store->time_range(begin, end, times);
+    // the entry before the window tells us the initial state. x counts as neither 0 nor 1
+    auto target = posedge ? "1" : "0";
+    auto previous = begin > 0 ? store->value(begin - 1) : "x";
+    for (uint64_t i = 0; i < times.size(); i++) {
+        auto value = store->value(begin + i);
+        if (value == target && previous != target) result.emplace_back(times[i]);
+        previous = std::move(value);
+    }
+    return result;
+}
+
+std::shared_ptr<const VCDValueStore> VCDSignal::values(uint64_t time) const {
+    // stores that are never evicted are not owned by the pointer
+    if (raw_values || !db) return {std::shared_ptr<const VCDValueStore>(), raw_values};
+    return db->load_values({identifier}, time).front();
+}
+
+std::vector<std::shared_ptr<const VCDValueStore>> WaveformDatabase::get_values(
+    const std::vector<const VCDSignal *> &signals, uint64_t time) {
+    std::vector<std::shared_ptr<const VCDValueStore>> result(signals.size());
+    std::vector<std::string> identifiers;
+    for (uint64_t i = 0; i < signals.size(); i++) {
+        if (signals[i]->raw_values) {
+            result[i] = signals[i]->values(time);
+        } else {
+            identifiers.emplace_back(signals[i]->identifier);
+        }
+    }
+    if (identifiers.empty()) return result;
+    auto loaded = load_values(identifiers, time);
+    for (uint64_t i = 0, pos = 0; i < signals.size(); i++) {
+        if (!signals[i]->raw_values) result[i] = std::move(loaded[pos++]);
     }
     return result;
 }
@@ -38,11 +828,761 @@ std::string get_path_name(const std::vector<std::string> &hierarchy, const std::
     return fmt::format("{0}.{1}", fmt::join(hierarchy.begin(), hierarchy.end(), "."), name);
 }
 
-VCDDatabase::VCDDatabase(const std::string &filename) {
+// binary sidecar that holds the parsed database. the header and directories are small and read
+// eagerly, while the value arrays are left in the mapped file and only paged in when a signal
+// is accessed. all sections are 8-byte aligned
+class VCDIndex {
+public:
+    static bool save(const VCDDatabase &db, const std::string &source, const std::string &filename);
+    static bool load(VCDDatabase &db, const std::string &source, const std::string &filename);
+
+private:
+    static constexpr std::array<char, 8> magic = {'O', 'O', 'Z', 'E', 'V', 'C', 'D', '\0'};
+    static constexpr uint64_t version = 2;
+    static constexpr uint64_t no_store = std::numeric_limits<uint64_t>::max();
+
+    struct Header {
+        std::array<char, 8> magic;
+        uint64_t version;
+        uint64_t source_size;
+        uint64_t source_mtime;
+        uint64_t num_times;
+        uint64_t num_stores;
+        uint64_t num_signals;
+        uint64_t strings_size;
+    };
+
+    struct StringRef {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct StoreEntry {
+        StringRef identifier;
+        uint64_t size;
+        uint64_t width;
+        uint64_t last_time;
+        uint64_t packed;
+        uint64_t times_offset;
+        uint64_t times_size;
+        uint64_t checkpoints_offset;
+        uint64_t num_checkpoints;
+        uint64_t bits_offset;
+        uint64_t num_bits;
+        // only used by stores that are not 4-state. points to an array of StringRef
+        uint64_t strings_offset;
+        uint64_t num_strings;
+    };
+
+    struct SignalEntry {
+        StringRef identifier;
+        StringRef path;
+        StringRef name;
+        uint64_t store;
+        uint64_t width;
+    };
+};
+
+class StringPool {
+public:
+    auto add(const std::string &str) {
+        auto offset = data.size();
+        data.insert(data.end(), str.begin(), str.end());
+        return std::make_pair(offset, str.size());
+    }
+    std::vector<char> data;
+};
+
+bool VCDIndex::save(const VCDDatabase &db, const std::string &source,
+                    const std::string &filename) {
+    util::FileStamp stamp;
+    if (!util::get_file_stamp(source, stamp)) return false;
+
+    StringPool pool;
+    // assign store indices so that signals can refer to them
+    std::vector<std::pair<const std::string *, const VCDValueStore *>> stores;
+    std::unordered_map<const VCDValueStore *, uint64_t> store_indices;
+    stores.reserve(db.values.size());
+    for (auto const &[id, store] : db.values) {
+        store_indices.emplace(&store, stores.size());
+        stores.emplace_back(&id, &store);
+    }
+
+    std::vector<StoreEntry> store_entries;
+    std::vector<std::vector<StringRef>> store_strings;
+    store_entries.reserve(stores.size());
+    // data section is after the directories and the string pool. compute their offsets first
+    uint64_t data_size = 0;
+    for (auto const &[id, store] : stores) {
+        StoreEntry entry{};
+        auto [id_offset, id_size] = pool.add(*id);
+        entry.identifier = {id_offset, id_size};
+        entry.size = store->size_;
+        entry.width = store->width_;
+        entry.last_time = store->last_time_;
+        entry.packed = store->packed_;
+        entry.times_size = store->times_.size();
+        entry.num_checkpoints = store->checkpoints_.size();
+        entry.num_bits = store->bits_.size();
+        entry.times_offset = data_size;
+        data_size += util::align(entry.times_size);
+        entry.checkpoints_offset = data_size;
+        data_size += entry.num_checkpoints * sizeof(VCDValueStore::Checkpoint);
+        entry.bits_offset = data_size;
+        data_size += entry.num_bits * sizeof(uint64_t);
+        std::vector<StringRef> strings;
+        for (auto const &str : store->strings_) {
+            auto [offset, size] = pool.add(str);
+            strings.emplace_back(StringRef{offset, size});
+        }
+        entry.strings_offset = data_size;
+        entry.num_strings = strings.size();
+        data_size += strings.size() * sizeof(StringRef);
+        store_entries.emplace_back(entry);
+        store_strings.emplace_back(std::move(strings));
+    }
+
+    std::vector<SignalEntry> signal_entries;
+    signal_entries.reserve(db.signals.size());
+    for (auto const &[path, signal] : db.signals) {
+        SignalEntry entry{};
+        auto [id_offset, id_size] = pool.add(signal->identifier);
+        entry.identifier = {id_offset, id_size};
+        auto [path_offset, path_size] = pool.add(signal->path);
+        entry.path = {path_offset, path_size};
+        auto [name_offset, name_size] = pool.add(signal->name);
+        entry.name = {name_offset, name_size};
+        entry.store = signal->raw_values ? store_indices.at(signal->raw_values) : no_store;
+        entry.width = signal->width;
+        signal_entries.emplace_back(entry);
+    }
+
+    Header header{};
+    header.magic = magic;
+    header.version = version;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.num_times = db.times.size();
+    header.num_stores = store_entries.size();
+    header.num_signals = signal_entries.size();
+    header.strings_size = pool.data.size();
+
+    util::SectionWriter writer(filename);
+    if (!writer.good()) return false;
+    writer.write(&header, 1);
+    std::vector<uint64_t> times(db.times.begin(), db.times.end());
+    writer.write(times.data(), times.size());
+    writer.write(store_entries.data(), store_entries.size());
+    writer.write(signal_entries.data(), signal_entries.size());
+    writer.write(pool.data.data(), pool.data.size());
+    for (uint64_t i = 0; i < stores.size(); i++) {
+        auto const *store = stores[i].second;
+        writer.write(store->times_.data(), store->times_.size());
+        writer.write(store->checkpoints_.data(), store->checkpoints_.size());
+        writer.write(store->bits_.data(), store->bits_.size());
+        writer.write(store_strings[i].data(), store_strings[i].size());
+    }
+    return writer.commit();
+}
+
+bool VCDIndex::load(VCDDatabase &db, const std::string &source, const std::string &filename) {
+    util::FileStamp stamp;
+    if (!util::get_file_stamp(source, stamp)) return false;
+    auto file = std::make_unique<util::MappedFile>(filename);
+    if (!file->is_open() || file->size() < sizeof(Header)) return false;
+    auto const *base = file->data();
+    auto const file_size = file->size();
+    auto const &header = *reinterpret_cast<const Header *>(base);
+    if (header.magic != magic || header.version != version) return false;
+    if (header.source_size != stamp.size || header.source_mtime != stamp.mtime) return false;
+
+    // the value arrays take the rest of the file after the directories and the string pool
+    util::SectionReader reader(file_size, sizeof(Header));
+    auto const times_offset = reader.next(header.num_times, sizeof(uint64_t));
+    auto const stores_offset = reader.next(header.num_stores, sizeof(StoreEntry));
+    auto const signals_offset = reader.next(header.num_signals, sizeof(SignalEntry));
+    auto const strings_offset = reader.next(header.strings_size, 1);
+    if (!reader.valid()) return false;
+    auto const data_offset = reader.pos();
+    auto const data_size = file_size - data_offset;
+    auto const *data = base + data_offset;
+
+    // arrays of 8-byte words are written at aligned offsets
+    auto in_data = [data_size](uint64_t offset, uint64_t count, uint64_t element_size) {
+        if (element_size % 8 == 0 && offset % 8 != 0) return false;
+        return offset <= data_size && count <= (data_size - offset) / element_size;
+    };
+    auto get_string = [&](const StringRef &ref, std::string &result) {
+        if (ref.offset > header.strings_size || ref.size > header.strings_size - ref.offset) {
+            return false;
+        }
+        result = std::string(base + strings_offset + ref.offset, ref.size);
+        return true;
+    };
+
+    auto const *times = reinterpret_cast<const uint64_t *>(base + times_offset);
+    for (uint64_t i = 0; i < header.num_times; i++) {
+        db.times.emplace_hint(db.times.end(), times[i]);
+    }
+
+    auto const *store_entries = reinterpret_cast<const StoreEntry *>(base + stores_offset);
+    std::vector<VCDValueStore *> stores(header.num_stores, nullptr);
+    for (uint64_t i = 0; i < header.num_stores; i++) {
+        auto const &entry = store_entries[i];
+        std::string identifier;
+        if (!get_string(entry.identifier, identifier)) return false;
+        if (!in_data(entry.times_offset, entry.times_size, 1) ||
+            !in_data(entry.checkpoints_offset, entry.num_checkpoints,
+                     sizeof(VCDValueStore::Checkpoint)) ||
+            !in_data(entry.bits_offset, entry.num_bits, sizeof(uint64_t)) ||
+            !in_data(entry.strings_offset, entry.num_strings, sizeof(StringRef))) {
+            return false;
+        }
+        // the counts have to agree with each other, otherwise accessors read past the arrays.
+        // every entry takes at least one varint byte and a checkpoint starts every block
+        auto interval = VCDValueStore::checkpoint_interval;
+        if (entry.size > entry.times_size ||
+            entry.num_checkpoints != (entry.size + interval - 1) / interval) {
+            return false;
+        }
+        if (entry.packed) {
+            // 2 bits per bit of every entry, without overflowing the product
+            auto max_codes = entry.num_bits * 32;
+            if (entry.num_bits > std::numeric_limits<uint64_t>::max() / 32 ||
+                (entry.width > 0 && entry.size > max_codes / entry.width) ||
+                entry.num_strings != 0) {
+                return false;
+            }
+        } else if (entry.num_strings != entry.size || entry.num_bits != 0) {
+            return false;
+        }
+        auto &store = db.values[identifier];
+        store.size_ = entry.size;
+        store.width_ = entry.width;
+        store.last_time_ = entry.last_time;
+        store.packed_ = entry.packed;
+        store.mapped_ = VCDValueStore::MappedData{
+            reinterpret_cast<const uint8_t *>(data + entry.times_offset), entry.times_size,
+            reinterpret_cast<const VCDValueStore::Checkpoint *>(data + entry.checkpoints_offset),
+            entry.num_checkpoints, reinterpret_cast<const uint64_t *>(data + entry.bits_offset),
+            entry.num_bits};
+        if (!store.check_mapped_times()) return false;
+        // strings are rare and small, so we just copy them
+        auto const *strings = reinterpret_cast<const StringRef *>(data + entry.strings_offset);
+        store.strings_.resize(entry.num_strings);
+        for (uint64_t j = 0; j < entry.num_strings; j++) {
+            if (!get_string(strings[j], store.strings_[j])) return false;
+        }
+        stores[i] = &store;
+    }
+
+    auto const *signal_entries = reinterpret_cast<const SignalEntry *>(base + signals_offset);
+    for (uint64_t i = 0; i < header.num_signals; i++) {
+        auto const &entry = signal_entries[i];
+        auto signal = std::make_shared<VCDSignal>();
+        if (!get_string(entry.identifier, signal->identifier) ||
+            !get_string(entry.path, signal->path) || !get_string(entry.name, signal->name)) {
+            return false;
+        }
+        if (entry.store != no_store && entry.store >= stores.size()) return false;
+        signal->raw_values = entry.store == no_store ? nullptr : stores[entry.store];
+        signal->width = entry.width;
+        signal->db = &db;
+        db.signals.emplace(signal->path, signal);
+    }
+
+    db.mapped_file_ = std::move(file);
+    return true;
+}
+
+// minimal VCD scanner that works directly on a byte range of a memory mapped file. used when
+// we need to parse parts of the file independently
+class VCDScanner {
+public:
+    VCDScanner(const char *begin, const char *end) : pos_(begin), end_(end) {}
+
+    bool next(std::string_view &token) {
+        while (pos_ < end_ && std::isspace(static_cast<unsigned char>(*pos_))) pos_++;
+        if (pos_ == end_) return false;
+        auto const *start = pos_;
+        while (pos_ < end_ && !std::isspace(static_cast<unsigned char>(*pos_))) pos_++;
+        token = std::string_view(start, pos_ - start);
+        return true;
+    }
+
+    // skip everything until $end
+    void skip_command() {
+        std::string_view token;
+        while (next(token) && token != "$end") {
+        }
+    }
+
+    [[nodiscard]] const char *pos() const { return pos_; }
+
+private:
+    const char *pos_;
+    const char *end_;
+};
+
+// parses the definitions. returns the position where value changes start or nullptr if the
+// header is malformed
+template <typename F>
+const char *scan_header(const char *begin, const char *end, F on_var) {
+    VCDScanner scanner(begin, end);
+    std::vector<std::string> hierarchy;
+    std::string_view token;
+    while (scanner.next(token)) {
+        if (token == "$scope") {
+            std::string_view type, name;
+            if (!scanner.next(type) || !scanner.next(name)) return nullptr;
+            hierarchy.emplace_back(name);
+            scanner.skip_command();
+        } else if (token == "$upscope") {
+            if (hierarchy.empty()) return nullptr;
+            hierarchy.pop_back();
+            scanner.skip_command();
+        } else if (token == "$var") {
+            std::string_view type, width, identifier, name;
+            if (!scanner.next(type) || !scanner.next(width) || !scanner.next(identifier) ||
+                !scanner.next(name)) {
+                return nullptr;
+            }
+            uint64_t var_width = 0;
+            std::from_chars(width.data(), width.data() + width.size(), var_width);
+            on_var(get_path_name(hierarchy, std::string(name)), name, identifier, var_width);
+            scanner.skip_command();
+        } else if (token == "$enddefinitions") {
+            scanner.skip_command();
+            return scanner.pos();
+        } else if (token.starts_with('$')) {
+            scanner.skip_command();
+        }
+    }
+    return nullptr;
+}
+
+// parses value changes. the range has to start at a timestamp boundary
+template <typename T, typename V>
+void scan_value_changes(const char *begin, const char *end, uint64_t time, T on_time,
+                        V on_value) {
+    VCDScanner scanner(begin, end);
+    std::string_view token;
+    while (scanner.next(token)) {
+        auto c = token[0];
+        switch (c) {
+            case '#': {
+                std::from_chars(token.data() + 1, token.data() + token.size(), time);
+                on_time(time);
+                break;
+            }
+            case '$': {
+                // $dumpvars and friends contain value changes. only comments need to be skipped
+                if (token == "$comment") scanner.skip_command();
+                break;
+            }
+            case 'b':
+            case 'B':
+            case 'r':
+            case 'R':
+            case 's':
+            case 'S': {
+                std::string_view identifier;
+                if (!scanner.next(identifier)) return;
+                on_value(time, identifier, token.substr(1));
+                break;
+            }
+            default: {
+                // scalar value
+                on_value(time, token.substr(1), token.substr(0, 1));
+                break;
+            }
+        }
+    }
+}
+
+// comments are the only place where a line may look like a timestamp. returns the end of the
+// comment pos is in or pos itself if it's not in one. begin has to be outside of a comment
+const char *skip_comment(const char *begin, const char *pos, const char *end) {
+    std::string_view range(begin, pos - begin);
+    while (true) {
+        auto i = range.rfind('$');
+        if (i == std::string_view::npos) return pos;
+        if (i == 0 || std::isspace(static_cast<unsigned char>(range[i - 1]))) {
+            VCDScanner scanner(begin + i, end);
+            std::string_view token;
+            scanner.next(token);
+            if (token == "$end") return pos;
+            if (token == "$comment") {
+                scanner.skip_command();
+                return scanner.pos();
+            }
+        }
+        range = range.substr(0, i);
+    }
+}
+
+// split the value changes into chunks that start with a timestamp
+std::vector<std::pair<const char *, const char *>> split_value_changes(const char *begin,
+                                                                      const char *end,
+                                                                      uint64_t num_chunks) {
+    std::vector<std::pair<const char *, const char *>> result;
+    auto size = static_cast<uint64_t>(end - begin);
+    auto const *start = begin;
+    for (uint64_t i = 1; i < num_chunks && start < end; i++) {
+        auto const *pos = std::max(start, begin + size * i / num_chunks);
+        // timestamps always start at a new line. lines in comments may look the same
+        while (pos < end) {
+            pos = std::find(pos, end, '\n');
+            if (pos == end) break;
+            pos++;
+            if (pos < end && *pos == '#') {
+                auto const *comment_end = skip_comment(start, pos, end);
+                if (comment_end == pos) break;
+                pos = comment_end;
+            }
+        }
+        if (pos >= end) break;
+        result.emplace_back(start, pos);
+        start = pos;
+    }
+    result.emplace_back(start, end);
+    return result;
+}
+
+VCDDatabase::VCDDatabase(const std::string &filename, const VCDOptions &options) {
+    if (options.lazy) {
+        // nothing is decoded up front, so there is nothing worth caching in an index either
+        max_decoded_ = options.max_decoded_signals;
+        auto num_threads = util::get_num_threads(options.num_threads);
+        if (num_threads > 1) pool_ = std::make_unique<util::ThreadPool>(num_threads);
+        parse_lazy(filename);
+        return;
+    }
+    if (options.use_index) {
+        auto index_file = index_filename(filename);
+        if (VCDIndex::load(*this, filename, index_file)) return;
+        // index is invalid. start over
+        signals.clear();
+        times.clear();
+        values.clear();
+    }
+    auto num_threads = util::get_num_threads(options.num_threads);
+    auto parsed = num_threads > 1 ? parse_parallel(filename, num_threads) : parse(filename);
+    if (!parsed) return;
+    if (options.use_index) {
+        // failing to write the index is not an error, we just parse it again next time
+        VCDIndex::save(*this, filename, index_filename(filename));
+    }
+}
+
+bool VCDDatabase::parse_parallel(const std::string &filename, uint64_t num_threads) {
+    util::MappedFile file(filename);
+    if (!file.is_open()) return false;
+    auto const *begin = file.data();
+    auto const *end = begin + file.size();
+
+    // definitions are small so we parse them on a single thread
+    std::unordered_map<std::string_view, uint64_t> identifiers;
+    std::vector<std::string> identifier_names;
+    std::vector<std::vector<VCDSignal *>> identifier_signals;
+    auto const *body = scan_header(
+        begin, end,
+        [&, this](const std::string &path, std::string_view name, std::string_view identifier,
+                  uint64_t width) {
+            auto signal = std::make_shared<VCDSignal>();
+            signal->identifier = identifier;
+            signal->path = path;
+            signal->name = name;
+            signal->width = width;
+            signal->db = this;
+            signal->raw_values = nullptr;
+            signals.emplace(path, signal);
+            auto [it, inserted] = identifiers.emplace(identifier, identifier_names.size());
+            if (inserted) {
+                identifier_names.emplace_back(identifier);
+                identifier_signals.emplace_back();
+            }
+            identifier_signals[it->second].emplace_back(signal.get());
+        });
+    if (!body) return false;
+
+    // each chunk is tokenized and decoded independently into its own stores
+    struct Chunk {
+        std::vector<uint64_t> times;
+        std::unordered_map<uint64_t, VCDValueStore> values;
+    };
+    util::ThreadPool pool(num_threads);
+    auto ranges = split_value_changes(body, end, num_threads);
+    std::vector<Chunk> chunks(ranges.size());
+    util::parallel_for(pool, ranges.size(), [&](uint64_t i) {
+        auto &chunk = chunks[i];
+        auto [chunk_begin, chunk_end] = ranges[i];
+        scan_value_changes(
+            chunk_begin, chunk_end, 0, [&chunk](uint64_t time) { chunk.times.emplace_back(time); },
+            [&chunk, &identifiers](uint64_t time, std::string_view identifier,
+                                   std::string_view value) {
+                auto it = identifiers.find(identifier);
+                // ignore undefined identifiers
+                if (it == identifiers.end()) return;
+                chunk.values[it->second].add(time, value);
+            });
+    });
+
+    for (auto const &chunk : chunks) {
+        for (auto t : chunk.times) times.emplace_hint(times.end(), t);
+    }
+
+    // merge the per-chunk arrays in order
+    std::vector<VCDValueStore> stores(identifier_names.size());
+    util::parallel_for(pool, stores.size(), [&](uint64_t id) {
+        auto &store = stores[id];
+        for (auto &chunk : chunks) {
+            auto it = chunk.values.find(id);
+            if (it == chunk.values.end()) continue;
+            if (store.empty()) {
+                store = std::move(it->second);
+            } else {
+                store.append(it->second);
+            }
+        }
+    });
+    chunks.clear();
+
+    alias_values(identifier_names, stores, identifier_signals);
+
+    return true;
+}
+
+bool VCDDatabase::parse_lazy(const std::string &filename) {
+    auto file = std::make_unique<util::MappedFile>(filename);
+    if (!file->is_open()) return false;
+    auto const *begin = file->data();
+    auto const *end = begin + file->size();
+
+    std::unordered_set<std::string_view> identifiers;
+    auto const *body = scan_header(
+        begin, end,
+        [&, this](const std::string &path, std::string_view name, std::string_view identifier,
+                  uint64_t width) {
+            auto signal = std::make_shared<VCDSignal>();
+            signal->identifier = identifier;
+            signal->path = path;
+            signal->name = name;
+            signal->width = width;
+            signal->db = this;
+            signal->raw_values = nullptr;
+            signals.emplace(path, signal);
+            identifiers.emplace(identifier);
+        });
+    if (!body) return false;
+    num_identifiers_ = identifiers.size();
+    segments_.emplace_back(0, body - begin);
+
+    // timestamps always start at a new line. the last timestamp bounds the search for comments
+    auto const *pos = body;
+    auto const *last_time = body;
+    while (pos < end) {
+        if (*pos == '#') pos = skip_comment(last_time, pos, end);
+        if (pos < end && *pos == '#') {
+            last_time = pos;
+            uint64_t time = 0;
+            std::from_chars(pos + 1, end, time);
+            auto offset = static_cast<uint64_t>(pos - begin);
+            if (offset - segments_.back().second >= lazy_segment_size) {
+                segments_.emplace_back(time, offset);
+            }
+            times.emplace_hint(times.end(), time);
+        }
+        pos = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+        if (!pos) break;
+        pos++;
+    }
+
+    source_file_ = std::move(file);
+    return true;
+}
+
+std::vector<std::shared_ptr<const VCDValueStore>> VCDDatabase::load_values(
+    const std::vector<std::string> &identifiers, uint64_t time) {
+    std::vector<std::shared_ptr<const VCDValueStore>> result(identifiers.size());
+    if (!is_lazy()) return result;
+
+    // identifiers that are not decoded far enough. the lock is not held while decoding, so other
+    // threads can keep reading decoded stores
+    std::unordered_map<std::string_view, uint64_t> missing;
+    std::vector<DecodedValues> pending;
+    {
+        std::lock_guard lock(decoded_mutex_);
+        for (uint64_t i = 0; i < identifiers.size(); i++) {
+            auto it = decoded_values_.find(identifiers[i]);
+            if (it != decoded_values_.end()) {
+                decoded_.splice(decoded_.begin(), decoded_, it->second.pos);
+                if (covers(it->second.store.get(), it->second.num_segments, time)) {
+                    result[i] = it->second.store;
+                    continue;
+                }
+            }
+            auto [pos, inserted] = missing.emplace(identifiers[i], pending.size());
+            if (inserted) {
+                pending.emplace_back(it == decoded_values_.end() ? DecodedValues{} : it->second);
+            }
+        }
+        // stores that were pinned before may be released by now
+        evict_values();
+    }
+    if (missing.empty()) return result;
+
+    decode_values(missing, pending, time);
+    std::lock_guard lock(decoded_mutex_);
+    for (uint64_t i = 0; i < identifiers.size(); i++) {
+        if (result[i]) continue;
+        auto const &identifier = identifiers[i];
+        auto &decoded = pending[missing.at(identifier)];
+        auto it = decoded_values_.find(identifier);
+        if (it == decoded_values_.end()) {
+            decoded_.emplace_front(identifier);
+            decoded.pos = decoded_.begin();
+            it = decoded_values_.emplace(identifier, decoded).first;
+        } else {
+            // another thread may have decoded further in the meantime
+            decoded_.splice(decoded_.begin(), decoded_, it->second.pos);
+            if (it->second.num_segments < decoded.num_segments) {
+                it->second.store = decoded.store;
+                it->second.num_segments = decoded.num_segments;
+            }
+        }
+        result[i] = it->second.store;
+    }
+    evict_values();
+    return result;
+}
+
+bool VCDDatabase::covers(const VCDValueStore *store, uint64_t num_segments,
+                         uint64_t time) const {
+    if (num_segments == segments_.size()) return true;
+    // every change up to time is decoded once the next segment starts after it. the first change
+    // at or after time is needed as well, see VCDValueStore::lower_bound()
+    return segments_[num_segments].first > time && store && !store->empty() &&
+           store->time(store->size() - 1) >= time;
+}
+
+void VCDDatabase::decode_values(const std::unordered_map<std::string_view, uint64_t> &identifiers,
+                                std::vector<DecodedValues> &decoded, uint64_t time) {
+    num_scans_++;
+    auto const *begin = source_file_->data();
+    auto const num_segments = segments_.size();
+    auto segment_end = [&, this](uint64_t segment) {
+        return segment + 1 < num_segments ? begin + segments_[segment + 1].second
+                                          : begin + source_file_->size();
+    };
+
+    // every identifier continues from where its store ends. extending copies the store, so at
+    // least as many segments as before are decoded at once
+    std::vector<VCDValueStore> stores(decoded.size());
+    uint64_t first = num_segments, min_end = 0;
+    for (uint64_t i = 0; i < decoded.size(); i++) {
+        if (decoded[i].store) stores[i] = *decoded[i].store;
+        first = std::min(first, decoded[i].num_segments);
+        min_end = std::max(min_end, decoded[i].num_segments * 2);
+    }
+    min_end = std::min(min_end, num_segments);
+    auto all_covered = [&, this]() {
+        for (uint64_t i = 0; i < decoded.size(); i++) {
+            if (!covers(&stores[i], decoded[i].num_segments, time)) return false;
+        }
+        return true;
+    };
+
+    // segments are decoded in rounds, one segment per thread, and concatenated in order
+    auto round_size = pool_ ? pool_->size() : 1;
+    for (auto end = first; end < num_segments && (end < min_end || !all_covered());) {
+        auto next = std::min(num_segments, std::max(end + round_size, min_end));
+        std::vector<std::vector<VCDValueStore>> chunks(next - end);
+        auto decode = [&, this](uint64_t i) {
+            auto segment = end + i;
+            auto &chunk = chunks[i];
+            chunk.resize(decoded.size());
+            scan_value_changes(
+                begin + segments_[segment].second, segment_end(segment), 0, [](uint64_t) {},
+                [&](uint64_t t, std::string_view id, std::string_view value) {
+                    auto it = identifiers.find(id);
+                    if (it == identifiers.end() || decoded[it->second].num_segments > segment) {
+                        return;
+                    }
+                    chunk[it->second].add(t, value);
+                });
+        };
+        if (pool_ && chunks.size() > 1) {
+            util::parallel_for(*pool_, chunks.size(), decode);
+        } else {
+            for (uint64_t i = 0; i < chunks.size(); i++) decode(i);
+        }
+        for (uint64_t id = 0; id < stores.size(); id++) {
+            if (decoded[id].num_segments >= next) continue;
+            for (auto &chunk : chunks) {
+                if (stores[id].empty()) {
+                    stores[id] = std::move(chunk[id]);
+                } else {
+                    stores[id].append(chunk[id]);
+                }
+            }
+            decoded[id].num_segments = next;
+        }
+        end = next;
+    }
+
+    for (uint64_t i = 0; i < decoded.size(); i++) {
+        stores[i].shrink_to_fit();
+        decoded[i].store = std::make_shared<const VCDValueStore>(std::move(stores[i]));
+    }
+}
+
+void VCDDatabase::evict_values() {
+    // least recently used first. stores that are still held by a caller would only be decoded
+    // again, so they are kept
+    auto pos = decoded_.end();
+    while (max_decoded_ > 0 && decoded_values_.size() > max_decoded_ && pos != decoded_.begin()) {
+        pos--;
+        auto it = decoded_values_.find(*pos);
+        if (it->second.store.use_count() > 1) continue;
+        decoded_values_.erase(it);
+        pos = decoded_.erase(pos);
+    }
+}
+
+std::string VCDDatabase::index_filename(const std::string &filename) {
+    return filename + ".ooze";
+}
+
+void FingerprintIndex::update(const std::string &identifier, uint64_t old_fingerprint,
+                              uint64_t new_fingerprint) {
+    remove(identifier, old_fingerprint);
+    buckets_[new_fingerprint].emplace_back(identifier);
+}
+
+void FingerprintIndex::remove(const std::string &identifier, uint64_t fingerprint) {
+    auto it = buckets_.find(fingerprint);
+    if (it == buckets_.end()) return;
+    auto &bucket = it->second;
+    auto pos = std::find(bucket.begin(), bucket.end(), identifier);
+    if (pos == bucket.end()) return;
+    // order within a bucket doesn't matter
+    *pos = std::move(bucket.back());
+    bucket.pop_back();
+    if (bucket.empty()) buckets_.erase(it);
+}
+
+const std::vector<std::string> &FingerprintIndex::find(uint64_t fingerprint) const {
+    static const std::vector<std::string> empty;
+    auto it = buckets_.find(fingerprint);
+    return it == buckets_.end() ? empty : it->second;
+}
+
+bool VCDDatabase::parse(const std::string &filename) {
     // need to parse the file here
     VCDParser parser(filename);
     if (parser.has_error()) {
-        return;
+        return false;
     }
     std::vector<std::string> hierarchy;
     // set callbacks
@@ -58,6 +1598,8 @@ VCDDatabase::VCDDatabase(const std::string &filename) {
     std::unordered_map<std::string, VCDSignal *> identifier_signal_mapping;
     // how many times has an identifier value changed
     std::unordered_map<std::string, uint64_t> vcd_count;
+    // used to look up stores with the same value history
+    FingerprintIndex fingerprints;
 
     parser.set_on_var_def([&hierarchy, &identifier_signal_mapping, this](const VCDVarDef &def) {
         // need to compute path
@@ -66,6 +1608,7 @@ VCDDatabase::VCDDatabase(const std::string &filename) {
         signal->identifier = def.identifier;
         signal->path = path;
         signal->name = def.name;
+        signal->width = def.width;
         signal->db = this;
         signal->raw_values = nullptr;
         signals.emplace(path, signal);
@@ -73,38 +1616,47 @@ VCDDatabase::VCDDatabase(const std::string &filename) {
     });
 
     parser.set_value_change([&identifier_mapping, &seen_identifiers, &identifier_signal_mapping,
-                             &vcd_count, this](const VCDValue &value) {
-        alias_signal(identifier_mapping, seen_identifiers, identifier_signal_mapping, value);
+                             &vcd_count, &fingerprints, this](const VCDValue &value) {
+        alias_signal(identifier_mapping, seen_identifiers, identifier_signal_mapping, fingerprints,
+                     value);
         if (vcd_count.find(value.identifier) == vcd_count.end())
             vcd_count.emplace(value.identifier, 0);
         vcd_count[value.identifier]++;
     });
 
-    parser.set_on_time_change(
-        [&vcd_count, &identifier_mapping, &identifier_signal_mapping, this](uint64_t time) {
-            times.emplace(time);
-            de_alias_signal(vcd_count, identifier_mapping, identifier_signal_mapping);
-        });
+    parser.set_on_time_change([&vcd_count, &identifier_mapping, &identifier_signal_mapping,
+                               &fingerprints, this](uint64_t time) {
+        times.emplace(time);
+        de_alias_signal(vcd_count, identifier_mapping, identifier_signal_mapping, fingerprints);
+    });
 
     parser.parse();
+
+    for (auto &[id, store] : values) {
+        store.shrink_to_fit();
+    }
+    return true;
 }
 
 void VCDDatabase::alias_signal(
     std::unordered_map<std::string, std::string> &identifier_mapping,
     std::unordered_set<std::string> &seen_identifiers,
     std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping,
-    const VCDValue &value) {
+    FingerprintIndex &fingerprints, const VCDValue &value) {
     // need to figure out whether the signals should be aliased
     // this is best-effort as we will resolve it later
-    std::string identifier = find_identifier(identifier_mapping, value);
+    std::string identifier = find_identifier(identifier_mapping, fingerprints, value);
 
     auto &values_ = values[identifier];
     auto *sig = identifier_signal_mapping.at(value.identifier);
     sig->raw_values = &values_;
 
     // check if the time exists or not
-    if (values_.find(value.time) == values_.end()) {
-        values_.emplace(value.time, value.value);
+    auto existing = values_.find(value.time);
+    if (!existing) {
+        auto fingerprint = values_.fingerprint();
+        values_.add(value.time, value.value);
+        fingerprints.update(identifier, fingerprint, values_.fingerprint());
         seen_identifiers.emplace(value.identifier);
         return;
     }
@@ -116,10 +1668,10 @@ void VCDDatabase::alias_signal(
     bool should_alias = true;
     if (seen_identifiers.find(value.identifier) == seen_identifiers.end()) {
         if (values_.size() > 1) should_alias = false;
-        if (values_.size() == 1 && values_.begin()->first != value.time) should_alias = false;
+        if (values_.size() == 1 && values_.time(0) != value.time) should_alias = false;
     }
     if (should_alias) {
-        if (values_.find(value.time) != values_.end() && values_.at(value.time) != value.value) {
+        if (!values_.value_equal(*existing, value.value)) {
             should_alias = false;
         }
     }
@@ -131,16 +1683,20 @@ void VCDDatabase::alias_signal(
     }
 
     // copy any values from the values < the current time
-    for (auto const &[t, v] : values_) {
-        if (t < value.time) values[value.identifier].emplace(t, v);
+    auto &new_values = values[value.identifier];
+    auto fingerprint = new_values.fingerprint();
+    if (new_values.empty()) {
+        new_values = values_.slice(*existing);
     }
-    values[value.identifier].emplace(value.time, value.value);
+    new_values.add(value.time, value.value);
+    fingerprints.update(value.identifier, fingerprint, new_values.fingerprint());
     sig->raw_values = &values.at(value.identifier);
     identifier_mapping[value.identifier] = value.identifier;
 }
 
 std::string VCDDatabase::find_identifier(
-    std::unordered_map<std::string, std::string> &identifier_mapping, const VCDValue &value) {
+    std::unordered_map<std::string, std::string> &identifier_mapping,
+    const FingerprintIndex &fingerprints, const VCDValue &value) {
     std::string identifier = value.identifier;
     if (identifier_mapping.empty()) {
         // map to itself
@@ -150,10 +1706,11 @@ std::string VCDDatabase::find_identifier(
         identifier = identifier_mapping.at(identifier);
     } else {
         // this is a new one. we just randomly pick up an identifier
-        // that has the same value
-        for (auto const &[id, vs] : values) {
-            if (vs.size() == 1 && vs.find(value.time) != vs.end() &&
-                vs.at(value.time) == value.value) {
+        // that has the same value. only stores with a single entry can match
+        auto fingerprint = VCDValueStore::entry_fingerprint(value.time, value.value);
+        for (auto const &id : fingerprints.find(fingerprint)) {
+            auto const &vs = values.at(id);
+            if (vs.size() == 1 && vs.time(0) == value.time && vs.value_equal(0, value.value)) {
                 identifier = id;
                 break;
             }
@@ -167,7 +1724,8 @@ std::string VCDDatabase::find_identifier(
 void VCDDatabase::de_alias_signal(
     std::unordered_map<std::string, uint64_t> &vcd_count,
     std::unordered_map<std::string, std::string> &identifier_mapping,
-    std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping) {
+    std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping,
+    FingerprintIndex &fingerprints) {
     // we need to detect if we should de-alias some signals
     std::unordered_set<std::string> changes = identify_signals(vcd_count, identifier_mapping);
 
@@ -176,52 +1734,41 @@ void VCDDatabase::de_alias_signal(
         // we should alias to that instead
         auto count = vcd_count.at(identifier);
         auto old_identifier = identifier_mapping.at(identifier);
-        std::map<uint64_t, std::string> new_values = create_new_values(count, old_identifier);
+        VCDValueStore new_values = create_new_values(count, old_identifier);
 
-        bool match = true;
+        // only stores with the same fingerprint can have identical values
         std::string match_id;
-        for (auto const &[id, vs] : values) {
-            if (vs.size() == count) {
-                // check values as well
-                for (auto const &[t, v] : new_values) {
-                    if (vs.find(t) == vs.end() || vs.at(t) != v) {
-                        match = false;
-                        break;
-                    }
-                }
-            }
-            if (match) {
+        for (auto const &id : fingerprints.find(new_values.fingerprint())) {
+            if (values.at(id).same_values(new_values)) {
                 match_id = id;
                 break;
             }
         }
 
-        if (!match) {
+        if (match_id.empty()) {
             // actually create new values
-            values[identifier] = new_values;
+            auto &store = values[identifier];
+            fingerprints.update(identifier, store.fingerprint(), new_values.fingerprint());
+            store = std::move(new_values);
             // remap the symbol
-            identifier_signal_mapping.at(identifier)->raw_values = &values[identifier];
+            identifier_signal_mapping.at(identifier)->raw_values = &store;
             identifier_mapping[identifier] = identifier;
         } else {
             identifier_signal_mapping.at(identifier)->raw_values = &values[match_id];
             identifier_mapping[identifier] = match_id;
-            if (values.find(identifier) != values.end()) {
-                values.erase(identifier);
+            auto it = values.find(identifier);
+            if (match_id != identifier && it != values.end()) {
+                fingerprints.remove(identifier, it->second.fingerprint());
+                values.erase(it);
             }
         }
     }
 }
 
-std::map<uint64_t, std::string> VCDDatabase::create_new_values(
-    uint64_t count, const std::basic_string<char> &identifier) {
-    auto iter = values.at(identifier).begin();
-    std::map<uint64_t, std::string> new_values;
-    // notice that map (B-tree) is ordered nicely
-    for (uint64_t i = 0; i < count; i++) {
-        new_values.emplace(iter->first, iter->second);
-        iter++;
-    }
-    return new_values;
+VCDValueStore VCDDatabase::create_new_values(uint64_t count,
+                                             const std::basic_string<char> &identifier) {
+    // values are stored in time order
+    return values.at(identifier).slice(count);
 }
 
 std::unordered_set<std::string> VCDDatabase::identify_signals(
@@ -241,33 +1788,89 @@ std::unordered_set<std::string> VCDDatabase::identify_signals(
     return changes;
 }
 
+void VCDDatabase::alias_values(const std::vector<std::string> &identifiers,
+                               std::vector<VCDValueStore> &stores,
+                               const std::vector<std::vector<VCDSignal *>> &identifier_signals) {
+    // the sequential parser checks for aliases whenever the time advances. value changes at the
+    // last timestamp are never checked, so aliased signals keep sharing the store as long as the
+    // values don't conflict. we set them aside and only compare the history before
+    auto last_time = times.empty() ? 0 : *times.rbegin();
+    std::vector<std::optional<std::string>> last_values(stores.size());
+    for (uint64_t id = 0; id < stores.size(); id++) {
+        auto &store = stores[id];
+        if (store.empty() || store.time(store.size() - 1) != last_time) continue;
+        last_values[id] = store.value(store.size() - 1);
+        store.pop_back();
+    }
+
+    // candidates are bucketed by their fingerprint, so we only need to compare stores that are
+    // very likely to be identical. the first identifier in header order is kept
+    std::unordered_map<uint64_t, std::vector<uint64_t>> buckets;
+    std::vector<uint64_t> representatives(stores.size());
+    for (uint64_t id = 0; id < stores.size(); id++) {
+        representatives[id] = id;
+        if (stores[id].empty() && !last_values[id]) continue;
+        auto &bucket = buckets[stores[id].fingerprint()];
+        auto &last_value = last_values[id];
+        auto it = std::find_if(bucket.begin(), bucket.end(), [&](uint64_t candidate) {
+            auto const &value = last_values[candidate];
+            return stores[candidate].same_values(stores[id]) &&
+                   (!value || !last_value || *value == *last_value);
+        });
+        if (it == bucket.end()) {
+            bucket.emplace_back(id);
+            continue;
+        }
+        representatives[id] = *it;
+        if (!last_values[*it]) last_values[*it] = std::move(last_value);
+    }
+
+    std::vector<VCDValueStore *> shared(stores.size(), nullptr);
+    for (uint64_t id = 0; id < stores.size(); id++) {
+        auto representative = representatives[id];
+        if (representative == id) {
+            if (stores[id].empty() && !last_values[id]) continue;
+            auto &store = stores[id];
+            if (last_values[id]) store.add(last_time, *last_values[id]);
+            store.shrink_to_fit();
+            shared[id] = &values.emplace(identifiers[id], std::move(store)).first->second;
+        }
+        for (auto *signal : identifier_signals[id]) {
+            signal->raw_values = shared[representative];
+        }
+    }
+}
+
 std::map<std::string, uint64_t> VCDDatabase::get_stats() const {
     // compute the size of each values
     uint64_t total_size = 0, before_size = 0;
     for (auto const &[name, value] : values) {
-        for (auto const &[t, s] : value) {
-            total_size += s.length();
-            before_size += s.length();
-        }
-        total_size += sizeof(value);  // NOLINT
+        total_size += name.capacity() + value.size_in_bytes();
+        before_size += value.value_bytes();
     }
     total_size += sizeof(values);  // NOLINT
-    // compute number of aliased signal
-    uint64_t num_aliased = signals.size() - values.size();
+    if (is_lazy()) {
+        std::lock_guard lock(decoded_mutex_);
+        for (auto const &[name, decoded] : decoded_values_) {
+            total_size += name.capacity() + decoded.store->size_in_bytes();
+            before_size += decoded.store->value_bytes();
+        }
+    }
+    // compute number of aliased signal. lazy mode only shares identical identifiers
+    uint64_t num_aliased = signals.size() - (is_lazy() ? num_identifiers_ : values.size());
 
     // compute the compression ratio
     uint64_t after_size = 0;
     for (auto const &[p, sig] : signals) {
-        auto const &value = *sig->raw_values;
-        for (auto const &[t, s] : value) {
-            after_size += s.length();
-        }
+        if (sig->raw_values) after_size += sig->raw_values->value_bytes();
     }
 
-    return {{"total_size", total_size},
-            {"num_aliased", num_aliased},
-            {"before_size", before_size},
-            {"after_size", after_size}};
+    std::map<std::string, uint64_t> result = {{"total_size", total_size},
+                                              {"num_aliased", num_aliased},
+                                              {"before_size", before_size},
+                                              {"after_size", after_size}};
+    if (is_lazy()) result.emplace("num_scans", num_scans_.load());
+    return result;
 }
 
 }  // namespace hgdb::vcd
\ No newline at end of file
@@ -1,14 +1,148 @@
 #ifndef HGDB_RTL_VCD_HH
 #define HGDB_RTL_VCD_HH
 
+#include <atomic>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <string_view>
+#include <vector>
 #include <vcd/vcd.hh>
 
+#include "util.hh"
+
 namespace hgdb::vcd {
 
-class VCDDatabase;
+class WaveformDatabase;
+
+// columnar storage for the value changes of a single identifier.
+// timestamps are delta encoded as varints with a checkpoint every few entries to allow
+// binary search. values are bit-packed with 2 bits per bit (0/1/x/z). values that are not
+// 4-state, e.g. real numbers, fall back to plain strings
+class VCDValueStore {
+public:
+    void add(uint64_t time, std::string_view value);
+    // append entries from other that are later than the current last time
+    void append(const VCDValueStore &other);
+
+    [[nodiscard]] uint64_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    [[nodiscard]] uint64_t width() const { return width_; }
+
+    // index of the first entry whose time is not less than the given time
+    [[nodiscard]] uint64_t lower_bound(uint64_t time) const;
+    [[nodiscard]] std::optional<uint64_t> find(uint64_t time) const;
+    // appends the times of entries [begin, end) to result
+    void time_range(uint64_t begin, uint64_t end, std::vector<uint64_t> &result) const;
+
+    [[nodiscard]] uint64_t time(uint64_t index) const;
+    // values are returned in their shortest form. leading bits that only extend the value are
+    // dropped, e.g. 0010 is returned as 10 and xx01 as x01
+    [[nodiscard]] std::string value(uint64_t index) const;
+    [[nodiscard]] uint64_t uint_value(uint64_t index) const;
+    // value as little-endian 64-bit words. words has to be zero-initialized by the caller and
+    // higher bits that don't fit are dropped. returns false and clears words if the value has
+    // x or z in it
+    bool words_value(uint64_t index, uint64_t *words, uint64_t num_words) const;
+    [[nodiscard]] bool value_equal(uint64_t index, std::string_view value) const;
+
+    // copy of the first count entries
+    [[nodiscard]] VCDValueStore slice(uint64_t count) const;
+    // drops the last entry
+    void pop_back();
+    // release unused capacity once the store is fully populated
+    void shrink_to_fit();
+
+    // whether two stores have identical value change history
+    [[nodiscard]] bool same_values(const VCDValueStore &other) const;
+    // fingerprint of a history that only has this entry
+    static uint64_t entry_fingerprint(uint64_t time, std::string_view value);
+    // rolling hash of the value change history. only maintained while the store is populated,
+    // stores loaded from an index file report 0
+    [[nodiscard]] uint64_t fingerprint() const { return fingerprint_; }
+
+    // bytes used by the encoded values and the actual memory footprint
+    [[nodiscard]] uint64_t value_bytes() const;
+    [[nodiscard]] uint64_t size_in_bytes() const;
+
+    struct Checkpoint {
+        uint64_t time;
+        uint64_t offset;
+    };
+
+private:
+    static constexpr uint64_t checkpoint_interval = 32;
+
+    uint64_t size_ = 0;
+    uint64_t width_ = 0;
+    uint64_t last_time_ = 0;
+    uint64_t fingerprint_ = 0;
+    std::vector<uint8_t> times_;
+    std::vector<Checkpoint> checkpoints_;
+    std::vector<uint64_t> bits_;
+    // only used when the values are not 4-state
+    bool packed_ = true;
+    std::vector<std::string> strings_;
+
+    // when loaded from an index file, the arrays point to the mapped file instead
+    struct MappedData {
+        const uint8_t *times;
+        uint64_t times_size;
+        const Checkpoint *checkpoints;
+        uint64_t num_checkpoints;
+        const uint64_t *bits;
+        uint64_t num_bits;
+    };
+    std::optional<MappedData> mapped_;
+    // the accessors decode times from the checkpoints without bound checks, so mapped times have
+    // to be exactly size_ varints ending at times_size, with checkpoints that agree with them
+    [[nodiscard]] bool check_mapped_times() const;
+
+    [[nodiscard]] const uint8_t *times_data() const {
+        return mapped_ ? mapped_->times : times_.data();
+    }
+    [[nodiscard]] const Checkpoint *checkpoints_data() const {
+        return mapped_ ? mapped_->checkpoints : checkpoints_.data();
+    }
+    [[nodiscard]] uint64_t num_checkpoints() const {
+        return mapped_ ? mapped_->num_checkpoints : checkpoints_.size();
+    }
+    [[nodiscard]] const uint64_t *bits_data() const {
+        return mapped_ ? mapped_->bits : bits_.data();
+    }
+
+    [[nodiscard]] uint64_t times_size() const {
+        return mapped_ ? mapped_->times_size : times_.size();
+    }
+    [[nodiscard]] uint64_t num_bits() const { return mapped_ ? mapped_->num_bits : bits_.size(); }
+
+    bool add_time(uint64_t time);
+    [[nodiscard]] uint8_t get_bit(uint64_t index, uint64_t bit) const;
+    // codes are accessed 32 at a time, starting at an arbitrary bit position of bits_
+    static uint64_t code_mask(uint64_t count);
+    [[nodiscard]] uint64_t read_codes(uint64_t pos) const;
+    void write_codes(uint64_t pos, uint64_t codes, uint64_t count);
+    void fill_codes(uint64_t pos, uint8_t code, uint64_t count);
+    void copy_codes(uint64_t index, const VCDValueStore &other, uint64_t other_index);
+    void resize_width(uint64_t width);
+    void unpack();
+    void materialize();
+    void compute_fingerprint();
+
+    friend class VCDIndex;
+};
+
+// a batch of values of a single signal. values wider than 64 bits take num_words little-endian
+// words per entry
+struct VCDSamples {
+    uint64_t num_words = 1;
+    std::vector<uint64_t> times;
+    std::vector<uint64_t> values;
+};
 
 // we only care about individual values
 class VCDSignal {
@@ -17,19 +151,67 @@ public:
     std::string path;
     std::string name;
     // this is ordered
-    std::map<uint64_t, std::string> *raw_values;
+    VCDValueStore *raw_values;
+
+    // declared width from the $var definition
+    uint64_t width = 0;
 
     std::string get_value(uint64_t time) const;
 
     uint64_t get_uint_value(uint64_t time) const;
 
+    // arbitrary width value as little-endian 64-bit words. x and z are read as 0
+    std::vector<uint64_t> get_wide_value(uint64_t time) const;
+
+    // value changes with t0 <= time < t1
+    [[nodiscard]] VCDSamples get_transitions(uint64_t t0, uint64_t t1) const;
+    // same as get_value() at each of the sorted times
+    [[nodiscard]] VCDSamples sample(const std::vector<uint64_t> &times) const;
+    // times in [t0, t1) where the value changes to 1 (posedge) or 0 (negedge)
+    [[nodiscard]] std::vector<uint64_t> get_edges(uint64_t t0, uint64_t t1, bool posedge) const;
+
+    // in lazy mode raw_values is not set and the values are decoded on first access. the store
+    // has at least every value change up to time and the first one after it. it stays valid
+    // while the pointer is held, even if it's evicted from the cache
+    [[nodiscard]] std::shared_ptr<const VCDValueStore> values(
+        uint64_t time = std::numeric_limits<uint64_t>::max()) const;
+
     // backwards pointer to access db
-    VCDDatabase *db;
+    WaveformDatabase *db;
+
+private:
+    [[nodiscard]] uint64_t num_words(const VCDValueStore *store) const;
+};
+
+struct VCDOptions {
+    // cache the parsed database in a binary sidecar file (filename + ".ooze") that is memory
+    // mapped on later loads
+    bool use_index = false;
+    // more than 1 thread enables chunked parsing. 0 means using all hardware threads
+    uint64_t num_threads = 1;
+    // only index the header and timestamps. value changes of a signal are decoded the first time
+    // it is queried, and at most max_decoded_signals identifiers are kept in memory (0 means
+    // no limit)
+    bool lazy = false;
+    uint64_t max_decoded_signals = 1024;
+};
+
+// identifiers bucketed by the fingerprint of their current value history, which allows us to
+// find identical stores without scanning all of them
+class FingerprintIndex {
+public:
+    void update(const std::string &identifier, uint64_t old_fingerprint, uint64_t new_fingerprint);
+    void remove(const std::string &identifier, uint64_t fingerprint);
+    [[nodiscard]] const std::vector<std::string> &find(uint64_t fingerprint) const;
+
+private:
+    std::unordered_map<uint64_t, std::vector<std::string>> buckets_;
 };
 
-class VCDDatabase {
+// common interface of the waveform formats. every format exposes its signals as VCDSignal
+class WaveformDatabase {
 public:
-    explicit VCDDatabase(const std::string &filename);
+    virtual ~WaveformDatabase() = default;
 
     // if the file is big, we might need to use lazy eval to handle
     // memory usage
@@ -38,25 +220,102 @@ public:
     // used to access time we need to query
     std::set<uint64_t> times;
     // hold the actual values
-    std::unordered_map<std::string, std::map<uint64_t, std::string>> values;
+    std::unordered_map<std::string, VCDValueStore> values;
+
+    [[nodiscard]] virtual std::map<std::string, uint64_t> get_stats() const = 0;
+    [[nodiscard]] virtual bool loaded_from_index() const { return false; }
+
+    // same as calling values() on each signal, but lazy formats decode all of them at once.
+    // holding on to the result keeps the stores decoded
+    std::vector<std::shared_ptr<const VCDValueStore>> get_values(
+        const std::vector<const VCDSignal *> &signals,
+        uint64_t time = std::numeric_limits<uint64_t>::max());
 
-    std::map<std::string, uint64_t> get_stats() const;
+protected:
+    // decodes the values of signals whose raw_values is not set, at least up to time. entries
+    // are nullptr if the format loads everything up front. has to be thread-safe since it's
+    // called from const accessors
+    virtual std::vector<std::shared_ptr<const VCDValueStore>> load_values(
+        const std::vector<std::string> &identifiers, uint64_t time) = 0;
+
+    friend class VCDSignal;
+};
+
+class VCDDatabase : public WaveformDatabase {
+public:
+    explicit VCDDatabase(const std::string &filename, const VCDOptions &options = {});
+
+    [[nodiscard]] std::map<std::string, uint64_t> get_stats() const override;
+
+    [[nodiscard]] bool loaded_from_index() const override { return mapped_file_ != nullptr; }
+    [[nodiscard]] bool is_lazy() const { return source_file_ != nullptr; }
+    static std::string index_filename(const std::string &filename);
+
+protected:
+    std::vector<std::shared_ptr<const VCDValueStore>> load_values(
+        const std::vector<std::string> &identifiers, uint64_t time) override;
 
 private:
+    // keeps the index file mapped since the value stores point into it
+    std::unique_ptr<util::MappedFile> mapped_file_;
+
+    // lazy mode keeps the source mapped and decodes identifiers on demand
+    std::unique_ptr<util::MappedFile> source_file_;
+    // the value change section is split at timestamps into segments of about
+    // lazy_segment_size bytes, so that a query only decodes as far as its time. begin time and
+    // file offset of every segment
+    static constexpr uint64_t lazy_segment_size = 1 << 18;
+    std::vector<std::pair<uint64_t, uint64_t>> segments_;
+    uint64_t num_identifiers_ = 0;
+    uint64_t max_decoded_ = 0;
+    std::unique_ptr<util::ThreadPool> pool_;
+    // number of passes over the value changes, see get_stats()
+    std::atomic<uint64_t> num_scans_ = 0;
+    // decoded identifiers, most recently used first. stores that are still held by callers are
+    // not evicted
+    struct DecodedValues {
+        std::shared_ptr<const VCDValueStore> store;
+        // the store has every value change of the first num_segments segments
+        uint64_t num_segments = 0;
+        std::list<std::string>::iterator pos;
+    };
+    mutable std::mutex decoded_mutex_;
+    std::list<std::string> decoded_;
+    std::unordered_map<std::string, DecodedValues> decoded_values_;
+
+    bool parse(const std::string &filename);
+    bool parse_parallel(const std::string &filename, uint64_t num_threads);
+    bool parse_lazy(const std::string &filename);
+    // whether the store answers queries up to time, see VCDSignal::values()
+    [[nodiscard]] bool covers(const VCDValueStore *store, uint64_t num_segments,
+                              uint64_t time) const;
+    // extends the stores of the identifiers in a single pass over the value changes, until all
+    // of them cover time
+    void decode_values(const std::unordered_map<std::string_view, uint64_t> &identifiers,
+                       std::vector<DecodedValues> &decoded, uint64_t time);
+    void evict_values();
+
+    friend class VCDIndex;
+
     void alias_signal(std::unordered_map<std::string, std::string> &identifier_mapping,
                       std::unordered_set<std::string> &seen_identifiers,
                       std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping,
-                      const VCDValue &value);
+                      FingerprintIndex &fingerprints, const VCDValue &value);
     void de_alias_signal(std::unordered_map<std::string, uint64_t> &vcd_count,
                          std::unordered_map<std::string, std::string> &identifier_mapping,
-                         std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping);
+                         std::unordered_map<std::string, VCDSignal *> &identifier_signal_mapping,
+                         FingerprintIndex &fingerprints);
     std::string find_identifier(std::unordered_map<std::string, std::string> &identifier_mapping,
-                                const VCDValue &value);
+                                const FingerprintIndex &fingerprints, const VCDValue &value);
     static std::unordered_set<std::string> identify_signals(
         std::unordered_map<std::string, uint64_t> &vcd_count,
         std::unordered_map<std::string, std::string> &identifier_mapping);
-    std::map<uint64_t, std::string> create_new_values(uint64_t count,
-                                                      const std::basic_string<char> &identifier);
+    VCDValueStore create_new_values(uint64_t count, const std::basic_string<char> &identifier);
+    // identifiers with identical value change history share the same store. stores are indexed
+    // by the identifier order in the header
+    void alias_values(const std::vector<std::string> &identifiers,
+                      std::vector<VCDValueStore> &stores,
+                      const std::vector<std::vector<VCDSignal *>> &identifier_signals);
 };
 
 }  // namespace hgdb::vcd
@@ -0,0 +1,287 @@
+"""Minimal VCD to FST converter used to generate FST test fixtures.
+
+Only the features needed by the tests are supported: one value change section per block,
+identical value changes are aliased (the same way GTKWave's writer does it), and chains are
+compressed with zlib ("Z") or LZ4 ("4"). If vcd2fst is installed, the tests use it as well.
+"""
+
+import gzip
+import struct
+import zlib
+
+# single bit values that are not 0 or 1
+SINGLE_BIT_VALUES = "xzhuwl-?"
+
+
+def varint(value):
+    result = bytearray()
+    while value >= 0x80:
+        result.append((value & 0x7F) | 0x80)
+        value >>= 7
+    result.append(value)
+    return bytes(result)
+
+
+def svarint(value):
+    result = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if (value == 0 and not (b & 0x40)) or (value == -1 and (b & 0x40)):
+            result.append(b)
+            return bytes(result)
+        result.append(b | 0x80)
+
+
+def u64(value):
+    return struct.pack(">Q", value)
+
+
+def lz4_compress(data):
+    # greedy compressor that emits valid LZ4 blocks
+    result = bytearray()
+    table = {}
+    anchor = pos = 0
+    limit = len(data) - 12
+
+    def length(value):
+        out = bytearray()
+        value -= 15
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+        return out
+
+    while pos < limit:
+        key = data[pos:pos + 4]
+        ref = table.get(key)
+        table[key] = pos
+        if ref is None or pos - ref > 0xFFFF:
+            pos += 1
+            continue
+        match = 4
+        while pos + match < len(data) - 5 and data[ref + match] == data[pos + match]:
+            match += 1
+        literals = pos - anchor
+        token = (min(literals, 15) << 4) | min(match - 4, 15)
+        result.append(token)
+        if literals >= 15:
+            result += length(literals)
+        result += data[anchor:pos]
+        result += struct.pack("<H", pos - ref)
+        if match - 4 >= 15:
+            result += length(match - 4)
+        pos += match
+        anchor = pos
+    literals = len(data) - anchor
+    result.append(min(literals, 15) << 4)
+    if literals >= 15:
+        result += length(literals)
+    result += data[anchor:]
+    return bytes(result)
+
+
+def parse_vcd(filename):
+    with open(filename) as f:
+        tokens = f.read().split()
+    scopes = []
+    variables = []
+    changes = []
+    time = 0
+    i = 0
+    while i < len(tokens):
+        token = tokens[i]
+        if token == "$scope":
+            scopes.append(tokens[i + 2])
+            i += 4
+        elif token == "$upscope":
+            scopes.pop()
+            i += 2
+        elif token == "$var":
+            end = tokens.index("$end", i)
+            var_type, width, identifier = tokens[i + 1:i + 4]
+            name = " ".join(tokens[i + 4:end])
+            variables.append((list(scopes), var_type, int(width), identifier, name))
+            i = end + 1
+        elif token in ("$date", "$version", "$timescale", "$comment"):
+            i = tokens.index("$end", i) + 1
+        elif token in ("$enddefinitions", "$dumpvars", "$end"):
+            i += 1
+        elif token[0] == "#":
+            time = int(token[1:])
+            i += 1
+        elif token[0] in "bBrR":
+            changes.append((time, tokens[i + 1], token[1:]))
+            i += 2
+        else:
+            changes.append((time, token[1:], token[0]))
+            i += 1
+    return variables, changes
+
+
+def extend(value, width):
+    if len(value) >= width:
+        return value[len(value) - width:]
+    pad = value[0] if value[0] in "xXzZ" else "0"
+    return pad * (width - len(value)) + value
+
+
+def encode_change(delta, value, width):
+    if width == 1:
+        if value in "01":
+            return varint((delta << 2) | (int(value) << 1))
+        return varint((delta << 4) | (SINGLE_BIT_VALUES.index(value) << 1) | 1)
+    if all(c in "01" for c in value):
+        bits = bytearray((width + 7) // 8)
+        for i, c in enumerate(value):
+            if c == "1":
+                bits[i // 8] |= 1 << (7 - i % 8)
+        return varint(delta << 1) + bytes(bits)
+    return varint((delta << 1) | 1) + value.encode()
+
+
+def compress(data, pack):
+    compressed = lz4_compress(data) if pack == "4" else zlib.compress(data)
+    if len(compressed) < len(data):
+        return varint(len(data)) + compressed
+    return varint(0) + data
+
+
+def block(block_type, data):
+    return bytes([block_type]) + u64(len(data) + 8) + data
+
+
+def write_vc_block(times, handle_changes, frame, pack):
+    max_handle = len(frame)
+    frame_data = b"".join(v.encode() for v in frame)
+    compressed_frame = zlib.compress(frame_data)
+    if len(compressed_frame) >= len(frame_data):
+        compressed_frame = frame_data
+
+    body = u64(times[0]) + u64(times[-1]) + u64(0)
+    body += varint(len(frame_data)) + varint(len(compressed_frame)) + varint(max_handle)
+    body += compressed_frame
+    body += varint(max_handle)
+
+    # chains are relative to the pack type byte
+    chains = bytearray(pack.encode())
+    positions = []
+    seen = {}
+    for handle in range(max_handle):
+        changes = handle_changes.get(handle)
+        if not changes:
+            positions.append(None)
+            continue
+        data = compress(changes, pack)
+        if data in seen:
+            positions.append(-(seen[data] + 1))
+            continue
+        seen[data] = handle
+        positions.append(len(chains))
+        chains += data
+    body += chains
+
+    table = bytearray()
+    zeros = 0
+    prev_pos = 0
+    prev_alias = 0
+    for pos in positions:
+        if pos is None:
+            zeros += 1
+            continue
+        if zeros:
+            table += varint(zeros << 1)
+            zeros = 0
+        if pos < 0:
+            table += svarint(1 if pos == prev_alias else (pos << 1) | 1)
+            prev_alias = pos
+        else:
+            table += svarint(((pos - prev_pos) << 1) | 1)
+            prev_pos = pos
+    if zeros:
+        table += varint(zeros << 1)
+    body += table + u64(len(table))
+
+    time_table = bytearray()
+    prev = 0
+    for t in times:
+        time_table += varint(t - prev)
+        prev = t
+    compressed_times = zlib.compress(bytes(time_table))
+    if len(compressed_times) >= len(time_table):
+        compressed_times = bytes(time_table)
+    body += compressed_times + u64(len(time_table)) + u64(len(compressed_times)) + u64(len(times))
+    # dynamic alias v2
+    return block(8, body)
+
+
+def vcd_to_fst(vcd_filename, fst_filename, pack="Z", num_blocks=2, hierarchy="gzip"):
+    variables, changes = parse_vcd(vcd_filename)
+    handles = {}
+    widths = []
+    for _, _, width, identifier, _ in variables:
+        if identifier not in handles:
+            handles[identifier] = len(handles)
+            widths.append(width)
+
+    times = sorted({t for t, _, _ in changes})
+    blocks = [times[i * len(times) // num_blocks:(i + 1) * len(times) // num_blocks]
+              for i in range(num_blocks)]
+    blocks = [b for b in blocks if b]
+
+    current = ["x" * w for w in widths]
+    vc_blocks = b""
+    for block_times in blocks:
+        frame = list(current)
+        index = {t: i for i, t in enumerate(block_times)}
+        handle_changes = {}
+        last_index = {}
+        for t, identifier, value in changes:
+            if t not in index:
+                continue
+            handle = handles[identifier]
+            value = extend(value.lower(), widths[handle])
+            delta = index[t] - last_index.get(handle, 0)
+            last_index[handle] = index[t]
+            handle_changes[handle] = handle_changes.get(handle, b"") + \
+                encode_change(delta, value, widths[handle])
+            current[handle] = value
+        vc_blocks += write_vc_block(block_times, handle_changes, frame, pack)
+
+    header = u64(times[0]) + u64(times[-1]) + struct.pack("=d", 2.7182818284590452354)
+    scopes = {tuple(s[:i + 1]) for s, *_ in variables for i in range(len(s))}
+    header += u64(0) + u64(len(scopes)) + u64(len(variables)) + u64(len(widths))
+    header += u64(len(blocks)) + struct.pack("b", -9)
+    header += b"ooze".ljust(128, b"\0") + b"".ljust(119, b"\0") + bytes([0]) + u64(0)
+
+    geometry = b"".join(varint(w) for w in widths)
+    geometry_block = block(3, u64(len(geometry)) + u64(len(widths)) + geometry)
+
+    records = bytearray()
+    scope = []
+    declared = set()
+    for var_scope, var_type, width, identifier, name in variables:
+        common = 0
+        while common < min(len(scope), len(var_scope)) and scope[common] == var_scope[common]:
+            common += 1
+        records += bytes([255]) * (len(scope) - common)
+        for s in var_scope[common:]:
+            records += bytes([254, 0]) + s.encode() + b"\0\0"
+        scope = var_scope
+        # wire or reg
+        records += bytes([5 if var_type == "reg" else 16, 0]) + name.encode() + b"\0"
+        records += varint(width)
+        records += varint(handles[identifier] + 1 if identifier in declared else 0)
+        declared.add(identifier)
+    records += bytes([255]) * len(scope)
+    if hierarchy == "lz4":
+        hierarchy_block = block(6, u64(len(records)) + lz4_compress(bytes(records)))
+    else:
+        hierarchy_block = block(4, u64(len(records)) + gzip.compress(bytes(records)))
+
+    with open(fst_filename, "wb") as f:
+        f.write(block(0, header))
+        f.write(vc_blocks)
+        f.write(geometry_block)
+        f.write(hierarchy_block)
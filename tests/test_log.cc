@@ -1,4 +1,7 @@
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <tuple>
 
 #include "../src/log.hh"
 #include "fmt/format.h"
@@ -66,4 +69,173 @@ TEST(log, test_printf) {  // NOLINT
     EXPECT_EQ(item.int_values[0], 42);
     EXPECT_EQ(item.int_values[1], 44);
     EXPECT_EQ(item.str_values[0], "aa.bb.cc");
-}
\ No newline at end of file
+}
+TEST(log, test_printf_scanner) {  // NOLINT
+    // literals are matched as is and fields backtrack when the rest of the line doesn't match
+    auto parser = hgdb::log::LogPrintfParser("%t: v=%f. n=%d %s (a.b)", {"v", "n", "s"});
+    auto item = parser.parse("[info] 5: v=-1.25. n= 7 hello (a.b)");
+    EXPECT_EQ(item.time, 5);
+    EXPECT_EQ(item.float_values[0], -1.25);
+    EXPECT_EQ(item.int_values[0], 7);
+    EXPECT_EQ(item.str_values[0], "hello");
+
+    item = parser.parse("5: v=3. n=7 hello (a.b)");
+    EXPECT_EQ(item.float_values[0], 3);
+    EXPECT_EQ(item.int_values[0], 7);
+
+    // . is not a wildcard
+    item = parser.parse("5: v=3. n=7 hello (axb)");
+    EXPECT_TRUE(item.float_values.empty());
+}
+
+// (time, values) of every item in item index order
+std::vector<std::tuple<int64_t, std::vector<int64_t>, std::vector<std::string>>> get_items(
+    hgdb::log::LogDatabase &db) {
+    std::vector<std::tuple<int64_t, std::vector<int64_t>, std::vector<std::string>>> result;
+    hgdb::log::LogItem item;
+    for (auto const &index : db.item_index()) {
+        db.get_item(&item, *index);
+        result.emplace_back(item.time, item.int_values, item.str_values);
+    }
+    return result;
+}
+
+TEST(log, test_printf_parallel) {  // NOLINT
+    std::stringstream ss;
+    constexpr auto num_items = 10000;
+    for (auto i = 0; i < num_items; i++) {
+        ss << fmt::format("@{0} PROC: {1} 0x{2:08X} aa.bb.cc", i + 1, i, i + 2) << std::endl;
+        // empty lines are skipped
+        if (i % 7 == 0) ss << std::endl;
+    }
+    auto parser = hgdb::log::LogPrintfParser("@%t PROC: %0d 0x%08X %m", {"proc", "value", "inst"});
+    // small chunks so that the input is split into many of them
+    constexpr auto chunk_size = 4096;
+    std::vector<std::tuple<int64_t, std::vector<int64_t>, std::vector<std::string>>> expected;
+    for (auto num_threads : {1, 4}) {
+        hgdb::log::LogDatabase db(hgdb::log::LogDatabase::default_batch_size, num_threads,
+                                  chunk_size);
+        std::stringstream input(ss.str());
+        auto batches = db.parse(input, parser);
+        // same batches as a single threaded parse
+        EXPECT_EQ(batches.size(), (num_items + hgdb::log::LogDatabase::default_batch_size - 1) /
+                                      hgdb::log::LogDatabase::default_batch_size);
+        EXPECT_EQ(db.item_index().size(), num_items);
+
+        hgdb::log::LogItem item;
+        for (auto i : {0, 1023, 1024, num_items - 1}) {
+            auto const &index = *db.item_index()[i];
+            EXPECT_EQ(index.batch_index * hgdb::log::LogDatabase::default_batch_size + index.index,
+                      i);
+            db.get_item(&item, index);
+            EXPECT_EQ(item.time, i + 1);
+            EXPECT_EQ(item.int_values[0], i);
+            EXPECT_EQ(item.int_values[1], i + 2);
+        }
+
+        auto items = get_items(db);
+        if (num_threads == 1) {
+            expected = std::move(items);
+        } else {
+            EXPECT_EQ(items, expected);
+        }
+    }
+}
+
+TEST(log, test_printf_file) {  // NOLINT
+    auto filename = std::filesystem::temp_directory_path() / "hgdb_test_printf_file.log";
+    constexpr auto num_items = 5000;
+    {
+        std::ofstream stream(filename);
+        for (auto i = 0; i < num_items; i++) {
+            stream << fmt::format("@{0} PROC: {1} 0x{2:08X} aa.bb.cc", i + 1, i, i + 2);
+            // no line break at the end of the file
+            if (i != num_items - 1) stream << std::endl;
+        }
+    }
+    auto parser = hgdb::log::LogPrintfParser("@%t PROC: %0d 0x%08X %m", {"proc", "value", "inst"});
+    std::vector<std::tuple<int64_t, std::vector<int64_t>, std::vector<std::string>>> expected;
+    for (auto num_threads : {1, 4}) {
+        // small chunks so that the file is split into many of them
+        hgdb::log::LogDatabase db(hgdb::log::LogDatabase::default_batch_size, num_threads, 4096);
+        db.parse(filename.string(), parser);
+        EXPECT_EQ(db.item_index().size(), num_items);
+
+        hgdb::log::LogItem item;
+        db.get_item(&item, *db.item_index().back());
+        EXPECT_EQ(item.time, num_items);
+        EXPECT_EQ(item.int_values[1], num_items + 1);
+        EXPECT_EQ(item.str_values[0], "aa.bb.cc");
+
+        auto items = get_items(db);
+        if (num_threads == 1) {
+            expected = std::move(items);
+        } else {
+            EXPECT_EQ(items, expected);
+        }
+    }
+    std::filesystem::remove(filename);
+}
+
+TEST(log, test_store) {  // NOLINT
+    std::stringstream ss;
+    constexpr auto num_items = 3000;
+    for (auto i = 0; i < num_items; i++) {
+        ss << fmt::format("@{0} PROC: {1} 0x{2:08X} aa.bb.cc", i + 1, i, i + 2) << std::endl;
+    }
+    hgdb::log::LogDatabase db;
+    auto parser = hgdb::log::LogPrintfParser("@%t PROC: %0d 0x%08X %m", {"proc", "value", "inst"});
+    auto batches = db.parse(ss, parser);
+
+    auto filename = std::filesystem::temp_directory_path() / "hgdb_test_store.ooze";
+    EXPECT_TRUE(db.save(filename.string(), 42));
+    EXPECT_EQ(hgdb::log::LogDatabase::load(filename.string(), 43), nullptr);
+    auto loaded = hgdb::log::LogDatabase::load(filename.string(), 42);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->item_index().size(), num_items);
+    EXPECT_EQ(loaded->get_batches(0), batches);
+
+    hgdb::log::LogItem item;
+    loaded->get_item(&item, hgdb::log::LogIndex{1, 42});
+    EXPECT_EQ(item.time, 1024 + 42 + 1);
+    EXPECT_EQ(item.int_values[1], 1024 + 42 + 2);
+    EXPECT_EQ(item.str_values[0], "aa.bb.cc");
+    EXPECT_EQ(item.format->at("value").second, 1);
+    std::filesystem::remove(filename);
+
+    // the key changes with the parser format and attribute order
+    auto other = hgdb::log::LogPrintfParser("@%t PROC: %0d 0x%08X %m", {"value", "proc", "inst"});
+    std::vector<std::string> files = {filename.string()};
+    EXPECT_NE(hgdb::log::LogDatabase::compute_key(files, {&parser}),
+              hgdb::log::LogDatabase::compute_key(files, {&other}));
+}
+
+TEST(log, test_select_range) {  // NOLINT
+    std::stringstream ss;
+    constexpr auto num_items = 3000;
+    for (auto i = 0; i < num_items; i++) {
+        // the last batch is out of order
+        auto time = i < 2048 ? i : num_items * 2 - i;
+        ss << fmt::format("@{0} PROC: {1} 0x{2:08X} aa.bb.cc", time, i, i) << std::endl;
+    }
+    hgdb::log::LogDatabase db;
+    auto parser = hgdb::log::LogPrintfParser("@%t PROC: %0d 0x%08X %m", {"proc", "value", "inst"});
+    db.parse(ss, parser);
+
+    auto items = db.select_range(1000, 1100);
+    ASSERT_EQ(items.size(), 101);
+    EXPECT_EQ(items.front().batch_index, 0);
+    EXPECT_EQ(items.front().index, 1000);
+    EXPECT_EQ(items.back().batch_index, 1);
+
+    items = db.select_range(3500, 3501);
+    ASSERT_EQ(items.size(), 2);
+    hgdb::log::LogItem item;
+    db.get_item(&item, items[0]);
+    EXPECT_EQ(item.time, 3501);
+    EXPECT_EQ(item.int_values[0], 2499);
+
+    std::set<uint64_t> batches = {0};
+    EXPECT_TRUE(db.select_range(1024, 1100, &batches).empty());
+    EXPECT_TRUE(db.select_range(10000, 20000).empty());
+}
@@ -1,16 +1,16 @@
 from ooze import Log, Ooze, LogPrintfParser, LogItem, LogFormatParser, ParsedLogItem, Transaction, to_transaction,\
-    Transactions
+    Transactions, clear_cache
 import tempfile
 import os
 
 
-def setup_display_parsing(temp):
+def setup_display_parsing(temp, num_threads=1):
     file = os.path.join(temp, "test.log")
     with open(file, "w+") as f:
         for i in range(100):
             f.write("@{0} a.b.c: 0x{0:08X}\n".format(i))
     parser = LogPrintfParser("@%t %m: 0x%08X", ["module", "value"])
-    log = Log()
+    log = Log(num_threads)
     log.add_file(file, parser)
     o = Ooze()
     o.add_source(log)
@@ -29,6 +29,75 @@ def test_log_parsing():
     assert res[43].value == 43
 
 
+def test_log_parsing_parallel():
+    with tempfile.TemporaryDirectory() as temp:
+        o, parser = setup_display_parsing(temp, num_threads=4)
+    res = o.select(parser.TYPE)
+    assert len(res) == 100
+    assert [item.value for item in res] == list(range(100))
+
+
+def test_log_store():
+    with tempfile.TemporaryDirectory() as temp:
+        file = os.path.join(temp, "test.log")
+        store = os.path.join(temp, "test.log.ooze")
+        with open(file, "w+") as f:
+            for i in range(100):
+                f.write("@{0} a.b.c: 0x{0:08X}\n".format(i))
+        for i in range(2):
+            # items of the previous iteration must not be served from the cache
+            clear_cache()
+            parser = LogPrintfParser("@%t %m: 0x%08X", ["module", "value"])
+            log = Log(store=store)
+            log.add_file(file, parser)
+            o = Ooze()
+            o.add_source(log)
+            # first time we parse the file and create the store
+            assert log.loaded_from_store == (i == 1)
+            assert os.path.exists(store)
+            res = o.select(parser.TYPE)
+            assert len(res) == 100
+            assert res[42].time == 42
+            assert res[42].value == 42
+
+
+def test_log_select_range():
+    with tempfile.TemporaryDirectory() as temp:
+        file = os.path.join(temp, "test.log")
+        with open(file, "w+") as f:
+            for i in range(3000):
+                f.write("@{0} a.b.c: 0x{0:08X}\n".format(i))
+        parser = LogPrintfParser("@%t %m: 0x%08X", ["module", "value"])
+        log = Log()
+        log.add_file(file, parser)
+        o = Ooze()
+        o.add_source(log)
+    res = log.select_range(1000, 2100)
+    assert len(res) == 1101
+    assert res[0].time == 1000
+    assert res[-1].value == 2100
+    res = log.select_range(10, 19, parser.TYPE)
+    assert [item.time for item in res] == list(range(10, 20))
+    assert len(log.select_range(5000, 6000)) == 0
+
+
+def test_log_select_range_files():
+    # the same parser on two files selects the items of both
+    with tempfile.TemporaryDirectory() as temp:
+        parser = LogPrintfParser("@%t %m: 0x%08X", ["module", "value"])
+        log = Log()
+        for name, start in [("a.log", 0), ("b.log", 100)]:
+            file = os.path.join(temp, name)
+            with open(file, "w+") as f:
+                for i in range(start, start + 100):
+                    f.write("@{0} a.b.c: 0x{0:08X}\n".format(i))
+            log.add_file(file, parser)
+        o = Ooze()
+        o.add_source(log)
+    res = log.select_range(90, 109, parser.TYPE)
+    assert sorted(item.time for item in res) == list(range(90, 110))
+
+
 class CustomParser(LogFormatParser):
     def __init__(self):
         LogFormatParser.__init__(self)
@@ -61,6 +130,37 @@ def test_custom_log_parser():
     assert res[42].c == 42.0
 
 
+def test_custom_log_parser_store():
+    class ScaledParser(CustomParser):
+        def __init__(self, scale):
+            CustomParser.__init__(self)
+            self.scale = scale
+
+        def parse(self, content):
+            tokens = content.split(" ")
+            item = ParsedLogItem(self, a=int(tokens[1]) * self.scale, b=tokens[2], c=float(tokens[3]))
+            item.time = int(tokens[0])
+            return item
+
+    with tempfile.TemporaryDirectory() as temp:
+        file = os.path.join(temp, "test.log")
+        store = os.path.join(temp, "test.log.ooze")
+        with open(file, "w+") as f:
+            for i in range(100):
+                f.write("{0} {0} {0} {1}\n".format(i, float(i)))
+        # changes to a Python parse() are not part of the key, so the store is never used
+        for scale in [1, 2]:
+            clear_cache()
+            parser = ScaledParser(scale)
+            log = Log(store=store)
+            log.add_file(file, parser)
+            o = Ooze()
+            o.add_source(log)
+            assert not log.loaded_from_store
+            assert not os.path.exists(store)
+            assert o.select(parser.TYPE)[42].a == 42 * scale
+
+
 def test_transaction():
     with tempfile.TemporaryDirectory() as temp:
         o, parser = setup_display_parsing(temp)
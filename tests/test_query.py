@@ -1,4 +1,6 @@
-from ooze import Ooze, RTL, VCD, Port, get_value, VCDSignal, GenericQueryObject, QueryArray
+import pytest
+
+from ooze import Ooze, RTL, VCD, Port, attr, get_value, like, VCDSignal, GenericQueryObject, QueryArray
 
 
 def test_join(get_vector_file):
@@ -46,6 +48,22 @@ def test_sequence():
     assert array[2][-1].a == 2
 
 
+def test_attr_filter():
+    o = Ooze()
+    array = o.array([o.object({"a": i, "b": str(i), "c": [i]}) for i in range(10)])
+    assert len(array.where((attr("a") >= 2) & (attr("a") < 5))) == 3
+    assert len(array.where(attr("a") >= 2.5)) == 7
+    assert len(array.where(~(attr("b") == "1") | (attr("a") == 1))) == 10
+    assert array.where(attr("b") == 1) is None
+    assert array.where(attr("d") == 1) is None
+    assert array.where(b=like(r"[3-9]"), a=3).a == 3
+    # non-native attribute values are compared by Python
+    assert array.where(attr("c") == 1) is None
+    assert array.where(c=[4]).a == 4
+    with pytest.raises(TypeError):
+        assert (attr("a") == 1) and (attr("b") == "1")
+
+
 if __name__ == "__main__":
     from conftest import get_vector_file_fn
     test_join(get_vector_file_fn)
@@ -1,25 +1,28 @@
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #include "slang/syntax/SyntaxTree.h"
 #include "slang/symbols/InstanceSymbols.h"
 #include "slang/compilation/Definition.h"
 #include "../src/rtl.hh"
+#include "../src/snapshot.hh"
 #include "gtest/gtest.h"
 #include "fmt/format.h"
 #include <unordered_set>
 
 class TestDesignDatabase : public ::testing::Test {
 protected:
-    void load_str(const std::string_view &sv) {
+    void load_str(const std::string_view &sv, bool instance_caching = false) {
         slang::CompilationOptions compile_options;
-        compile_options.disableInstanceCaching = true;
+        compile_options.disableInstanceCaching = !instance_caching;
         slang::Bag bag;
         bag.set(compile_options);
         compilation = std::make_unique<slang::Compilation>(bag);
         auto tree = slang::SyntaxTree::fromText(sv);
 
         compilation->addSyntaxTree(tree);
-        design_ = std::make_unique<hgdb::rtl::DesignDatabase>(*compilation);
+        design_ = std::make_unique<hgdb::rtl::DesignDatabase>(*compilation, 1, instance_caching);
     }
 
     std::unique_ptr<slang::Compilation> compilation;
@@ -156,6 +159,67 @@ endmodule
     EXPECT_FALSE(design_->symbol_inside(a, inst3));
 }
 
+TEST_F(TestDesignDatabase, path_table) {  // NOLINT
+    load_str(R"(
+module child1 (input logic a);
+logic b;
+endmodule
+module top;
+logic c;
+child1 inst1 (.a(c));
+child1 inst12 (.a(c));
+endmodule
+)");
+    auto const &paths = design_->paths();
+    auto const *inst1 = design_->get_instance("top.inst1");
+    auto const *inst12 = design_->get_instance("top.inst12");
+    auto const *b = design_->select("top.inst1.b");
+    auto const *a = design_->get_port(design_->select("top.inst1.a"));
+    EXPECT_EQ(design_->get_path(b), "top.inst1.b");
+    EXPECT_EQ(design_->get_path(inst12), design_->get_symbol_path(inst12));
+
+    auto id = design_->get_path_id(b);
+    ASSERT_TRUE(id);
+    EXPECT_EQ(paths.find("top.inst1.b"), id);
+    EXPECT_EQ(paths.parent(*id), design_->get_path_id(inst1));
+    // ports and their internal variables share a path
+    EXPECT_EQ(design_->get_path_id(a), design_->get_path_id(design_->select("top.inst1.a")));
+    // a common string prefix doesn't make it a parent
+    EXPECT_FALSE(design_->symbol_inside(inst12, inst1));
+    EXPECT_FALSE(design_->symbol_inside(inst1, inst1));
+    EXPECT_TRUE(design_->symbol_inside(a, inst1));
+    EXPECT_FALSE(design_->symbol_inside(a, inst12));
+}
+
+TEST_F(TestDesignDatabase, select_paths) {  // NOLINT
+    load_str(R"(
+module alu (input logic a);
+logic b;
+endmodule
+module core;
+logic c;
+alu alu (.a(c));
+endmodule
+module top;
+core core0();
+core core1();
+alu mem();
+endmodule
+)");
+    auto selection = design_->select_paths(hgdb::rtl::PathPattern("top.core*.alu.*", false));
+    EXPECT_TRUE(selection.instances.empty());
+    EXPECT_EQ(selection.ports.size(), 2);
+    ASSERT_EQ(selection.variables.size(), 4);
+    EXPECT_EQ(design_->get_path(selection.variables[0]), "top.core0.alu.a");
+    EXPECT_EQ(design_->get_path(selection.variables[3]), "top.core1.alu.b");
+
+    selection = design_->select_paths(hgdb::rtl::PathPattern("top.**.a", false));
+    EXPECT_EQ(selection.ports.size(), 3);
+    selection = design_->select_paths(hgdb::rtl::PathPattern(R"(top\.core\d\.alu)", true));
+    EXPECT_EQ(selection.instances.size(), 2);
+    EXPECT_TRUE(selection.variables.empty());
+}
+
 TEST_F(TestDesignDatabase, get_source_instances_var) {  // NOLINT
     load_str(R"(
 module mod1 (
@@ -321,4 +385,322 @@ endmodule
     instances = design_->get_sink_instances(p2);
     EXPECT_EQ(instances.size(), 1);
     EXPECT_EQ(*instances.begin(), inst2);
-}
\ No newline at end of file
+}
+
+TEST_F(TestDesignDatabase, connectivity_graph) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b
+);
+assign b = a;
+endmodule
+
+module top;
+logic l1, l2, l3;
+
+mod1 inst1 (.a(l1), .b(l2));
+mod1 inst2 (.a(l2), .b(l3));
+mod1 inst3 (.a(l2), .b(l1));
+endmodule
+)");
+    design_->build_connectivity();
+
+    auto const *b1 = design_->get_port(design_->select("top.inst1.b"));
+    auto const *inst2 = design_->get_instance("top.inst2");
+    auto const *inst3 = design_->get_instance("top.inst3");
+    auto sinks = design_->get_connected_instances(b1);
+    // in hierarchy order
+    ASSERT_EQ(sinks.size(), 2);
+    EXPECT_EQ(sinks[0], inst2);
+    EXPECT_EQ(sinks[1], inst3);
+
+    auto const *inst1 = design_->get_instance("top.inst1");
+    auto sources = design_->get_source_instances(inst1);
+    EXPECT_EQ(sources.size(), 1);
+    EXPECT_EQ(*sources.begin(), inst3);
+    // nothing loads l3
+    EXPECT_TRUE(design_->get_sink_instances(inst2).empty());
+}
+
+TEST_F(TestDesignDatabase, connectivity_inout) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b,
+    inout wire c
+);
+assign b = a;
+endmodule
+
+module top;
+logic l1, l2;
+wire w;
+
+mod1 inst1 (.a(l1), .b(l2), .c(w));
+mod1 inst2 (.a(l2), .b(l1), .c(w));
+mod1 inst3 (.a(l2), .b(), .c());
+endmodule
+)");
+    auto const *inst1 = design_->get_instance("top.inst1");
+    auto const *c1 = &inst1->body.findPort("c")->as<slang::PortSymbol>();
+    auto const *inst2 = design_->get_instance("top.inst2");
+    // an inout port is connected to the other ports on its net, whatever drives them
+    auto connected = design_->get_connected_instances(c1);
+    ASSERT_EQ(connected.size(), 1);
+    EXPECT_EQ(connected[0], inst2);
+    // and does not take part in the source and sink queries
+    EXPECT_TRUE(design_->get_source_instances(c1).empty());
+    EXPECT_TRUE(design_->get_sink_instances(c1).empty());
+}
+
+TEST_F(TestDesignDatabase, fan_cone) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b
+);
+assign b = a;
+endmodule
+
+module top;
+logic l1, l2, l3, l4;
+
+mod1 inst1 (.a(l1), .b(l2));
+mod1 inst2 (.a(l2), .b(l3));
+mod1 inst3 (.a(l3), .b(l4));
+endmodule
+)");
+    auto const *inst1 = design_->get_instance("top.inst1");
+    auto const *inst2 = design_->get_instance("top.inst2");
+    auto const *inst3 = design_->get_instance("top.inst3");
+
+    auto cone = design_->get_fanout({inst1}, std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(cone, (std::vector<const slang::InstanceSymbol *>{inst2, inst3}));
+    cone = design_->get_fanout({inst1}, 1);
+    EXPECT_EQ(cone, (std::vector<const slang::InstanceSymbol *>{inst2}));
+    cone = design_->get_fanin({inst3}, 2, 4);
+    EXPECT_EQ(cone, (std::vector<const slang::InstanceSymbol *>{inst2, inst1}));
+
+    auto const *a3 = design_->get_port(design_->select("top.inst3.a"));
+    cone = design_->get_fanin({a3}, 1);
+    EXPECT_EQ(cone, (std::vector<const slang::InstanceSymbol *>{inst2}));
+}
+
+TEST_F(TestDesignDatabase, parallel_index) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b
+);
+logic c;
+endmodule
+
+module mod2;
+logic d, e;
+mod1 inst1 (.a(d), .b(e));
+mod1 inst2 (.a(e), .b(d));
+endmodule
+
+module top;
+mod2 inst3();
+mod2 inst4();
+endmodule
+)");
+    auto parallel = std::make_unique<hgdb::rtl::DesignDatabase>(*compilation, 4);
+    EXPECT_EQ(design_->instances(), parallel->instances());
+    EXPECT_EQ(design_->ports(), parallel->ports());
+    EXPECT_EQ(design_->variables(), parallel->variables());
+    EXPECT_EQ(parallel->timings().size(), 2);
+}
+
+TEST_F(TestDesignDatabase, snapshot) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b
+);
+logic c;
+assign b = a;
+endmodule
+
+module mod2 (
+    input logic d,
+    output logic e
+);
+mod1 inst1 (.a(d), .b(e));
+endmodule
+
+module top;
+logic l1, l2, l3;
+mod2 inst2 (.d(l1), .e(l2));
+mod1 inst3 (.a(l2), .b(l3));
+endmodule
+)");
+    auto filename = ::testing::TempDir() + "test_rtl_snapshot.bin";
+    EXPECT_TRUE(design_->save_snapshot(filename, 42));
+    EXPECT_EQ(hgdb::rtl::DesignSnapshot::load(filename, 43), nullptr);
+    auto snapshot = hgdb::rtl::DesignSnapshot::load(filename, 42);
+    ASSERT_NE(snapshot, nullptr);
+
+    EXPECT_EQ(snapshot->num_instances(), design_->instances().size());
+    EXPECT_EQ(snapshot->num_ports(), design_->ports().size());
+    EXPECT_EQ(snapshot->num_variables(), design_->variables().size());
+    for (uint64_t i = 0; i < snapshot->num_instances(); i++) {
+        auto path = hgdb::rtl::DesignDatabase::get_symbol_path(design_->instances()[i]);
+        EXPECT_EQ(snapshot->instance_path(i), path);
+        EXPECT_EQ(snapshot->find_instance(path), i);
+    }
+
+    auto top = *snapshot->find_instance("top");
+    auto inst1 = *snapshot->find_instance("top.inst2.inst1");
+    auto inst2 = *snapshot->find_instance("top.inst2");
+    auto inst3 = *snapshot->find_instance("top.inst3");
+    EXPECT_EQ(snapshot->instance_definition(inst1), "mod1");
+    EXPECT_EQ(snapshot->instance_parent(inst1), inst2);
+    EXPECT_EQ(snapshot->instance_parent(top), hgdb::rtl::DesignSnapshot::no_parent);
+    EXPECT_TRUE(snapshot->instance_inside(inst1, top));
+    EXPECT_FALSE(snapshot->instance_inside(inst3, inst2));
+    EXPECT_FALSE(snapshot->find_instance("top.inst4"));
+
+    auto a = *snapshot->find_port("top.inst3.a");
+    EXPECT_EQ(snapshot->port_direction(a), hgdb::rtl::PortDirection::In);
+    EXPECT_EQ(snapshot->port_instance(a), inst3);
+    auto sources = snapshot->port_connections(a);
+    EXPECT_EQ(std::vector<uint64_t>(sources.begin(), sources.end()), std::vector<uint64_t>{inst2});
+    auto c = *snapshot->find_variable("top.inst2.inst1.c");
+    EXPECT_EQ(snapshot->variable_instance(c), inst1);
+
+    // same cone as the elaborated design
+    auto cone = design_->get_fanin({design_->get_instance("top.inst3")}, 4);
+    auto snapshot_cone = snapshot->get_cone({inst3}, {}, true, 4);
+    ASSERT_EQ(cone.size(), snapshot_cone.size());
+    for (uint64_t i = 0; i < cone.size(); i++) {
+        EXPECT_EQ(snapshot->instance_path(snapshot_cone[i]),
+                  hgdb::rtl::DesignDatabase::get_symbol_path(cone[i]));
+    }
+}
+
+TEST_F(TestDesignDatabase, instance_caching) {  // NOLINT
+    load_str(R"(
+module mod1 (
+    input logic a,
+    output logic b
+);
+logic c;
+endmodule
+module mod2 (
+    input logic a
+);
+mod1 inst1 (.a(a), .b());
+mod1 inst2 (.a(a), .b());
+endmodule
+module top;
+logic a;
+mod2 inst1 (.a(a));
+mod2 inst2 (.a(a));
+endmodule
+)",
+             true);
+
+    EXPECT_TRUE(design_->instance_caching());
+    auto const &instances = design_->instances();
+    auto const &contexts = design_->instance_contexts();
+    ASSERT_EQ(instances.size(), contexts.size());
+    // every context is indexed even if slang shares the bodies
+    std::vector<std::string> paths;
+    for (auto const context : contexts) {
+        paths.emplace_back(design_->paths().path(context));
+    }
+    std::vector<std::string> expected = {"top",       "top.inst1.inst1", "top.inst1.inst2",
+                                         "top.inst1", "top.inst2.inst1", "top.inst2.inst2",
+                                         "top.inst2"};
+    std::sort(expected.begin(), expected.end());
+    std::sort(paths.begin(), paths.end());
+    EXPECT_EQ(paths, expected);
+
+    auto context = *design_->paths().find("top.inst2.inst1");
+    auto const *inst = design_->get_context_instance(context);
+    ASSERT_NE(inst, nullptr);
+    EXPECT_EQ(design_->get_path(inst, context), "top.inst2.inst1");
+    auto ports = design_->get_body_ports(inst);
+    ASSERT_EQ(ports.size(), 2);
+    EXPECT_EQ(design_->get_path(ports[1], context), "top.inst2.inst1.b");
+    EXPECT_EQ(design_->get_body_variables(inst).size(), 3);
+    EXPECT_TRUE(design_->paths().inside(context, *design_->paths().find("top.inst2")));
+
+    auto selection = design_->select_paths(hgdb::rtl::PathPattern("top.*.inst2.c", false));
+    ASSERT_EQ(selection.variables.size(), 2);
+    EXPECT_EQ(design_->get_path(selection.variables[1], selection.variable_contexts[1]),
+              "top.inst2.inst2.c");
+
+    EXPECT_THROW(design_->get_fanin({inst}, 1), std::runtime_error);
+}
+
+TEST_F(TestDesignDatabase, drivers) {  // NOLINT
+    load_str(R"(
+module child (
+    input logic clk,
+    input logic [3:0] a,
+    output logic [3:0] b
+);
+logic [3:0] c, d, e;
+assign c = a + d;
+assign {d, e} = 8'h0;
+always_ff @(posedge clk) begin
+    b[c[1:0]] <= c;
+end
+endmodule
+module top;
+logic clk;
+logic [3:0] a, b;
+child inst (.*);
+endmodule
+)");
+
+    auto names = [](std::span<const slang::ValueSymbol *const> values) {
+        std::set<std::string> result;
+        for (auto const *value : values) result.emplace(value->name);
+        return result;
+    };
+    auto const *c = design_->select("top.inst.c");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(names(design_->get_drivers(c)), (std::set<std::string>{"a", "d"}));
+    EXPECT_EQ(names(design_->get_loads(c)), (std::set<std::string>{"b"}));
+    // concatenations assign every operand, constants don't drive anything
+    EXPECT_TRUE(design_->get_drivers(design_->select("top.inst.e")).empty());
+    EXPECT_EQ(names(design_->get_loads(design_->select("top.inst.d"))),
+              (std::set<std::string>{"c"}));
+
+    // ports are resolved to their internal variables
+    auto const *inst = design_->get_instance("top.inst");
+    auto const *b = inst->body.findPort("b");
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(names(design_->get_drivers(b)), (std::set<std::string>{"c"}));
+    auto const *a = inst->body.findPort("a");
+    EXPECT_EQ(names(design_->get_loads(a)), (std::set<std::string>{"c"}));
+}
+
+TEST_F(TestDesignDatabase, drivers_initializer) {  // NOLINT
+    load_str(R"(
+module top;
+logic a, b, y;
+wire w = a & b;
+logic x = y;
+logic z = 1'b0;
+endmodule
+)");
+
+    auto names = [](std::span<const slang::ValueSymbol *const> values) {
+        std::set<std::string> result;
+        for (auto const *value : values) result.emplace(value->name);
+        return result;
+    };
+    // declaration initializers drive the declared net or variable
+    EXPECT_EQ(names(design_->get_drivers(design_->select("top.w"))),
+              (std::set<std::string>{"a", "b"}));
+    EXPECT_EQ(names(design_->get_drivers(design_->select("top.x"))),
+              (std::set<std::string>{"y"}));
+    EXPECT_EQ(names(design_->get_loads(design_->select("top.a"))), (std::set<std::string>{"w"}));
+    EXPECT_TRUE(design_->get_drivers(design_->select("top.z")).empty());
+}
@@ -1,4 +1,7 @@
-from ooze import Instance, Ooze, RTL, Variable, Port, inside, like, source, source_of
+import pytest
+
+from ooze import Instance, Ooze, RTL, Variable, Port, attr, drivers, fanin, fanout, inside, like, loads, source, \
+    source_of
 
 
 def setup_source(filename, get_vector_file):
@@ -77,6 +80,36 @@ def test_instance_select_pattern(get_vector_file):
     assert res.path == "top.inst12"
 
 
+def test_instance_attr_filter(get_vector_file):
+    o = setup_source("test_instance_select_pattern.sv", get_vector_file)
+    res = o.select(Instance).where(attr("name").like(r"inst\d"))
+    assert len(res) == 2
+    res = o.select(Instance).where(attr("name").like(r"inst\d+") & ~(attr("path") == "top.inst0"))
+    assert len(res) == 2
+    res = o.select(Instance).where((attr("name") == "inst0") | (attr("name") == "inst12"))
+    assert len(res) == 2
+    res = o.select(Instance).where(attr("definition") == "mod1")
+    assert len(res) == 3
+    # parent is only available through Python
+    res = o.select(Instance).where(attr("parent") == "top")
+    assert res is None
+
+
+def test_select_path(get_vector_file):
+    o = setup_source("test_instance_select.sv", get_vector_file)
+    res = o.select(Instance, path="top.inst5.*")
+    assert [i.path for i in res] == ["top.inst5.inst3", "top.inst5.inst4"]
+    assert len(o.select(Instance, path="top.**.inst2")) == 4
+    assert len(o.select(Instance, path=like(r"top\.inst6\..*"))) == 4
+    assert len(o.select(Instance, path="top.inst7.*")) == 0
+
+    o = setup_source("test_variable_select.sv", get_vector_file)
+    assert len(o.select(Variable, path="top.inst.?")) == 4
+    res = o.select(Port, path="top.*.a")
+    assert [p.path for p in res] == ["top.inst.a"]
+    assert len(o.select(Variable, Port, path="top.inst.a")) == 2
+
+
 def test_port_source(get_vector_file):
     o = setup_source("test_port_source.sv", get_vector_file)
     res = o.select(Variable).map(source)
@@ -90,6 +123,154 @@ def test_port_source(get_vector_file):
     assert res.path == "top.inst2"
 
 
+def test_fan_cone(get_vector_file):
+    o = setup_source("test_fan_cone.sv", get_vector_file)
+    inst1 = o.select(Instance).where(path="top.inst1")
+    res = fanout(inst1)
+    # instances of the same hop are in hierarchy order
+    assert [i.path for i in res] == ["top.inst2", "top.inst4", "top.inst3"]
+    assert len(fanout(inst1, depth=1)) == 2
+    assert len(fanout(inst1, num_threads=4)) == 3
+    inst3 = o.select(Instance).where(path="top.inst3")
+    assert [i.path for i in fanin(inst3)] == ["top.inst2", "top.inst1"]
+    port = o.select(Port).where(path="top.inst3.a")
+    res = fanin(port, depth=1)
+    assert len(res) == 1
+    assert res[0].path == "top.inst2"
+    # output ports don't have a fan-in through their connections
+    port = o.select(Port).where(path="top.inst3.b")
+    assert len(fanin(port)) == 0
+
+
+def test_drivers(get_vector_file):
+    o = setup_source("test_drivers.sv", get_vector_file)
+    c = o.select(Variable).where(path="top.inst.c")
+    # in hierarchy order
+    assert [v.path for v in drivers(c)] == ["top.inst.a", "top.inst.d"]
+    assert [v.path for v in loads(c)] == ["top.inst.b"]
+    # the index of a select is read, not assigned
+    b = o.select(Port).where(path="top.inst.b")
+    assert [v.path for v in drivers(b)] == ["top.inst.c"]
+    assert len(loads(o.select(Variable).where(path="top.inst.d"))) == 1
+
+
+def test_rtl_parallel(get_vector_file):
+    filename = get_vector_file("test_instance_select.sv")
+    results = []
+    for num_threads in (1, 4):
+        rtl = RTL(num_threads=num_threads)
+        rtl.add_file(filename)
+        o = Ooze()
+        o.add_source(rtl)
+        results.append(([i.path for i in o.select(Instance)], [v.path for v in o.select(Variable)]))
+        assert set(rtl.timings.keys()) == {"parse", "elaborate", "hierarchy", "index"}
+    assert results[0] == results[1]
+
+
+def test_rtl_snapshot(get_vector_file, tmp_path):
+    filename = get_vector_file("test_fan_cone.sv")
+    snapshot = str(tmp_path / "design.snapshot")
+
+    def query():
+        rtl = RTL(snapshot=snapshot)
+        rtl.add_file(filename)
+        o = Ooze()
+        o.add_source(rtl)
+        top = o.select(Instance).where(path="top")
+        inst1 = o.select(Instance).where(path="top.inst1")
+        port = o.bind(o.object({"path": "top.inst3.a"}), Port)
+        result = ([i.path for i in o.select(Instance)],
+                  [(v.path, v.name, v.parent.path) for v in o.select(Variable)],
+                  [(p.path, p.direction) for p in o.select(Port)],
+                  [i.path for i in fanout(inst1)],
+                  [i.path for i in fanin(port)],
+                  source(port).path,
+                  len(o.select(Instance).where(inside(top))),
+                  [i.path for i in o.select(Instance).where(definition="mod1")])
+        return rtl, result
+
+    rtl, elaborated = query()
+    assert not rtl.query_only
+    rtl, loaded = query()
+    assert rtl.query_only
+    assert "elaborate" not in rtl.timings
+    assert loaded == elaborated
+
+
+def test_rtl_snapshot_include(tmp_path):
+    top = tmp_path / "top.sv"
+    header = tmp_path / "top.svh"
+    top.write_text("module top;\n`include \"top.svh\"\nendmodule\n")
+    header.write_text("logic a;\n")
+    snapshot = str(tmp_path / "design.snapshot")
+
+    def load():
+        rtl = RTL(snapshot=snapshot)
+        rtl.add_file(str(top))
+        o = Ooze()
+        o.add_source(rtl)
+        return rtl.query_only, [v.path for v in o.select(Variable)]
+
+    assert load() == (False, ["top.a"])
+    assert load() == (True, ["top.a"])
+    # a changed include file invalidates the snapshot
+    header.write_text("logic a, b;\n")
+    assert load() == (False, ["top.a", "top.b"])
+
+
+def test_rtl_instance_caching(get_vector_file):
+    filename = get_vector_file("test_instance_select.sv")
+    results = []
+    for instance_caching in (False, True):
+        rtl = RTL(instance_caching=instance_caching)
+        rtl.add_file(filename)
+        o = Ooze()
+        o.add_source(rtl)
+        inst5 = o.select(Instance).where(path="top.inst5")
+        results.append(([i.path for i in o.select(Instance)],
+                        [(v.path, v.parent.path) for v in o.select(Variable)],
+                        [i.path for i in o.select(Instance, path="top.**.inst2")],
+                        len(o.select(Instance).where(inside(inst5)))))
+    assert results[0] == results[1]
+
+
+def test_rtl_update(tmp_path):
+    top = tmp_path / "top.sv"
+    child = tmp_path / "child.sv"
+    top.write_text("module top; child inst1(); endmodule\n")
+    child.write_text("module child; logic a; endmodule\n")
+    rtl = RTL()
+    rtl.add_file(str(top))
+    rtl.add_file(str(child))
+    o = Ooze()
+    o.add_source(rtl)
+    a = o.select(Variable).where(path="top.inst1.a")
+    # nothing has changed, so the design is kept
+    assert rtl.update()
+    assert a.valid
+    assert "elaborate" not in rtl.timings
+
+    child.write_text("module child; logic a, b; endmodule\n")
+    assert rtl.update()
+    assert not a.valid
+    with pytest.raises(RuntimeError):
+        _ = a.path
+    assert [v.path for v in o.select(Variable)] == ["top.inst1.a", "top.inst1.b"]
+
+    # included files and the top module are tracked as well
+    header = tmp_path / "child.svh"
+    header.write_text("logic c;\n")
+    child.write_text("module child; logic a, b;\n`include \"child.svh\"\nendmodule\n")
+    assert rtl.update()
+    assert [v.path for v in o.select(Variable)] == ["top.inst1.a", "top.inst1.b", "top.inst1.c"]
+    header.write_text("logic c, d;\n")
+    assert rtl.update()
+    assert len(o.select(Variable)) == 4
+    rtl.set_top("child")
+    assert rtl.update()
+    assert [v.path for v in o.select(Variable)] == ["child.a", "child.b", "child.c", "child.d"]
+
+
 if __name__ == "__main__":
     from conftest import get_vector_file_fn
     test_rtl_bind(get_vector_file_fn)
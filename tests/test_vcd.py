@@ -1,4 +1,10 @@
-from ooze import Ooze, VCD, VCDSignal, get_value, pre_value
+from ooze import Ooze, VCD, FST, VCDSignal, get_value, pre_value, value
+from fst_writer import vcd_to_fst
+import os
+import pytest
+import shutil
+import subprocess
+import tempfile
 
 
 def setup_vcd(get_vector_file, vcd_file):
@@ -26,6 +32,39 @@ def test_vcd_aliasing(get_vector_file):
     assert stats["num_aliased"] == 3
 
 
+def test_vcd_stats(get_vector_file):
+    o = setup_vcd(get_vector_file, "test_vcd.vcd")
+    vcd = o.provider(VCDSignal)
+    stats = vcd.stats
+    # every store is shared by two aliased signals, so counting the bytes per signal doubles them
+    assert stats["total_size"] > 0
+    assert stats["before_size"] * 2 == stats["after_size"]
+
+
+def test_vcd_str_value(get_vector_file):
+    o = setup_vcd(get_vector_file, "test_vcd.vcd")
+    res = o.select(VCDSignal).where(path="top.b")
+    assert str(res.map(get_value(0, True))) == "x"
+    assert str(res.map(get_value(15, True))) == "10"
+    assert int(res.map(get_value(0))) == 0
+
+
+def test_vcd_str_value_trimmed():
+    # values are returned in their shortest form, not the way they are written in the file
+    with tempfile.TemporaryDirectory() as temp:
+        filename = os.path.join(temp, "test.vcd")
+        with open(filename, "w+") as f:
+            f.write("$scope module top $end\n$var wire 4 ! a [3:0] $end\n$upscope $end\n"
+                    "$enddefinitions $end\n#0\nb0010 !\n#5\nbxx01 !\n#10\nb0000 !\n")
+        o = Ooze()
+        o.add_source(VCD(filename))
+        res = o.select(VCDSignal)
+        assert str(res.map(get_value(0, True))) == "10"
+        assert str(res.map(get_value(5, True))) == "x01"
+        assert str(res.map(get_value(10, True))) == "0"
+        assert int(res.map(get_value(0))) == 2
+
+
 def test_vcd_pre_value(get_vector_file):
     o = setup_vcd(get_vector_file, "test_vcd.vcd")
     res = o.select(VCDSignal)
@@ -52,6 +91,240 @@ def test_vcd_when(get_vector_file):
     assert res[0].time == 20
 
 
+def when_times(obj, predicate, **kwargs):
+    res = obj.when(predicate, **kwargs)
+    if res is None:
+        return []
+    if hasattr(res, "time"):
+        return [res.time]
+    return [v.time if hasattr(v, "time") else v[0].time for v in res]
+
+
+def test_vcd_when_clock(get_vector_file):
+    o = setup_vcd(get_vector_file, "test_vcd.vcd")
+    a = o.select(VCDSignal).where(path="top.a")
+    clk = o.select(VCDSignal).where(path="top.clk")
+    # only the rising edges of the clock are sampled
+    assert when_times(a, lambda v: v.value > 2, clock="top.clk")[0] == 25
+    assert when_times(a, lambda v: v.value > 2, clock=clk)[:2] == [25, 35]
+    assert when_times(a, lambda v: v.value > 2, clock=clk, edge="negedge")[0] == 20
+
+
+def test_vcd_when_native(get_vector_file):
+    o = setup_vcd(get_vector_file, "test_vcd.vcd")
+    a = o.select(VCDSignal).where(path="top.a")
+    assert when_times(a, value > 2)[0] == 20
+    cases = [(value > 2, lambda v: v.value > 2),
+             (value == 3, lambda v: v.value == 3),
+             (value[0], lambda v: (v.value & 1) == 1),
+             ((value >= 2) & ~(value[1] == 1), lambda v: v.value >= 2 and ((v.value >> 1) & 1) == 0),
+             ((value < 2) | (value == 5), lambda v: v.value < 2 or v.value == 5)]
+    for native, func in cases:
+        assert when_times(a, native) == when_times(a, func)
+        for edge in ["posedge", "negedge"]:
+            assert when_times(a, native, clock="top.clk", edge=edge) == \
+                when_times(a, func, clock="top.clk", edge=edge)
+
+    # predicates on multiple signals need the signal path
+    signals = o.select(VCDSignal)
+    assert when_times(signals, (value("top.a") == 2) & (value("top.b") == 2)) == [10, 15]
+
+
+def test_vcd_index(get_vector_file):
+    with tempfile.TemporaryDirectory() as temp:
+        filename = os.path.join(temp, "test_vcd.vcd")
+        shutil.copyfile(get_vector_file("test_vcd.vcd"), filename)
+        results = []
+        for i in range(2):
+            vcd = VCD(filename, use_index=True)
+            o = Ooze()
+            o.add_source(vcd)
+            # first time we parse the file and create the index
+            assert vcd.loaded_from_index == (i == 1)
+            assert os.path.exists(filename + ".ooze")
+            assert vcd.stats["num_aliased"] == 3
+            res = o.select(VCDSignal).map(get_value(10)).where(path="top.a")
+            results.append(int(res))
+        assert results == [2, 2]
+
+        # a truncated index is rejected and the file is parsed again
+        index_filename = filename + ".ooze"
+        with open(index_filename, "r+b") as f:
+            f.truncate(os.path.getsize(index_filename) // 2)
+        vcd = VCD(filename, use_index=True)
+        o = Ooze()
+        o.add_source(vcd)
+        assert not vcd.loaded_from_index
+        assert int(o.select(VCDSignal).map(get_value(10)).where(path="top.a")) == 2
+
+
+def test_vcd_parallel(get_vector_file):
+    filename = get_vector_file("test_vcd.vcd")
+    results = []
+    for num_threads in [1, 4]:
+        vcd = VCD(filename, num_threads=num_threads)
+        o = Ooze()
+        o.add_source(vcd)
+        assert vcd.stats["num_aliased"] == 3
+        signals = o.select(VCDSignal)
+        results.append([(s.path, int(s.map(get_value(t)))) for s in signals for t in range(0, 30, 5)])
+    assert results[0] == results[1]
+
+
+def test_vcd_parallel_comments():
+    # comment lines that look like timestamps must not be picked as chunk boundaries
+    with tempfile.TemporaryDirectory() as temp:
+        filename = os.path.join(temp, "test.vcd")
+        with open(filename, "w+") as f:
+            f.write("$scope module top $end\n$var wire 8 ! a [7:0] $end\n$upscope $end\n"
+                    "$enddefinitions $end\n#0\nb1 !\n$comment\n")
+            for i in range(1000):
+                f.write("#{0}\nb{0:b} !\n".format(i + 100))
+            f.write("$end\n#10\nb10 !\n#20\nb11 !\n")
+        results = []
+        for options in [{}, {"num_threads": 4}, {"lazy": True}]:
+            o = Ooze()
+            o.add_source(VCD(filename, **options))
+            signals = o.select(VCDSignal)
+            results.append([int(signals.map(get_value(t))) for t in [0, 10, 20]])
+        assert results == [[1, 2, 3]] * 3
+
+
+def test_vcd_lazy(get_vector_file):
+    filename = get_vector_file("test_vcd.vcd")
+    results = []
+    for lazy in [False, True]:
+        # only keep two signals decoded to exercise eviction
+        vcd = VCD(filename, lazy=lazy, max_decoded_signals=2)
+        o = Ooze()
+        o.add_source(vcd)
+        signals = o.select(VCDSignal)
+        results.append([(s.path, int(s.map(get_value(t)))) for s in signals for t in range(0, 30, 5)])
+    assert results[0] == results[1]
+
+
+def test_vcd_lazy_scans():
+    num_signals = 8
+    with tempfile.TemporaryDirectory() as temp:
+        filename = os.path.join(temp, "test.vcd")
+        with open(filename, "w+") as f:
+            f.write("$scope module top $end\n")
+            for i in range(num_signals):
+                f.write("$var wire 16 s{0} a{0} [15:0] $end\n".format(i))
+            f.write("$upscope $end\n$enddefinitions $end\n")
+            # large enough to be split into several segments
+            for t in range(20000):
+                f.write("#{0}\n".format(t * 10))
+                for i in range(num_signals):
+                    f.write("b{0:b} s{1}\n".format(t + i, i))
+        # more signals than can be kept decoded
+        vcd = VCD(filename, lazy=True, max_decoded_signals=2)
+        o = Ooze()
+        o.add_source(vcd)
+        signals = o.select(VCDSignal)
+        values = signals.map(get_value(50))
+        assert sorted(int(v) for v in values) == list(range(5, 5 + num_signals))
+        # every signal is decoded in the same pass, which stops after the queried time
+        assert vcd.stats["num_scans"] == 1
+        size = vcd.stats["before_size"]
+        values = signals.map(get_value(199990))
+        assert sorted(int(v) for v in values) == list(range(19999, 19999 + num_signals))
+        assert vcd.stats["num_scans"] == 2
+        assert vcd.stats["before_size"] > size
+
+
+def test_vcd_wide(get_vector_file):
+    o = setup_vcd(get_vector_file, "test_vcd_wide.vcd")
+    wide = o.select(VCDSignal).where(path="top.wide")
+    bus = o.select(VCDSignal).where(path="top.bus")
+    assert int(wide.map(get_value(0))) == 5
+    assert int(wide.map(get_value(5))) == (1 << 100) | 5
+    # x is read as 0
+    assert int(wide.map(get_value(10))) == 0
+    assert int(bus.map(get_value(5))) == (1 << 512) - 1
+    value = bus.map(get_value(10))
+    assert int(value) == 1 << 64
+    assert value.bytes == (1 << 64).to_bytes(64, "little")
+
+
+def test_vcd_extract(get_vector_file):
+    vcd = VCD(get_vector_file("test_vcd.vcd"))
+    o = Ooze()
+    o.add_source(vcd)
+    signals = o.select(VCDSignal)
+    result = vcd.extract(signals, 0, 30)
+    assert len(result) == len(signals)
+    times, values = result["top.a"]
+    assert memoryview(times).tolist() == [0, 5, 15, 25]
+    assert memoryview(values).tolist() == [0, 1, 2, 3]
+    # same as querying every time individually
+    for signal in signals:
+        times, values = result[signal.path]
+        for t, v in zip(memoryview(times).tolist(), memoryview(values).tolist()):
+            assert int(signal.map(get_value(t))) == v
+
+    # sample at the clock edges
+    result = vcd.extract(["top.a", "top.b"], 0, 30, clock="top.clk")
+    times, values = result["top.a"]
+    assert memoryview(times).tolist() == [5, 15, 25]
+    assert memoryview(values).tolist() == [1, 2, 3]
+    # x -> 0 counts as a negedge
+    times, _ = vcd.extract("top.a", clock="top.clk", negedge=True)["top.a"]
+    assert memoryview(times).tolist()[:3] == [0, 10, 20]
+
+
+def get_fst_converters():
+    converters = [("python", {"pack": "Z", "num_blocks": 1}),
+                  ("python", {"pack": "4", "num_blocks": 3, "hierarchy": "lz4"})]
+    if shutil.which("vcd2fst"):
+        converters.append(("vcd2fst", {}))
+    return converters
+
+
+@pytest.mark.parametrize("converter", get_fst_converters())
+@pytest.mark.parametrize("vcd_file", ["test_vcd.vcd", "test_vcd_wide.vcd"])
+def test_fst(get_vector_file, vcd_file, converter):
+    vcd_file = get_vector_file(vcd_file)
+    with tempfile.TemporaryDirectory() as temp:
+        fst_file = os.path.join(temp, "test.fst")
+        name, options = converter
+        if name == "vcd2fst":
+            subprocess.check_call(["vcd2fst", vcd_file, fst_file])
+        else:
+            vcd_to_fst(vcd_file, fst_file, **options)
+        results = []
+        for source in [VCD(vcd_file), FST(fst_file)]:
+            o = Ooze()
+            o.add_source(source)
+            signals = o.select(VCDSignal)
+            results.append({(s.path, t): str(s.map(get_value(t, True))) for s in signals
+                            for t in range(0, 20)})
+        assert results[0] == results[1]
+
+        o = Ooze()
+        o.add_source(FST(fst_file))
+        res = o.select(VCDSignal).map(get_value(20))
+        assert res[0].time == 20
+        assert res.map(pre_value)[0].time == 15
+
+
+def test_fst_lazy_blocks(get_vector_file):
+    with tempfile.TemporaryDirectory() as temp:
+        fst_file = os.path.join(temp, "test.fst")
+        vcd_to_fst(get_vector_file("test_vcd.vcd"), fst_file, num_blocks=3)
+        fst = FST(fst_file)
+        o = Ooze()
+        o.add_source(fst)
+        clk = o.select(VCDSignal).where(path="top.clk")
+        # blocks are only decoded as far as the query needs them
+        assert int(clk.map(get_value(0))) == 0
+        size = fst.stats["before_size"]
+        assert size > 0
+        assert int(clk.map(get_value(90))) == 0
+        assert fst.stats["before_size"] > size
+        assert fst.stats["after_size"] >= fst.stats["before_size"]
+
+
 if __name__ == "__main__":
     from conftest import get_vector_file_fn
     test_vcd_when(get_vector_file_fn)
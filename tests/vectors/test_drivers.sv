@@ -0,0 +1,20 @@
+module child (
+    input logic clk,
+    input logic [3:0] a,
+    output logic [3:0] b
+);
+logic [3:0] c, d;
+assign c = a + d;
+always_comb begin
+    d = 4'h1;
+end
+always_ff @(posedge clk) begin
+    b[c[1:0]] <= c;
+end
+endmodule
+
+module top;
+logic clk;
+logic [3:0] a, b;
+child inst (.*);
+endmodule
@@ -0,0 +1,15 @@
+module mod1 (
+    input logic a,
+    output logic b
+);
+assign b = a;
+endmodule
+
+module top;
+logic l1, l2, l3, l4, l5;
+
+mod1 inst1 (.a(l1), .b(l2));
+mod1 inst2 (.a(l2), .b(l3));
+mod1 inst3 (.a(l3), .b(l4));
+mod1 inst4 (.a(l2), .b(l5));
+endmodule